@@ -4,9 +4,85 @@
 #define BENCHMARK_EXPORT
 #include <benchmark/benchmark.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <random>
+#include <thread>
+#include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <cdatautils/broadcastring.h>
+#include <cdatautils/lanering.h>
 #include <cdatautils/ringbuffer.h>
+#include <cdatautils/workdeque.h>
+
+CDATAUTILS_RING_BUFFER_DEFINE(int, int, 1024)
+CDATAUTILS_RING_BUFFER_DEFINE(uint64_t, u64, 1024)
+
+/* Log-linear latency histogram: exact below 16ns, then 8 buckets per power of two
+(so at most 12.5% off). Cheap enough to record every single operation.
+*/
+struct latency_histogram
+{
+    static constexpr size_t bucket_count = 16 + 60 * 8;
+    std::vector<uint64_t> counts = std::vector<uint64_t>(bucket_count);
+
+    static size_t
+    bucket(uint64_t ns)
+    {
+        if (ns < 16)
+            return (size_t)ns;
+
+        unsigned msb = 4;
+        while (ns >> (msb + 1))
+            ++msb;
+        return 16 + (msb - 4) * 8 + ((ns >> (msb - 3)) & 7);
+    }
+    static uint64_t
+    lower_bound(size_t bucket)
+    {
+        if (bucket < 16)
+            return bucket;
+
+        unsigned const msb = (unsigned)(bucket - 16) / 8 + 4;
+        return (8 + (bucket - 16) % 8) << (msb - 3);
+    }
+
+    void
+    record(uint64_t ns)
+    {
+        ++counts[bucket(ns)];
+    }
+    void
+    merge(latency_histogram const& other)
+    {
+        for (size_t i = 0; i < bucket_count; ++i)
+            counts[i] += other.counts[i];
+    }
+    /* `p` in [0, 1]. */
+    double
+    percentile(double p) const
+    {
+        uint64_t total = 0;
+        for (uint64_t count : counts)
+            total += count;
+
+        uint64_t const rank = std::min((uint64_t)(p * (double)total), total - 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            seen += counts[i];
+            if (seen > rank)
+                return (double)lower_bound(i);
+        }
+        return 0;
+    }
+};
 
 
 void
@@ -275,20 +351,241 @@ bm_ring_buffer_single_thread_maybe(benchmark::State& state)
     }
 }
 void
+bm_ring_buffer_single_thread_batch(benchmark::State& state)
+{
+    using uint = unsigned int;
+
+    struct ring_buffer* rb;
+    ring_buffer_init(&rb, state.range(0), sizeof(uint));
+
+    rb_size_t const batch = (rb_size_t)state.range(1);
+    std::vector<uint> write_items(batch);
+    std::vector<uint> read_items(batch);
+
+    uint write_item = 0;
+    for (auto _ : state) {
+        for (rb_size_t i = 0; i < batch; ++i)
+            write_items[i] = write_item++;
+
+        ring_buffer_push_n(rb, write_items.data(), batch);
+        ring_buffer_pop_n(rb, read_items.data(), batch);
+        benchmark::DoNotOptimize(read_items.data());
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+    state.SetBytesProcessed(state.iterations() * batch * sizeof(uint));
+
+    ring_buffer_destroy(rb);
+}
+void
+bm_ring_buffer_single_thread_batch_per_item(benchmark::State& state)
+{
+    using uint = unsigned int;
+
+    struct ring_buffer* rb;
+    ring_buffer_init(&rb, state.range(0), sizeof(uint));
+
+    rb_size_t const batch = (rb_size_t)state.range(1);
+    std::vector<uint> write_items(batch);
+    std::vector<uint> read_items(batch);
+
+    uint write_item = 0;
+    for (auto _ : state) {
+        for (rb_size_t i = 0; i < batch; ++i)
+            write_items[i] = write_item++;
+
+        for (rb_size_t i = 0; i < batch; ++i)
+            ring_buffer_push(rb, &write_items[i]);
+        for (rb_size_t i = 0; i < batch; ++i)
+            ring_buffer_pop(rb, &read_items[i]);
+        benchmark::DoNotOptimize(read_items.data());
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+    state.SetBytesProcessed(state.iterations() * batch * sizeof(uint));
+
+    ring_buffer_destroy(rb);
+}
+/* Arguments:
+    0 - batch size (doesn't divide the capacity of 1024, so batches wrap around)
+    1 - ring_buffer_flags (RING_BUFFER_MPMC vs RING_BUFFER_DOUBLE_MAPPED)
+
+Writes and then reads `range(0)` items in place, looping over spans until the whole
+batch is done - one span per batch when double-mapped, sometimes two otherwise.
+*/
+void
+bm_ring_buffer_single_thread_spans(benchmark::State& state)
+{
+    using uint = unsigned int;
+
+    struct ring_buffer* rb;
+    ring_buffer_init_flags(&rb, 1024, sizeof(uint), (unsigned)state.range(1));
+
+    rb_size_t const batch = (rb_size_t)state.range(0);
+    int64_t spans = 0;
+
+    uint write_item = 0;
+    for (auto _ : state) {
+        struct ring_buffer_span span;
+        for (rb_size_t done = 0; done < batch; done += span.count, ++spans) {
+            ring_buffer_reserve_write(rb, batch - done, &span);
+            for (rb_size_t i = 0; i < span.count; ++i)
+                ((uint*)span.data)[i] = write_item++;
+            ring_buffer_commit_write(rb, &span);
+        }
+        for (rb_size_t done = 0; done < batch; done += span.count) {
+            ring_buffer_peek_read(rb, batch - done, &span);
+            benchmark::DoNotOptimize(((uint*)span.data)[span.count - 1]);
+            ring_buffer_release_read(rb, &span);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+    state.counters["spans_per_batch"] = (double)spans / (double)state.iterations();
+
+    ring_buffer_destroy(rb);
+}
+/* Generic vs CDATAUTILS_RING_BUFFER_DEFINE, see bm_ring_buffer_single_thread_typed.
+Pushes and then pops `range(0)` items per iteration, in a buffer of 1024.
+*/
+template<class T>
+void
+bm_ring_buffer_single_thread_generic(benchmark::State& state)
+{
+    struct ring_buffer* rb;
+    ring_buffer_init_flags(&rb, 1024, sizeof(T), (unsigned)state.range(1));
+
+    T write_item = 0;
+    T read_item = 0;
+    for (auto _ : state) {
+        for (int i = 0; i < state.range(0); ++i) {
+            ring_buffer_push(rb, &write_item);
+            ++write_item;
+        }
+        for (int i = 0; i < state.range(0); ++i) {
+            ring_buffer_pop(rb, &read_item);
+            benchmark::DoNotOptimize(read_item);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+
+    ring_buffer_destroy(rb);
+}
+template<
+    class T,
+    class RB,
+    void (*init)(RB*),
+    bool (*push)(RB*, T),
+    bool (*pop)(RB*, T*)>
+void
+bm_ring_buffer_single_thread_typed(benchmark::State& state)
+{
+    RB* rb = new RB;
+    init(rb);
+
+    T write_item = 0;
+    T read_item = 0;
+    for (auto _ : state) {
+        for (int i = 0; i < state.range(0); ++i) {
+            push(rb, write_item);
+            ++write_item;
+        }
+        for (int i = 0; i < state.range(0); ++i) {
+            pop(rb, &read_item);
+            benchmark::DoNotOptimize(read_item);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+
+    delete rb;
+}
+void
+bm_ring_buffer_single_thread_copy(benchmark::State& state)
+{
+    size_t const value_size = (size_t)state.range(1);
+
+    struct ring_buffer* rb;
+    ring_buffer_init(&rb, state.range(0), (rb_size_t)value_size);
+
+    std::vector<unsigned char> write_item(value_size);
+    std::vector<unsigned char> read_item(value_size);
+
+    unsigned char sequence = 0;
+    for (auto _ : state) {
+        // Serialize the message.
+        memset(write_item.data(), sequence++, value_size);
+        ring_buffer_push(rb, write_item.data());
+
+        // Deserialize the message.
+        ring_buffer_pop(rb, read_item.data());
+        benchmark::DoNotOptimize(read_item[value_size - 1]);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * value_size);
+
+    ring_buffer_destroy(rb);
+}
+void
+bm_ring_buffer_single_thread_zero_copy(benchmark::State& state)
+{
+    size_t const value_size = (size_t)state.range(1);
+
+    struct ring_buffer* rb;
+    ring_buffer_init(&rb, state.range(0), (rb_size_t)value_size);
+
+    unsigned char sequence = 0;
+    for (auto _ : state) {
+        struct ring_buffer_span span;
+
+        // Serialize the message.
+        ring_buffer_reserve_write(rb, 1, &span);
+        memset(span.data, sequence++, value_size);
+        ring_buffer_commit_write(rb, &span);
+
+        // Deserialize the message.
+        ring_buffer_peek_read(rb, 1, &span);
+        benchmark::DoNotOptimize(((unsigned char*)span.data)[value_size - 1]);
+        ring_buffer_release_read(rb, &span);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * value_size);
+
+    ring_buffer_destroy(rb);
+}
+/* Arguments:
+    0 - capacity
+    1 - ring_buffer_flags (RING_BUFFER_MPMC vs RING_BUFFER_SLOT_SEQUENCES)
+
+Every push/pop is timed, and the latency percentiles over all threads are reported
+(in ns). Also registered with twice as many threads as cores, so that threads get
+preempted in the middle of a push/pop - that's where the engines differ.
+*/
+void
 bm_ring_buffer_multithread(benchmark::State& state)
 {
+    using clock = std::chrono::steady_clock;
+
     static struct ring_buffer* rb;
+    static std::vector<latency_histogram> histograms;
     if (state.thread_index() == 0) {
-        ring_buffer_init(&rb, state.range(0), sizeof(uint64_t));
+        ring_buffer_init_flags(
+            &rb,
+            (rb_size_t)state.range(0),
+            sizeof(uint64_t),
+            (unsigned)state.range(1)
+        );
+        histograms.assign((size_t)state.threads(), latency_histogram{});
     }
 
+    int64_t items = 0;
     if (state.thread_index() % 2) {
         // Reader.
 
         uint64_t value;
         for (auto _ : state) {
-            for (int i = 0; i < 128; ++i)
-                ring_buffer_pop(rb, &value);
+            latency_histogram& histogram = histograms[state.thread_index()];
+            for (int i = 0; i < 128; ++i) {
+                auto start = clock::now();
+                items += ring_buffer_pop(rb, &value);
+                histogram.record((clock::now() - start).count());
+            }
         }
         benchmark::DoNotOptimize(rb);
         benchmark::DoNotOptimize(value);
@@ -297,16 +594,30 @@ bm_ring_buffer_multithread(benchmark::State& state)
 
         uint64_t value = 1;
         for (auto _ : state) {
+            latency_histogram& histogram = histograms[state.thread_index()];
             for (int i = 0; i < 128; ++i) {
-                ring_buffer_push(rb, &value);
+                auto start = clock::now();
+                items += ring_buffer_push(rb, &value);
+                histogram.record((clock::now() - start).count());
                 ++value;
             }
         }
         benchmark::DoNotOptimize(rb);
         benchmark::DoNotOptimize(value);
     }
+    state.SetItemsProcessed(items);
 
+    // All threads are past the loop (it ends with a barrier).
     if (state.thread_index() == 0) {
+        latency_histogram all;
+        for (latency_histogram const& histogram : histograms)
+            all.merge(histogram);
+
+        state.counters["p50_ns"] = all.percentile(0.50);
+        state.counters["p99_ns"] = all.percentile(0.99);
+        state.counters["p999_ns"] = all.percentile(0.999);
+        state.counters["max_ns"] = all.percentile(1.0);
+
         ring_buffer_destroy(rb);
     }
 }
@@ -341,6 +652,602 @@ bm_ring_buffer_multithread_maybe(benchmark::State& state)
     }
 }
 
+/* Arguments:
+    0 - capacity
+    1 - ring_buffer_flags
+    2 - number of producers (the first N threads), the rest are consumers.
+
+The generic (RING_BUFFER_MPMC) runs use the same producer/consumer split as the
+specialized ones, so they can be compared directly.
+*/
+void
+bm_ring_buffer_multithread_mode(benchmark::State& state)
+{
+    static struct ring_buffer* rb;
+    if (state.thread_index() == 0) {
+        ring_buffer_init_flags(
+            &rb,
+            (rb_size_t)state.range(0),
+            sizeof(uint64_t),
+            (unsigned)state.range(1)
+        );
+    }
+
+    int64_t items = 0;
+    if (state.thread_index() >= state.range(2)) {
+        // Reader.
+
+        uint64_t value;
+        for (auto _ : state) {
+            for (int i = 0; i < 128; ++i)
+                items += ring_buffer_pop(rb, &value);
+        }
+        benchmark::DoNotOptimize(value);
+    } else {
+        // Writer.
+
+        uint64_t value = 1;
+        for (auto _ : state) {
+            for (int i = 0; i < 128; ++i) {
+                items += ring_buffer_push(rb, &value);
+                ++value;
+            }
+        }
+    }
+    state.SetItemsProcessed(items);
+
+    if (state.thread_index() == 0) {
+        ring_buffer_destroy(rb);
+    }
+}
+void
+bm_ring_buffer_multithread_batch(benchmark::State& state)
+{
+    static struct ring_buffer* rb;
+    if (state.thread_index() == 0) {
+        ring_buffer_init(&rb, state.range(0), sizeof(uint64_t));
+    }
+
+    rb_size_t const batch = (rb_size_t)state.range(1);
+    std::vector<uint64_t> values(batch);
+    int64_t items = 0;
+
+    if (state.thread_index() % 2) {
+        // Reader.
+
+        for (auto _ : state) {
+            items += ring_buffer_pop_n(rb, values.data(), batch);
+        }
+        benchmark::DoNotOptimize(values.data());
+    } else {
+        // Writer.
+
+        uint64_t value = 1;
+        for (auto _ : state) {
+            for (rb_size_t i = 0; i < batch; ++i)
+                values[i] = value++;
+            items += ring_buffer_push_n(rb, values.data(), batch);
+        }
+    }
+    state.SetItemsProcessed(items);
+
+    if (state.thread_index() == 0) {
+        ring_buffer_destroy(rb);
+    }
+}
+
+enum matrix_variant : int64_t
+{
+    /* ring_buffer_push/pop, retried (with a yield) while full/empty. */
+    matrix_variant_push,
+    /* ring_buffer_maybe_push/pop, retried (with a yield) while full/empty/busy. */
+    matrix_variant_maybe,
+    /* ring_buffer_deadlock_push/pop, sleeping while full/empty. */
+    matrix_variant_deadlock,
+};
+
+/* Whether pin_current_thread is supported here. Leaves the calling thread alone:
+threads inherit the affinity of the one creating them.
+*/
+static bool
+thread_pinning_supported()
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    return pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+/* Pins the calling thread to `cpu` (modulo the number of cores).
+Returns false where that's not supported.
+*/
+static bool
+pin_current_thread(unsigned cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % std::max(1u, std::thread::hardware_concurrency()), &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+/* Arguments:
+    0 - number of producers
+    1 - number of consumers
+    2 - value size (at least 4 bytes)
+    3 - capacity
+    4 - matrix_variant
+    5 - pin the threads to cores (1) or not (0)
+
+Every iteration moves `matrix_items` items from the producers to the consumers,
+through a RING_BUFFER_MPMC buffer, on threads of its own. Only the transfer is
+timed, from the moment all threads are ready until the last item is popped.
+
+Each item carries the low 32 bits of its push timestamp (steady_clock, in ns), so
+the consumers record the latency from the push call to the end of the pop - which
+includes the time spent waiting in the buffer. Reported as p50/p99/p999/max (ns)
+over all the items of all the iterations.
+*/
+constexpr int64_t matrix_items = 1 << 15;
+
+void
+bm_ring_buffer_matrix(benchmark::State& state)
+{
+    using clock = std::chrono::steady_clock;
+
+    int const producers = (int)state.range(0);
+    int const consumers = (int)state.range(1);
+    size_t const value_size = (size_t)state.range(2);
+    auto const variant = (matrix_variant)state.range(4);
+    bool const pin = state.range(5) != 0;
+
+    if (pin && !thread_pinning_supported()) {
+        state.SkipWithError("thread pinning is not supported here");
+        return;
+    }
+
+    struct ring_buffer* rb;
+    ring_buffer_init_flags(
+        &rb,
+        (rb_size_t)state.range(3),
+        (rb_size_t)value_size,
+        RING_BUFFER_MPMC
+    );
+    std::vector<latency_histogram> histograms((size_t)consumers);
+
+    auto now_ns = []() {
+        return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   clock::now().time_since_epoch()
+        )
+            .count();
+    };
+    auto push = [rb, variant](void const* item) {
+        switch (variant) {
+        case matrix_variant_push:
+            while (!ring_buffer_push(rb, item))
+                std::this_thread::yield();
+            break;
+        case matrix_variant_maybe:
+            while (!ring_buffer_maybe_push(rb, item))
+                std::this_thread::yield();
+            break;
+        case matrix_variant_deadlock:
+            ring_buffer_deadlock_push(rb, item);
+            break;
+        }
+    };
+    auto pop = [rb, variant](void* item) {
+        switch (variant) {
+        case matrix_variant_push:
+            while (!ring_buffer_pop(rb, item))
+                std::this_thread::yield();
+            break;
+        case matrix_variant_maybe:
+            while (!ring_buffer_maybe_pop(rb, item))
+                std::this_thread::yield();
+            break;
+        case matrix_variant_deadlock:
+            ring_buffer_deadlock_pop(rb, item);
+            break;
+        }
+    };
+
+    for (auto _ : state) {
+        std::atomic_int ready = 0;
+        std::atomic_bool go = false;
+        std::vector<std::thread> threads;
+
+        // Each thread moves its share, the first ones take the remainder.
+        auto share = [](int64_t total, int count, int i) {
+            return total / count + (i < total % count ? 1 : 0);
+        };
+        auto start = [&ready, &go, pin](int i) {
+            if (pin)
+                pin_current_thread((unsigned)i);
+            ++ready;
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+        };
+
+        for (int i = 0; i < producers; ++i)
+            threads.emplace_back([&, i]() {
+                std::vector<unsigned char> item(value_size, (unsigned char)i);
+                int64_t const n = share(matrix_items, producers, i);
+
+                start(i);
+                for (int64_t j = 0; j < n; ++j) {
+                    uint32_t const stamp = now_ns();
+                    memcpy(item.data(), &stamp, sizeof(stamp));
+                    push(item.data());
+                }
+            });
+        for (int i = 0; i < consumers; ++i)
+            threads.emplace_back([&, i]() {
+                std::vector<unsigned char> item(value_size);
+                latency_histogram& histogram = histograms[(size_t)i];
+                int64_t const n = share(matrix_items, consumers, i);
+
+                start(producers + i);
+                for (int64_t j = 0; j < n; ++j) {
+                    uint32_t stamp;
+                    pop(item.data());
+                    memcpy(&stamp, item.data(), sizeof(stamp));
+                    histogram.record((uint32_t)(now_ns() - stamp));
+                }
+            });
+
+        while (ready.load() < producers + consumers)
+            std::this_thread::yield();
+        auto const begin = clock::now();
+        go.store(true, std::memory_order_release);
+        for (std::thread& thread : threads)
+            thread.join();
+        state.SetIterationTime(
+            std::chrono::duration<double>(clock::now() - begin).count()
+        );
+    }
+    state.SetItemsProcessed(state.iterations() * matrix_items);
+    state.SetBytesProcessed(state.iterations() * matrix_items * (int64_t)value_size);
+
+    latency_histogram all;
+    for (latency_histogram const& histogram : histograms)
+        all.merge(histogram);
+    state.counters["p50_ns"] = all.percentile(0.50);
+    state.counters["p99_ns"] = all.percentile(0.99);
+    state.counters["p999_ns"] = all.percentile(0.999);
+    state.counters["max_ns"] = all.percentile(1.0);
+
+    ring_buffer_destroy(rb);
+}
+/* 1, 2, 4... producers and consumers, up to the number of cores (at least 2). */
+void
+decorate_ring_buffer_matrix(benchmark::internal::Benchmark* bm)
+{
+    int64_t const max_threads = std::max(2u, std::thread::hardware_concurrency());
+    std::vector<int64_t> threads;
+    for (int64_t n = 1; n <= max_threads; n *= 2)
+        threads.push_back(n);
+
+    bm->ArgNames({
+                     "producers",
+                     "consumers",
+                     "value_size",
+                     "capacity",
+                     "variant",
+                     "pin",
+                 })
+        ->ArgsProduct({
+            threads,
+            threads,
+            { 4, 64, 1024 },
+            { 64, 1024 },
+            { matrix_variant_push, matrix_variant_maybe, matrix_variant_deadlock },
+            { 0, 1 },
+        })
+        ->UseManualTime()
+        ->Unit(benchmark::kMillisecond);
+}
+
+/* A tiny task: some arithmetic, and then maybe two more tasks (a binary tree of
+`depth` levels).
+*/
+static uint32_t
+fan_out_task(uint32_t task, uint32_t* out_children)
+{
+    uint32_t x = task;
+    for (int i = 0; i < 16; ++i)
+        x = x * 1664525u + 1013904223u;
+    benchmark::DoNotOptimize(x);
+
+    if (task == 0)
+        return 0;
+    out_children[0] = task - 1u;
+    out_children[1] = task - 1u;
+    return 2;
+}
+/* Runs the fan_out_task tree from one root on `workers` threads (the first one
+holds the root), until all `2^(depth+1) - 1` tasks ran. Returns the elapsed time.
+
+`get(worker, out_task)` and `put(worker, task)` are the scheduler. Workers count
+their tasks locally and only add them to the shared total every 64 tasks (or when
+idle), so that the total isn't a bottleneck of its own.
+*/
+template<class Get, class Put>
+static double
+run_fan_out(int workers, uint32_t depth, Get get, Put put)
+{
+    int64_t const total = ((int64_t)1 << (depth + 1)) - 1;
+    std::atomic_int64_t done = 0;
+    std::atomic_int ready = 0;
+    std::atomic_bool go = false;
+    std::vector<std::thread> threads;
+
+    put(0, depth);
+    for (int w = 0; w < workers; ++w)
+        threads.emplace_back([&, w]() {
+            int64_t local = 0;
+            uint32_t task;
+            uint32_t children[2];
+
+            ++ready;
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            while (done.load(std::memory_order_relaxed) < total) {
+                if (!get(w, &task)) {
+                    done += local;
+                    local = 0;
+                    std::this_thread::yield();
+                    continue;
+                }
+                uint32_t const n = fan_out_task(task, children);
+                for (uint32_t i = 0; i < n; ++i)
+                    put(w, children[i]);
+                if (++local == 64) {
+                    done += local;
+                    local = 0;
+                }
+            }
+        });
+
+    while (ready.load() < workers)
+        std::this_thread::yield();
+    auto const begin = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread& thread : threads)
+        thread.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin)
+        .count();
+}
+/* Arguments:
+    0 - number of workers
+    1 - depth of the task tree
+
+All workers share one RING_BUFFER_MPMC buffer (big enough for the whole tree), every
+task goes through its READ-AHEAD/WRITE-AHEAD.
+*/
+void
+bm_fan_out_ring_buffer(benchmark::State& state)
+{
+    int const workers = (int)state.range(0);
+    uint32_t const depth = (uint32_t)state.range(1);
+
+    struct ring_buffer* rb;
+    ring_buffer_init(&rb, (rb_size_t)2 << depth, sizeof(uint32_t));
+
+    for (auto _ : state) {
+        state.SetIterationTime(run_fan_out(
+            workers,
+            depth,
+            [rb](int, uint32_t* out_task) { return ring_buffer_pop(rb, out_task); },
+            [rb](int, uint32_t task) { ring_buffer_push(rb, &task); }
+        ));
+    }
+    state.SetItemsProcessed(state.iterations() * (((int64_t)2 << depth) - 1));
+
+    ring_buffer_destroy(rb);
+}
+/* Same as bm_fan_out_ring_buffer, but each worker has a work_deque: it pushes and
+pops its own tasks, and steals from the others (round-robin) when it has none.
+*/
+void
+bm_fan_out_work_deque(benchmark::State& state)
+{
+    int const workers = (int)state.range(0);
+    uint32_t const depth = (uint32_t)state.range(1);
+
+    std::vector<struct work_deque*> deques((size_t)workers);
+    for (struct work_deque*& dq : deques)
+        work_deque_init(&dq, 64, sizeof(uint32_t));
+
+    auto get = [&deques, workers](int w, uint32_t* out_task) {
+        if (work_deque_pop(deques[(size_t)w], out_task))
+            return true;
+        for (int i = 1; i < workers; ++i) {
+            if (work_deque_steal(deques[(size_t)((w + i) % workers)], out_task))
+                return true;
+        }
+        return false;
+    };
+    auto put = [&deques](int w, uint32_t task) {
+        work_deque_push(deques[(size_t)w], &task);
+    };
+
+    for (auto _ : state)
+        state.SetIterationTime(run_fan_out(workers, depth, get, put));
+    state.SetItemsProcessed(state.iterations() * (((int64_t)2 << depth) - 1));
+
+    for (struct work_deque* dq : deques)
+        work_deque_destroy(dq);
+}
+void
+decorate_fan_out(benchmark::internal::Benchmark* bm)
+{
+    int64_t const max_workers = std::max(2u, std::thread::hardware_concurrency());
+    for (int64_t workers = 1; workers <= max_workers; workers *= 2)
+        bm->Args({ workers, 16 });
+    bm->ArgNames({ "workers", "depth" })
+        ->UseManualTime()
+        ->Unit(benchmark::kMillisecond);
+}
+
+/* Arguments:
+    0 - number of lanes
+    1 - number of consumers (the last N threads), the rest are producers.
+
+Same as bm_ring_buffer_multithread_mode, through a lane_ring of 1024 items per
+lane. Each producer thread pushes in its own lane (modulo the number of lanes), so
+with 1 lane all producers share one ring_buffer.
+*/
+void
+bm_lane_ring_multithread(benchmark::State& state)
+{
+    static struct lane_ring* lr;
+    if (state.thread_index() == 0) {
+        lane_ring_init(
+            &lr,
+            (rb_size_t)state.range(0),
+            1024,
+            sizeof(uint64_t),
+            RING_BUFFER_MPMC
+        );
+    }
+
+    int64_t items = 0;
+    if (state.thread_index() >= state.threads() - state.range(1)) {
+        // Reader.
+
+        uint64_t values[16];
+        for (auto _ : state) {
+            for (int i = 0; i < 8; ++i)
+                items += lane_ring_pop_n(lr, values, 16);
+        }
+        benchmark::DoNotOptimize(values);
+    } else {
+        // Writer.
+
+        uint64_t value = 1;
+        for (auto _ : state) {
+            for (int i = 0; i < 128; ++i) {
+                items +=
+                    lane_ring_push_lane(lr, (rb_size_t)state.thread_index(), &value);
+                ++value;
+            }
+        }
+    }
+    state.SetItemsProcessed(items);
+
+    if (state.thread_index() == 0) {
+        lane_ring_destroy(lr);
+    }
+}
+
+/* Arguments:
+    0 - broadcast_ring_flags
+
+Thread 0 pushes, every other thread reads all items through a broadcast_ring of
+1024. items_per_second counts the items pushed, see bm_broadcast_copies.
+*/
+void
+bm_broadcast_ring(benchmark::State& state)
+{
+    static struct broadcast_ring* br;
+    static std::vector<rb_size_t> readers;
+    if (state.thread_index() == 0) {
+        broadcast_ring_init(
+            &br,
+            1024,
+            sizeof(uint64_t),
+            (rb_size_t)state.threads(),
+            (unsigned)state.range(0)
+        );
+        readers.assign((size_t)state.threads(), 0);
+        for (rb_size_t& reader : readers)
+            broadcast_ring_subscribe(br, &reader);
+    }
+
+    int64_t items = 0;
+    if (state.thread_index() != 0) {
+        // Reader. The buffer only exists once the loop starts (it starts with a
+        // barrier).
+
+        uint64_t value;
+        for (auto _ : state) {
+            rb_size_t const reader = readers[(size_t)state.thread_index()];
+            for (int i = 0; i < 128; ++i)
+                broadcast_ring_pop(br, reader, &value, NULL);
+        }
+        benchmark::DoNotOptimize(value);
+    } else {
+        // Writer. Reader 0 is never read, don't wait for it.
+
+        broadcast_ring_unsubscribe(br, readers[0]);
+        uint64_t value = 1;
+        for (auto _ : state) {
+            for (int i = 0; i < 128; ++i) {
+                items += broadcast_ring_push(br, &value);
+                ++value;
+            }
+        }
+    }
+    state.SetItemsProcessed(items);
+
+    if (state.thread_index() == 0) {
+        broadcast_ring_destroy(br);
+    }
+}
+/* The same as bm_broadcast_ring, the way it's done without it: thread 0 pushes a
+copy of each item in one RING_BUFFER_SPSC buffer per reader.
+*/
+void
+bm_broadcast_copies(benchmark::State& state)
+{
+    static std::vector<struct ring_buffer*> rbs;
+    if (state.thread_index() == 0) {
+        rbs.assign((size_t)state.threads(), nullptr);
+        for (struct ring_buffer*& rb : rbs)
+            ring_buffer_init_flags(&rb, 1024, sizeof(uint64_t), RING_BUFFER_SPSC);
+    }
+
+    int64_t items = 0;
+    if (state.thread_index() != 0) {
+        // Reader.
+
+        uint64_t value;
+        for (auto _ : state) {
+            struct ring_buffer* const rb = rbs[(size_t)state.thread_index()];
+            for (int i = 0; i < 128; ++i)
+                ring_buffer_pop(rb, &value);
+        }
+        benchmark::DoNotOptimize(value);
+    } else {
+        // Writer. An item counts once all copies are pushed.
+
+        uint64_t value = 1;
+        for (auto _ : state) {
+            for (int i = 0; i < 128; ++i) {
+                bool pushed = true;
+                for (size_t r = 1; r < rbs.size(); ++r)
+                    pushed &= ring_buffer_push(rbs[r], &value);
+                items += pushed;
+                ++value;
+            }
+        }
+    }
+    state.SetItemsProcessed(items);
+
+    if (state.thread_index() == 0) {
+        for (struct ring_buffer* rb : rbs)
+            ring_buffer_destroy(rb);
+    }
+}
+
 
 void
 decorate_ring_buffer_single_thread(benchmark::internal::Benchmark* bm)
@@ -368,10 +1275,141 @@ decorate_ring_buffer_multi_thread(benchmark::internal::Benchmark* bm)
                     })
         ->Iterations(100000);
 }
+void
+decorate_ring_buffer_batch(benchmark::internal::Benchmark* bm)
+{
+    bm->ArgsProduct({
+        { 1024 },
+        { 1, 4, 16, 64, 256, 1024 },
+    });
+}
 BENCHMARK(bm_ring_buffer_single_thread_deadlock)
     ->Apply(decorate_ring_buffer_single_thread);
 BENCHMARK(bm_ring_buffer_single_thread)->Apply(decorate_ring_buffer_single_thread);
 BENCHMARK(bm_ring_buffer_single_thread_maybe)
     ->Apply(decorate_ring_buffer_single_thread);
 
-BENCHMARK_MAIN();
\ No newline at end of file
+BENCHMARK(bm_ring_buffer_single_thread_copy)
+    ->ArgsProduct({
+        { 64 },
+        { 8, 64, 256, 512 },
+    });
+BENCHMARK(bm_ring_buffer_single_thread_zero_copy)
+    ->ArgsProduct({
+        { 64 },
+        { 8, 64, 256, 512 },
+    });
+
+BENCHMARK_TEMPLATE(bm_ring_buffer_single_thread_generic, int)
+    ->ArgNames({ "items", "flags" })
+    ->ArgsProduct({ { 16, 256 }, { RING_BUFFER_MPMC, RING_BUFFER_SLOT_SEQUENCES } });
+BENCHMARK_TEMPLATE(
+    bm_ring_buffer_single_thread_typed,
+    int,
+    ring_buffer_int,
+    ring_buffer_init_int,
+    ring_buffer_push_int,
+    ring_buffer_pop_int
+)
+    ->ArgNames({ "items" })
+    ->Args({ 16 })
+    ->Args({ 256 });
+BENCHMARK_TEMPLATE(bm_ring_buffer_single_thread_generic, uint64_t)
+    ->ArgNames({ "items", "flags" })
+    ->ArgsProduct({ { 16, 256 }, { RING_BUFFER_MPMC, RING_BUFFER_SLOT_SEQUENCES } });
+BENCHMARK_TEMPLATE(
+    bm_ring_buffer_single_thread_typed,
+    uint64_t,
+    ring_buffer_u64,
+    ring_buffer_init_u64,
+    ring_buffer_push_u64,
+    ring_buffer_pop_u64
+)
+    ->ArgNames({ "items" })
+    ->Args({ 16 })
+    ->Args({ 256 });
+
+BENCHMARK(bm_ring_buffer_single_thread_batch)->Apply(decorate_ring_buffer_batch);
+BENCHMARK(bm_ring_buffer_single_thread_batch_per_item)
+    ->Apply(decorate_ring_buffer_batch);
+BENCHMARK(bm_ring_buffer_single_thread_spans)
+    ->ArgNames({ "batch", "flags" })
+    ->ArgsProduct({ { 3, 100, 300 }, { RING_BUFFER_MPMC, RING_BUFFER_DOUBLE_MAPPED } });
+BENCHMARK(bm_ring_buffer_multithread_batch)
+    ->Apply(decorate_ring_buffer_batch)
+    ->Threads(2);
+
+BENCHMARK(bm_ring_buffer_multithread)
+    ->ArgNames({ "capacity", "flags" })
+    ->ArgsProduct({
+        { 1024 },
+        {
+            RING_BUFFER_MPMC,
+            RING_BUFFER_PAD_SLOTS,
+            RING_BUFFER_INLINE_DATA,
+            RING_BUFFER_PAD_SLOTS | RING_BUFFER_INLINE_DATA,
+            RING_BUFFER_SLOT_SEQUENCES,
+            RING_BUFFER_SLOT_SEQUENCES | RING_BUFFER_PAD_SLOTS,
+        },
+    })
+    ->Iterations(20000)
+    ->ThreadRange(2, std::max(2, (int)std::thread::hardware_concurrency() * 2))
+    ->UseRealTime();
+
+BENCHMARK(bm_ring_buffer_multithread_mode)
+    ->ArgNames({ "capacity", "flags", "producers" })
+    ->Args({ 1024, RING_BUFFER_MPMC, 1 })
+    ->Args({ 1024, RING_BUFFER_SPSC, 1 })
+    ->Threads(2);
+BENCHMARK(bm_ring_buffer_multithread_mode)
+    ->ArgNames({ "capacity", "flags", "producers" })
+    ->Args({ 1024, RING_BUFFER_MPMC, 3 })
+    ->Args({ 1024, RING_BUFFER_MPMC | RING_BUFFER_PAD_SLOTS, 3 })
+    ->Args({ 1024, RING_BUFFER_MPMC | RING_BUFFER_INLINE_DATA, 3 })
+    ->Args({ 1024, RING_BUFFER_MPSC, 3 })
+    ->Args({ 1024, RING_BUFFER_MPMC, 1 })
+    ->Args({ 1024, RING_BUFFER_SPMC, 1 })
+    ->Threads(4);
+
+BENCHMARK(bm_lane_ring_multithread)
+    ->ArgNames({ "lanes", "consumers" })
+    ->ArgsProduct({ { 1, 2, 4 }, { 1 } })
+    ->Threads(5)
+    ->UseRealTime();
+BENCHMARK(bm_lane_ring_multithread)
+    ->ArgNames({ "lanes", "consumers" })
+    ->ArgsProduct({ { 1, 4, 8, 16 }, { 2 } })
+    ->Threads(18)
+    ->UseRealTime();
+
+BENCHMARK(bm_broadcast_ring)
+    ->ArgNames({ "flags" })
+    ->Args({ 0 })
+    ->Args({ BROADCAST_RING_LOSSY })
+    ->ThreadRange(2, 8)
+    ->UseRealTime();
+BENCHMARK(bm_broadcast_copies)->ThreadRange(2, 8)->UseRealTime();
+
+BENCHMARK(bm_ring_buffer_matrix)->Apply(decorate_ring_buffer_matrix);
+
+BENCHMARK(bm_fan_out_ring_buffer)->Apply(decorate_fan_out);
+BENCHMARK(bm_fan_out_work_deque)->Apply(decorate_fan_out);
+
+/* Build once with and once without CDATAUTILS_RINGBUFFER_64BIT_INDICES to compare
+the index widths, the context tells the runs apart (and can be used with
+benchmark's compare.py).
+*/
+int
+main(int argc, char** argv)
+{
+    benchmark::AddCustomContext(
+        "rb_size_t",
+        sizeof(rb_size_t) == 8 ? "64-bit" : "32-bit"
+    );
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
\ No newline at end of file
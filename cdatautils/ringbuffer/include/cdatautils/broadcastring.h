@@ -0,0 +1,128 @@
+#ifndef CDATAUTILS_BROADCAST_RING_H
+#define CDATAUTILS_BROADCAST_RING_H
+
+#include <cdatautils/ringbuffer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#define restrict
+#endif
+
+/* A multi-producer, lock-free, power-of-two circular buffer where every reader
+sees every item (one-to-many, like a disruptor), instead of each item going to
+one consumer.
+
+Producers claim with WRITE-AHEAD and publish with WRITE, in claim order, like
+ring_buffer. There is no READ: each reader has its own cursor, and pops never
+remove anything. Producers are gated on the slowest reader instead - a slot is
+only reused once every subscribed reader has moved past it.
+
+With BROADCAST_RING_LOSSY, producers are not gated at all: they overwrite the
+oldest items, and a reader that fell more than `capacity` items behind is told
+how many it missed.
+*/
+struct broadcast_ring;
+
+/* Flags for broadcast_ring_init. */
+enum broadcast_ring_flags
+{
+    /* Readers never hold producers back: a push always succeeds, overwriting the
+    oldest item. Slow readers skip what was overwritten (see broadcast_ring_pop).
+
+    An item is copied out and then checked against WRITE-AHEAD, and dropped if a
+    producer may have started overwriting it meanwhile, so readers never return
+    half-written items.
+    */
+    BROADCAST_RING_LOSSY = 1u << 0,
+};
+
+/* Initializes a broadcast_ring with a combination of `enum broadcast_ring_flags`,
+with room for up to `max_readers` subscribed readers.
+
+Not thread-safe.
+
+Preconditions:
+    - capacity MUST be a power-of-two and > 1.
+    - value_size MUST be > 0
+    - max_readers MUST be > 0
+*/
+void broadcast_ring_init(
+    struct broadcast_ring** restrict,
+    rb_size_t capacity,
+    rb_size_t value_size,
+    rb_size_t max_readers,
+    unsigned flags
+);
+
+/* Destroys a broadcast_ring immediately, free()-ing all resources.
+
+Not thread-safe.
+*/
+void broadcast_ring_destroy(struct broadcast_ring* restrict);
+
+/* Subscribes a new reader, writing its id in `out_reader`. The reader starts at
+WRITE: it sees the items pushed after this call (and maybe some in the middle of
+being pushed).
+
+Returns true if the reader was subscribed.
+Returns false if there were already `max_readers` readers.
+
+Thread safe.
+*/
+bool broadcast_ring_subscribe(
+    struct broadcast_ring* restrict,
+    rb_size_t* restrict out_reader
+);
+/* Unsubscribes `reader`, producers stop waiting for it. Its id may be given to
+another reader afterwards.
+
+Must be called by the thread that reads as `reader`.
+*/
+void broadcast_ring_unsubscribe(struct broadcast_ring* restrict, rb_size_t reader);
+
+/* Pushes a copy of `item`, for all readers.
+
+Returns true if the push was successful.
+Returns false if the slowest reader is `capacity` items behind (never with
+BROADCAST_RING_LOSSY).
+
+Thread safe.
+
+Blocking reasons:
+    - Other producers are currently pushing (multi-producer).
+*/
+bool broadcast_ring_push(struct broadcast_ring* restrict, void const* restrict item);
+
+/* Copies the next item of `reader` in `out_item`, and moves its cursor past it.
+
+With BROADCAST_RING_LOSSY, `*out_missed` (if not NULL) is set to the number of
+items the reader skipped because they were overwritten before it got to them (0
+otherwise, and always 0 without the flag).
+
+Returns true if the pop was successful.
+Returns false if the reader has seen every pushed item.
+
+Only ONE thread reads as a given `reader` (different readers are independent).
+*/
+bool broadcast_ring_pop(
+    struct broadcast_ring* restrict,
+    rb_size_t reader,
+    void* restrict out_item,
+    rb_size_t* restrict out_missed
+);
+
+/* Returns the number of items `reader` has not seen yet (at most `capacity`).
+
+This value will always be inaccurate if used with multiple producers.
+*/
+rb_size_t broadcast_ring_size(struct broadcast_ring* restrict, rb_size_t reader);
+/* Returns the capacity of the buffer.
+Thread safe.
+*/
+rb_size_t broadcast_ring_capacity(struct broadcast_ring* restrict);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef CDATAUTILS_BYTE_RING_H
+#define CDATAUTILS_BYTE_RING_H
+
+#include <cdatautils/ringbuffer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#define restrict
+#endif
+
+/* A multi-consumer, multi-producer, lock-free, power-of-two circular buffer of
+variable-length records (bytes).
+
+Works like ring_buffer (claim with WRITE-AHEAD/READ-AHEAD, publish with
+WRITE/READ, in claim order), but every record is stored contiguously as a
+header (its size) followed by the payload, padded to 8 bytes. A record never
+wraps around: if it doesn't fit before the end of the storage, a padding record
+fills the rest and the record starts over at offset 0.
+*/
+struct byte_ring;
+
+/* The size of the header in front of each record (and the payload alignment). */
+#define BYTE_RING_HEADER_SIZE 8u
+
+/* A record inside a byte_ring's storage, handed out by byte_ring_reserve and
+byte_ring_peek.
+*/
+struct byte_ring_record
+{
+    /* Pointer to the payload, inside the ring's storage. Aligned to 8 bytes.
+
+    NULL if nothing was reserved/peeked.
+    */
+    void* data;
+
+    /* The size of the payload, in bytes. */
+    rb_size_t size;
+
+    /* The WRITE-AHEAD/READ-AHEAD position of the claim, and its size in bytes
+    (header, payload and padding included).
+
+    Modifying manually:
+        Don't.
+    */
+    rb_size_t first;
+    rb_size_t claimed;
+};
+
+/* Called by byte_ring_drain for each record. `data` is only valid during the call. */
+typedef void byte_ring_drain_fn(void* user, void const* data, rb_size_t size);
+
+/* Initializes a byte_ring of `capacity` bytes.
+
+Not thread-safe.
+
+Preconditions:
+    - capacity MUST be a power-of-two and >= 16.
+*/
+void byte_ring_init(struct byte_ring** restrict, rb_size_t capacity);
+
+/* Destroys a byte_ring immediately, free()-ing all resources.
+
+Not thread-safe.
+*/
+void byte_ring_destroy(struct byte_ring* restrict);
+
+/* Returns the size of the storage, in bytes.
+Thread safe.
+*/
+rb_size_t byte_ring_capacity(struct byte_ring* restrict);
+
+/* Returns the biggest payload that can ever be pushed (capacity / 2 - header).
+
+Anything bigger may need more than the whole storage, once padding is counted.
+Thread safe.
+*/
+rb_size_t byte_ring_max_record_size(struct byte_ring* restrict);
+
+/* Returns the difference between WRITE and READ, in bytes (headers and padding
+included).
+
+This value will always be inaccurate if used with multiple producers/consumers.
+*/
+rb_size_t byte_ring_size(struct byte_ring* restrict);
+
+/* Reserves a record of `size` bytes for writing in place, without copying.
+
+The producer writes the payload directly in `out_record->data` and then
+publishes it with byte_ring_commit.
+
+Every successful reserve MUST be followed by exactly one commit of the same
+record. Until then, other producers that have reserved after us cannot finish,
+so keep the gap short.
+
+Returns true if the record was reserved.
+Returns false if there was not enough space (`out_record->data` is NULL).
+
+Thread safe.
+
+Blocking reasons:
+    - Other producers are currently pushing (multi-producer).
+
+Failure reasons:
+    - The ring doesn't have space for the record (and padding, if it wraps).
+    - `size` is bigger than byte_ring_max_record_size.
+*/
+bool byte_ring_reserve(
+    struct byte_ring* restrict,
+    rb_size_t size,
+    struct byte_ring_record* restrict out_record
+);
+/* Publishes a record returned by byte_ring_reserve, making it visible to
+consumers.
+
+Thread safe.
+
+Blocking reasons:
+    - Other producers that reserved before us haven't committed yet.
+*/
+void byte_ring_commit(
+    struct byte_ring* restrict,
+    struct byte_ring_record const* restrict record
+);
+/* Pushes a copy of `size` bytes from `data` as one record.
+
+Equivalent to byte_ring_reserve + memcpy + byte_ring_commit.
+
+Returns true if the push was successful.
+Returns false if there was not enough space.
+
+Thread safe.
+
+Blocking reasons:
+    - Other producers are currently pushing (multi-producer).
+*/
+bool byte_ring_push(
+    struct byte_ring* restrict,
+    void const* restrict data,
+    rb_size_t size
+);
+
+/* Takes the oldest record for reading in place, without copying.
+
+The record is removed from the ring (no other consumer will see it), but its
+bytes are not reused by producers until byte_ring_release.
+
+Every successful peek MUST be followed by exactly one release of the same record.
+
+Returns true if a record was taken.
+Returns false if the ring was empty (`out_record->data` is NULL).
+
+Thread safe.
+
+Blocking reasons:
+    - Other consumers are currently popping (multi-consumer).
+*/
+bool byte_ring_peek(
+    struct byte_ring* restrict,
+    struct byte_ring_record* restrict out_record
+);
+/* Gives the bytes of a record returned by byte_ring_peek back to the producers.
+`record->data` must not be accessed after this.
+
+Thread safe.
+
+Blocking reasons:
+    - Other consumers that peeked before us haven't released yet.
+*/
+void byte_ring_release(
+    struct byte_ring* restrict,
+    struct byte_ring_record const* restrict record
+);
+/* Pops the oldest record, copying its payload in `out_data`.
+
+`*out_size` is always set to the size of the oldest record (0 if the ring was
+empty), so a caller whose buffer was too small can retry with a bigger one.
+
+Returns true if the pop was successful.
+Returns false if the ring was empty, or the record is bigger than `out_capacity`
+(it is left in the ring).
+
+Thread safe.
+
+Blocking reasons:
+    - Other consumers are currently popping (multi-consumer).
+*/
+bool byte_ring_pop(
+    struct byte_ring* restrict,
+    void* restrict out_data,
+    rb_size_t out_capacity,
+    rb_size_t* restrict out_size
+);
+/* Takes up to `max_records` records at once and calls `fn` for each of them, in
+order. The whole batch is claimed with a single update of READ-AHEAD and given
+back with a single update of READ.
+
+`fn` must not use this byte_ring (the batch's bytes are only given back after
+the last call).
+
+Returns the number of records drained.
+Returns 0 if the ring was empty.
+
+Thread safe.
+
+Blocking reasons:
+    - Other consumers are currently popping (multi-consumer).
+*/
+rb_size_t byte_ring_drain(
+    struct byte_ring* restrict,
+    byte_ring_drain_fn* fn,
+    void* user,
+    rb_size_t max_records
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
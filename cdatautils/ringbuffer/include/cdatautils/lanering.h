@@ -0,0 +1,152 @@
+#ifndef CDATAUTILS_LANE_RING_H
+#define CDATAUTILS_LANE_RING_H
+
+#include <cdatautils/ringbuffer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#define restrict
+#endif
+
+/* A queue made of K independent ring_buffers ("lanes"), for many producers.
+
+With one ring_buffer, every producer goes through the same WRITE-AHEAD CAS and
+then waits for the producers in front of it to publish WRITE. A lane_ring gives
+each producer thread (or group of producers, or CPU) its own lane instead, so
+producers only contend with the others of their lane. Consumers poll the lanes
+round-robin.
+
+Items are FIFO within a lane, but there is no order between lanes. Where global
+order matters, LANE_RING_STAMPS numbers every item at push time, and a single
+consumer can merge the lanes back in that order (lane_ring_pop_ordered).
+*/
+struct lane_ring;
+
+/* Flags for lane_ring_init, ORed with the `enum ring_buffer_flags` of the lanes. */
+enum lane_ring_flags
+{
+    /* Stamp every item with a global sequence number, taken from one shared counter
+    when it is pushed (so producers contend on that counter again, but not on the
+    lanes' WRITE-AHEAD/WRITE). Costs 8 bytes per slot.
+
+    The stamps of a lane are increasing if the lane has a single producer.
+
+    Can't be combined with RING_BUFFER_OVERWRITE: stamped items are written and
+    read in place, which overwriting lanes don't support.
+    */
+    LANE_RING_STAMPS = 1u << 16,
+};
+
+/* Initializes a lane_ring of `lanes` lanes of `lane_capacity` items each.
+
+`flags` is a combination of `enum lane_ring_flags` and of `enum ring_buffer_flags`
+for the lanes (for example RING_BUFFER_SPMC if each lane has exactly one producer,
+or RING_BUFFER_MPSC for a single consumer).
+
+Not thread-safe.
+
+Preconditions:
+    - lanes MUST be > 0.
+    - lane_capacity MUST be a power-of-two and > 1.
+    - value_size MUST be > 0
+    - flags MUST NOT combine LANE_RING_STAMPS with RING_BUFFER_OVERWRITE.
+*/
+void lane_ring_init(
+    struct lane_ring** restrict,
+    rb_size_t lanes,
+    rb_size_t lane_capacity,
+    rb_size_t value_size,
+    unsigned flags
+);
+
+/* Destroys a lane_ring immediately, free()-ing all resources.
+
+Not thread-safe.
+*/
+void lane_ring_destroy(struct lane_ring* restrict);
+
+/* Pushes a copy of `item` in the lane of the calling thread.
+
+Threads are given lanes round-robin, the first time they push (in any lane_ring),
+so with no more producer threads than lanes, each one has a lane of its own.
+
+Returns true if the push was successful.
+Returns false if the lane was full (the other lanes are not tried, so that the
+items of a thread stay in order).
+
+Thread safe (see ring_buffer_push, for the lane).
+*/
+bool lane_ring_push(struct lane_ring* restrict, void const* restrict item);
+/* Same as lane_ring_push, in lane `lane % lanes` (for example the current CPU, or
+the producer's group).
+*/
+bool lane_ring_push_lane(
+    struct lane_ring* restrict,
+    rb_size_t lane,
+    void const* restrict item
+);
+
+/* Pops an item, from the first lane that isn't empty. Each call starts one lane
+after where the previous call of this thread stopped, so that all lanes are served.
+
+Returns true if the pop was successful.
+Returns false if all lanes were empty.
+
+Thread safe (see ring_buffer_pop, for each lane).
+*/
+bool lane_ring_pop(struct lane_ring* restrict, void* restrict out_item);
+/* Same as lane_ring_pop, also writing the stamp of the item in `out_stamp`.
+
+LANE_RING_STAMPS only.
+*/
+bool lane_ring_pop_stamped(
+    struct lane_ring* restrict,
+    void* restrict out_item,
+    uint64_t* restrict out_stamp
+);
+/* Pops up to `n_items` items in `out_items`, going around the lanes once and taking
+as many as possible from each lane in one batch.
+
+Returns the number of popped items.
+Returns 0 if all lanes were empty.
+
+Thread safe (see ring_buffer_pop_n, for each lane).
+*/
+rb_size_t lane_ring_pop_n(
+    struct lane_ring* restrict,
+    void* restrict out_items,
+    rb_size_t n_items
+);
+/* Pops the item with the smallest stamp among the first item of every lane.
+
+The first item of each lane is taken out of its lane and kept aside until it is
+the smallest. Items in the middle of a push (stamped, but not published yet) are
+not seen: the order is exact among the items pushed before the call.
+
+Returns true if the pop was successful.
+Returns false if all lanes were empty.
+
+LANE_RING_STAMPS only. Only ONE consumer, which uses no other pop function.
+*/
+bool lane_ring_pop_ordered(
+    struct lane_ring* restrict,
+    void* restrict out_item,
+    uint64_t* restrict out_stamp
+);
+
+/* Returns the sum of the sizes of the lanes (plus the items kept aside by
+lane_ring_pop_ordered).
+
+This value will always be inaccurate if used with multiple producers/consumers.
+*/
+rb_size_t lane_ring_size(struct lane_ring* restrict);
+/* Returns the number of lanes.
+Thread safe.
+*/
+rb_size_t lane_ring_lanes(struct lane_ring* restrict);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -4,6 +4,19 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/* Atomics for CDATAUTILS_RING_BUFFER_DEFINE, which is also usable from C++. */
+#ifdef __cplusplus
+#include <atomic>
+#define CDATAUTILS_RING_BUFFER_ATOMIC(type) std::atomic<type>
+#define CDATAUTILS_RING_BUFFER_STD std::
+#define CDATAUTILS_RING_BUFFER_STATIC_ASSERT static_assert
+#else
+#include <stdatomic.h>
+#define CDATAUTILS_RING_BUFFER_ATOMIC(type) _Atomic type
+#define CDATAUTILS_RING_BUFFER_STD
+#define CDATAUTILS_RING_BUFFER_STATIC_ASSERT _Static_assert
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #define restrict
@@ -13,15 +26,209 @@ extern "C" {
 #define CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE 64
 #endif
 
+/* How many times the blocking functions spin (busy-wait), and then how many times
+they yield their time slice, before going to sleep.
+*/
+#ifndef CDATAUTILS_RING_BUFFER_SPIN_COUNT
+#define CDATAUTILS_RING_BUFFER_SPIN_COUNT 64
+#endif
+#ifndef CDATAUTILS_RING_BUFFER_YIELD_COUNT
+#define CDATAUTILS_RING_BUFFER_YIELD_COUNT 16
+#endif
+
+/* The type of capacities, sizes and of the WRITE/READ counters.
+
+32-bit by default. The counters then wrap around every 4G items (harmless on its
+own, all comparisons are modular) and capacity is limited to 2^31. Define
+CDATAUTILS_RING_BUFFER_64BIT_INDICES (the CDATAUTILS_RINGBUFFER_64BIT_INDICES
+CMake option - it must be the same for the library and everything including this
+header) for 64-bit ones:
+    - Capacities above 2^31.
+    - No wrap around in practice (~580 years at 1G items per second). With 32 bits,
+      a thread preempted between loading WRITE-AHEAD/READ-AHEAD and its CAS for
+      exactly 2^32 items would succeed on a stale value (ABA).
+    - Costs twice the memory per sequence with RING_BUFFER_SLOT_SEQUENCES, and
+      64-bit atomics (a lock on some 32-bit platforms).
+
+`rb_ssize_t` is the signed type of the same width, for modular comparisons.
+*/
+#ifdef CDATAUTILS_RING_BUFFER_64BIT_INDICES
+typedef uint64_t rb_size_t;
+typedef int64_t rb_ssize_t;
+#else
 typedef uint32_t rb_size_t;
+typedef int32_t rb_ssize_t;
+#endif
+
+/* The number of per-thread shards of the counters, with CDATAUTILS_RING_BUFFER_STATS.
+Each one takes a couple of cache lines in every ring_buffer.
+*/
+#ifndef CDATAUTILS_RING_BUFFER_STATS_SHARDS
+#define CDATAUTILS_RING_BUFFER_STATS_SHARDS 16
+#endif
 
 /* A multi-consumer, multi-producer, lock-free, power-of-two circular buffer. */
 struct ring_buffer;
 
+/* A contiguous run of slots inside a ring_buffer's storage, handed out by
+ring_buffer_reserve_write and ring_buffer_peek_read.
+*/
+struct ring_buffer_span
+{
+    /* Pointer to the first item of the span, inside the buffer's storage.
+
+    NULL if nothing was reserved/peeked.
+    */
+    void* data;
+
+    /* The number of items in the span. */
+    rb_size_t count;
+
+    /* The distance between two items of the span, in bytes. The buffer's value_size,
+    unless it was created with RING_BUFFER_PAD_SLOTS.
+    */
+    rb_size_t stride;
+
+    /* The WRITE-AHEAD/READ-AHEAD slot of the first item.
+
+    Modifying manually:
+        Don't.
+    */
+    rb_size_t first;
+};
+
+/* Flags for ring_buffer_init_flags. */
+enum ring_buffer_flags
+{
+    /* Multi-producer, multi-consumer. The default, works with any number of threads.
+     */
+    RING_BUFFER_MPMC = 0,
+
+    /* Only ONE thread ever pushes (for the whole lifetime of the buffer).
+
+    Pushing doesn't need a CAS on WRITE-AHEAD, nor waiting for other producers.
+    */
+    RING_BUFFER_SINGLE_PRODUCER = 1u << 0,
+
+    /* Only ONE thread ever pops (for the whole lifetime of the buffer).
+
+    Popping doesn't need a CAS on READ-AHEAD, nor waiting for other consumers.
+    ring_buffer_clear must be called from the consumer's thread.
+    */
+    RING_BUFFER_SINGLE_CONSUMER = 1u << 1,
+
+    /* Use a sequence number per slot (D. Vyukov's bounded MPMC queue) instead of
+    publishing WRITE/READ in claim order.
+
+    Producers never wait for each other, nor consumers for each other: each one
+    only looks at the sequence of its own slot. A producer preempted in the
+    middle of a push no longer stalls every producer behind it - only consumers
+    see the buffer as "empty" at its slot until it finishes (and producers see
+    it as "full" at the slot of a preempted consumer).
+
+    Costs `capacity * sizeof(rb_size_t)` extra memory. The SINGLE_* flags are
+    ignored, ring_buffer_clear has to free every slot, and ring_buffer_size also
+    counts the items that are in the middle of a push/pop.
+    */
+    RING_BUFFER_SLOT_SEQUENCES = 1u << 2,
+
+    /* Give each slot (and each sequence, with RING_BUFFER_SLOT_SEQUENCES) its own
+    cache line(s), so that threads working on neighbouring slots don't false-share.
+
+    Uses `CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE / value_size` times more memory for
+    small items, and batches copy item by item. Spans have a `stride` of
+    value_size rounded up to CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE.
+    */
+    RING_BUFFER_PAD_SLOTS = 1u << 3,
+
+    /* Allocate the slots in the same (cache line aligned) block as the buffer
+    itself, right after the counters. One allocation instead of two, and the items
+    are next to the rest of the buffer's hot data.
+    */
+    RING_BUFFER_INLINE_DATA = 1u << 4,
+
+    /* Map the slots twice, back to back (a "magic ring"), so that slot
+    `capacity + i` is slot `i`. Batches are copied with a single memcpy, and spans
+    don't stop at the wrap point: ring_buffer_reserve_write/ring_buffer_peek_read
+    can return up to `capacity` items as one flat array.
+
+    Only when `capacity * value_size` (the stride, with RING_BUFFER_PAD_SLOTS) is a
+    multiple of the page size, and only on Linux (memfd + mmap) for now. Otherwise
+    the flag is dropped and the buffer works as without it - spans may still stop
+    at the wrap point. Implies not RING_BUFFER_INLINE_DATA.
+    */
+    RING_BUFFER_DOUBLE_MAPPED = 1u << 5,
+
+    /* Overwrite the oldest item when the buffer is full, instead of failing (a
+    flight recorder: the last `capacity` items are kept, consumers move forward
+    past what was overwritten). Pushes never fail nor block, and never wait for
+    consumers.
+
+    Each slot has a sequence number used as a seqlock: it holds the lap of the
+    item in the slot, and whether a producer is in the middle of writing it.
+    Consumers copy the item out, then check that the sequence didn't change, so
+    they never return a half-overwritten item. The items consumers skipped are
+    counted in ring_buffer_dropped.
+
+    Costs `capacity * sizeof(rb_size_t)` extra memory. The SINGLE_* and
+    RING_BUFFER_SLOT_SEQUENCES flags are ignored. Spans (ring_buffer_reserve_write,
+    ring_buffer_peek_read) and ring_buffer_pop_n_exact are not available, they
+    always return 0/false: a consumer can't keep slots that producers may
+    overwrite at any time.
+    */
+    RING_BUFFER_OVERWRITE = 1u << 6,
+
+    /* Back the slots (and sequences) with 2 MB huge pages, to cut TLB misses on
+    big buffers. Tries MAP_HUGETLB (reserved huge pages) first, then falls back
+    to a 2 MB aligned mapping with madvise(MADV_HUGEPAGE) (transparent huge
+    pages). The storage is rounded up to a multiple of 2 MB.
+
+    Linux only for now, elsewhere the flag is dropped. Implies not
+    RING_BUFFER_INLINE_DATA, ignored with RING_BUFFER_DOUBLE_MAPPED and by
+    ring_buffer_init_shm.
+    */
+    RING_BUFFER_HUGE_PAGES = 1u << 7,
+
+    /* Touch every page of the storage in ring_buffer_init_flags, so that the first
+    laps don't pay for page faults (and so that the pages are placed by the
+    NUMA flags right away, not by whichever thread touches them first).
+    */
+    RING_BUFFER_PREFAULT = 1u << 8,
+
+    /* Spread the pages of the storage over all NUMA nodes (mbind MPOL_INTERLEAVE),
+    for buffers used from threads on every node. See also RING_BUFFER_NUMA_NODE.
+
+    Linux only for now, elsewhere the flag is dropped. Implies not
+    RING_BUFFER_INLINE_DATA. Best effort: without NUMA support in the kernel, the
+    buffer is placed as usual.
+    */
+    RING_BUFFER_NUMA_INTERLEAVE = 1u << 9,
+
+    /* Single-producer, single-consumer (a thread-to-thread pipe). */
+    RING_BUFFER_SPSC = RING_BUFFER_SINGLE_PRODUCER | RING_BUFFER_SINGLE_CONSUMER,
+    /* Multi-producer, single-consumer. */
+    RING_BUFFER_MPSC = RING_BUFFER_SINGLE_CONSUMER,
+    /* Single-producer, multi-consumer. */
+    RING_BUFFER_SPMC = RING_BUFFER_SINGLE_PRODUCER,
+};
+
+/* A flag for ring_buffer_init_flags: bind the pages of the storage to NUMA node
+`node` (mbind MPOL_BIND), where its producers and consumers run.
+`node` MUST be < 64. Same platform support as RING_BUFFER_NUMA_INTERLEAVE.
+*/
+#define RING_BUFFER_NUMA_NODE(node) (((unsigned)(node) + 1u) << 24)
+/* The bits of the flags used by RING_BUFFER_NUMA_NODE. */
+#define RING_BUFFER_NUMA_NODE_MASK (0x7fu << 24)
+
 /* Initializes a ring_buffer.
 
 Not thread-safe.
 
+Equivalent to:
+```
+ring_buffer_init_flags(rb, capacity, value_size, RING_BUFFER_MPMC);
+```
+
 Preconditions:
     - capacity MUST be a power-of-two and > 1.
     - value_size MUST be > 0
@@ -31,9 +238,79 @@ void ring_buffer_init(
     rb_size_t capacity,
     rb_size_t value_size
 );
+/* Initializes a ring_buffer with a combination of `enum ring_buffer_flags`.
+
+The flags select the implementation used by all other ring_buffer_* functions
+for this buffer. Breaking the promises made by the flags (for example pushing
+from two threads on a RING_BUFFER_SINGLE_PRODUCER buffer) is undefined behaviour.
+
+Not thread-safe.
+
+Preconditions:
+    - capacity MUST be a power-of-two and > 1.
+    - value_size MUST be > 0
+*/
+void ring_buffer_init_flags(
+    struct ring_buffer** restrict,
+    rb_size_t capacity,
+    rb_size_t value_size,
+    unsigned flags
+);
+
+/* Initializes a ring_buffer inside the shared memory object `fd`, so that other
+processes can use it too (see ring_buffer_attach_shm). `fd` is resized to fit the
+whole buffer - header, slots and sequences, in this order - and mapped.
+
+The buffer works exactly like one from ring_buffer_init_flags (all operations
+are the same lock-free ones, blocking ones can wait for a push/pop from another
+process), with a few differences:
+    - The storage is always inline (RING_BUFFER_INLINE_DATA is implied, and
+      RING_BUFFER_DOUBLE_MAPPED is ignored).
+    - The SINGLE_* flags mean one thread across ALL processes.
+    - Wake-ups use full fences, as the OS can't run a barrier on another process.
+    - A process that dies in the middle of a push/pop blocks the others forever,
+      like a thread would.
+
+`fd` can come from memfd_create (then passed to other processes by fork or over a
+unix socket) or from shm_open (a name under /dev/shm). It can be closed after this
+call, the mapping stays until ring_buffer_destroy.
+
+Not thread-safe.
+
+Returns true if the buffer was created.
+Returns false if `fd` couldn't be resized or mapped, or the platform has no mmap.
+
+Preconditions:
+    - capacity MUST be a power-of-two and > 1.
+    - value_size MUST be > 0
+    - No other process is attached to `fd` yet.
+*/
+bool ring_buffer_init_shm(
+    struct ring_buffer** restrict,
+    int fd,
+    rb_size_t capacity,
+    rb_size_t value_size,
+    unsigned flags
+);
+/* Maps a ring_buffer created by ring_buffer_init_shm, possibly in another process.
+The mapping can be at a different address in each process.
+
+Fails if `fd` doesn't hold a ring_buffer, or one from an incompatible version of
+this library (or built with another CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE).
+
+Not thread-safe.
+
+Returns true if the buffer was attached.
+Returns false otherwise (nothing is mapped).
+*/
+bool ring_buffer_attach_shm(struct ring_buffer** restrict, int fd);
 
 /* Destroys a ring buffer immediately, free()-ing all resources.
 
+Buffers from ring_buffer_init_shm/ring_buffer_attach_shm are only unmapped from
+the calling process, the shared memory object lives until every process has
+unmapped it (and closed its file descriptors, or shm_unlink-ed its name).
+
 Not thread-safe.
 */
 void ring_buffer_destroy(struct ring_buffer* restrict);
@@ -44,6 +321,11 @@ if the buffer is full and there are no consumers!
 This function always either successfully pushes or blocks until there's space
 in the buffer.
 
+While the buffer is full, it spins for a bit (CDATAUTILS_RING_BUFFER_SPIN_COUNT),
+then yields (CDATAUTILS_RING_BUFFER_YIELD_COUNT), and then sleeps (futex on Linux)
+until a consumer pops something. Consumers only make a syscall to wake it up
+if someone is actually sleeping.
+
 Thread safe.
 
 Blocking reasons:
@@ -51,6 +333,26 @@ Blocking reasons:
     - Other producers are currently pushing (multi-producer).
 */
 void ring_buffer_deadlock_push(struct ring_buffer* restrict, void const* restrict item);
+/* Pushes a single item on the buffer, waiting for space for at most `timeout_ns`
+nanoseconds. Waits the same way as ring_buffer_deadlock_push.
+
+Returns true if the push was successful.
+Returns false if the buffer was still full after `timeout_ns`.
+
+Thread safe.
+
+Blocking reasons:
+    - The buffer is full (up to `timeout_ns`).
+    - Other producers are currently pushing (multi-producer).
+
+Failure reasons:
+    - The buffer is full.
+*/
+bool ring_buffer_push_timeout(
+    struct ring_buffer* restrict,
+    void const* restrict item,
+    uint64_t timeout_ns
+);
 /* Pushes a single item on the buffer. Fails if buffer is full.
 
 Assuming no producer has crashed in the middle of writing, this operation is guaranteed
@@ -82,10 +384,54 @@ Failure reasons:
 */
 bool ring_buffer_maybe_push(struct ring_buffer* restrict, void const* restrict item);
 
+/* Pushes up to `n_items` items on the buffer, reading them consecutively from
+`items`. Pushes as many as fit.
+
+All pushed items are claimed with a single update of WRITE-AHEAD, copied with
+at most two memcpy calls (one on each side of the wrap point) and published with
+a single update of WRITE.
+
+Returns the number of items pushed (the first N of `items`).
+Returns 0 if the buffer was full.
+
+Thread safe.
+
+Blocking reasons:
+    - Other producers are currently pushing (multi-producer).
+*/
+rb_size_t ring_buffer_push_n(
+    struct ring_buffer* restrict,
+    void const* restrict items,
+    rb_size_t n_items
+);
+/* Pushes exactly `n_items` items on the buffer, reading them consecutively from
+`items`. Either all items are pushed or none are.
+
+Returns true if the push was successful.
+Returns false if there was not enough space for all items (the buffer is unchanged).
+
+Thread safe.
+
+Blocking reasons:
+    - Other producers are currently pushing (multi-producer).
+
+Failure reasons:
+    - The buffer doesn't have space for `n_items` items.
+    - `n_items` is bigger than the capacity of the buffer.
+*/
+bool ring_buffer_push_n_exact(
+    struct ring_buffer* restrict,
+    void const* restrict items,
+    rb_size_t n_items
+);
+
 /* Pops an item from the buffer, removing it and returning the value in `out_item`.
 This function WILL DEADLOCK if the buffer is empty  and there are no producers!
 Cannot fail.
 
+While the buffer is empty, it waits like ring_buffer_deadlock_push - an idle
+consumer ends up sleeping, not burning a core.
+
 Thread safe.
 
 Blocking reasons:
@@ -93,6 +439,26 @@ Blocking reasons:
     - Other consumers are currently popping (multi-consumer).
 */
 void ring_buffer_deadlock_pop(struct ring_buffer* restrict, void* restrict out_item);
+/* Pops an item from the buffer, waiting for one for at most `timeout_ns`
+nanoseconds. Waits the same way as ring_buffer_deadlock_pop.
+
+Returns true if the pop was successful.
+Returns false if the buffer was still empty after `timeout_ns`.
+
+Thread safe.
+
+Blocking reasons:
+    - The buffer is empty (up to `timeout_ns`).
+    - Other consumers are currently popping (multi-consumer).
+
+Failure reasons:
+    - The buffer is empty.
+*/
+bool ring_buffer_pop_timeout(
+    struct ring_buffer* restrict,
+    void* restrict out_item,
+    uint64_t timeout_ns
+);
 /* Pops an item from the buffer, removing it and returning the value in `out_item`.
 
 Returns true if the pop was successful.
@@ -118,6 +484,120 @@ Failure reasons:
 */
 bool ring_buffer_maybe_pop(struct ring_buffer* restrict, void* restrict out_item);
 
+/* Pops up to `n_items` items from the buffer, writing them consecutively in
+`out_items`. Pops as many as are available.
+
+See ring_buffer_push_n for the batching guarantees.
+
+Returns the number of items popped.
+Returns 0 if the buffer was empty.
+
+Thread safe.
+
+Blocking reasons:
+    - Other consumers are currently popping (multi-consumer).
+*/
+rb_size_t ring_buffer_pop_n(
+    struct ring_buffer* restrict,
+    void* restrict out_items,
+    rb_size_t n_items
+);
+/* Pops exactly `n_items` items from the buffer, writing them consecutively in
+`out_items`. Either all items are popped or none are.
+
+Returns true if the pop was successful.
+Returns false if there were less than `n_items` items (the buffer is unchanged).
+
+Thread safe.
+
+Blocking reasons:
+    - Other consumers are currently popping (multi-consumer).
+
+Failure reasons:
+    - The buffer has less than `n_items` items.
+*/
+bool ring_buffer_pop_n_exact(
+    struct ring_buffer* restrict,
+    void* restrict out_items,
+    rb_size_t n_items
+);
+
+/* Reserves up to `n_items` slots for writing in place, without copying.
+
+The reserved slots are always contiguous - the span stops at the wrap point, so
+it may hold less than `n_items` even if the buffer has more space (except with
+RING_BUFFER_DOUBLE_MAPPED).
+The producer writes the items directly in `out_span->data` (item `i` at
+`(char*)out_span->data + i * out_span->stride`) and then publishes them with
+ring_buffer_commit_write.
+
+Every successful reserve MUST be followed by exactly one commit of the same span.
+All reserved items are published by the commit, even if some weren't written.
+Until then, other producers that have pushed after us cannot finish (see the
+blocking reasons of ring_buffer_push), so keep the gap short.
+
+Returns the number of reserved items (`out_span->count`).
+Returns 0 if the buffer was full.
+
+Thread safe.
+
+Blocking reasons:
+    - Other producers are currently pushing (multi-producer).
+*/
+rb_size_t ring_buffer_reserve_write(
+    struct ring_buffer* restrict,
+    rb_size_t n_items,
+    struct ring_buffer_span* restrict out_span
+);
+/* Publishes the items written in a span returned by ring_buffer_reserve_write,
+making them visible to consumers.
+
+Thread safe.
+
+Blocking reasons:
+    - Other producers that reserved before us haven't committed yet.
+*/
+void ring_buffer_commit_write(
+    struct ring_buffer* restrict,
+    struct ring_buffer_span const* restrict span
+);
+/* Takes up to `n_items` items for reading in place, without copying.
+
+The items are always contiguous - the span stops at the wrap point, so it may
+hold less than `n_items` even if the buffer has more items (except with
+RING_BUFFER_DOUBLE_MAPPED). Item `i` is at
+`(char*)out_span->data + i * out_span->stride`.
+The items are removed from the buffer (no other consumer will see them), but
+their slots are not reused by producers until ring_buffer_release_read.
+
+Every successful peek MUST be followed by exactly one release of the same span.
+
+Returns the number of items in the span (`out_span->count`).
+Returns 0 if the buffer was empty.
+
+Thread safe.
+
+Blocking reasons:
+    - Other consumers are currently popping (multi-consumer).
+*/
+rb_size_t ring_buffer_peek_read(
+    struct ring_buffer* restrict,
+    rb_size_t n_items,
+    struct ring_buffer_span* restrict out_span
+);
+/* Gives the slots of a span returned by ring_buffer_peek_read back to the
+producers. `span->data` must not be accessed after this.
+
+Thread safe.
+
+Blocking reasons:
+    - Other consumers that peeked before us haven't released yet.
+*/
+void ring_buffer_release_read(
+    struct ring_buffer* restrict,
+    struct ring_buffer_span const* restrict span
+);
+
 /* Returns the size of one item.
 Thread safe.
 */
@@ -130,14 +610,264 @@ rb_size_t ring_buffer_capacity(struct ring_buffer* restrict);
 /* Clears the buffer, by setting READ and READ-AHEAD equal to WRITE.
 Thread safe.
 Ensure that no consumers or producers are currently working with this buffer.
+With RING_BUFFER_SINGLE_CONSUMER, this counts as a pop - call it from the consumer.
 */
 void ring_buffer_clear(struct ring_buffer* restrict);
 /* Returns the difference between WRITE and READ.
 
-This value will always be inaccurate if used with multiple producers/consumers.
+This value will always be inaccurate if used with multiple producers/consumers -
+it is a snapshot, that may already be stale. It is never negative nor bigger than
+the capacity though, even while other threads push/pop.
 */
 rb_size_t ring_buffer_size(struct ring_buffer* restrict);
 
+/* Returns the number of items that were overwritten before any consumer popped
+them, with RING_BUFFER_OVERWRITE (0 otherwise).
+
+They are counted by the consumers, as they skip over them: an item overwritten
+while the consumers are still behind it is only counted once they catch up, and
+ring_buffer_clear doesn't count what it throws away.
+
+Thread safe.
+*/
+uint64_t ring_buffer_dropped(struct ring_buffer* restrict);
+
+/* Counters of a ring_buffer, see ring_buffer_stats_snapshot.
+
+All counters only grow, since ring_buffer_init (they wrap around at 2^64).
+*/
+struct ring_buffer_stats
+{
+    /* Items pushed/popped (by any function, batches count all their items). */
+    uint64_t pushes;
+    uint64_t pops;
+
+    /* Attempts that found the buffer full/empty. This includes the retries of the
+    blocking functions before they go to sleep.
+    */
+    uint64_t push_full;
+    uint64_t pop_empty;
+
+    /* ring_buffer_maybe_push/ring_buffer_maybe_pop calls that gave up because
+    another producer/consumer was in the middle of a push/pop.
+    */
+    uint64_t push_busy;
+    uint64_t pop_busy;
+
+    /* Failed CAS on WRITE-AHEAD/READ-AHEAD (another producer/consumer claimed
+    the slot first).
+    */
+    uint64_t push_cas_failures;
+    uint64_t pop_cas_failures;
+
+    /* Iterations spent waiting for the producers/consumers that claimed before us
+    to publish WRITE/READ (spins and yields, see CDATAUTILS_RING_BUFFER_SPIN_COUNT).
+    */
+    uint64_t push_spins;
+    uint64_t pop_spins;
+
+    /* Times a blocking push/pop went to sleep. */
+    uint64_t push_sleeps;
+    uint64_t pop_sleeps;
+
+    /* The biggest ring_buffer_size seen right after a push. */
+    rb_size_t high_water_mark;
+};
+
+/* Copies the counters of `rb` in `out_stats`, to be scraped periodically.
+
+Only counted when the library is built with CDATAUTILS_RING_BUFFER_STATS (the
+CDATAUTILS_RINGBUFFER_STATS CMake option), otherwise `out_stats` is all zeros
+and push/pop don't pay anything. The counters are sharded per thread (in
+CDATAUTILS_RING_BUFFER_STATS_SHARDS shards), so counting doesn't add contention on
+top of the buffer's own - this sums the shards.
+The CDATAUTILS_RING_BUFFER_DEFINE buffers are not counted.
+
+Thread safe. The counters are read one by one while other threads keep counting,
+so they may not be consistent with each other.
+*/
+void ring_buffer_stats_snapshot(
+    struct ring_buffer* restrict,
+    struct ring_buffer_stats* restrict out_stats
+);
+
+/* Generates a typed, fixed-capacity, multi-producer multi-consumer ring buffer:
+```
+struct ring_buffer_NAME;
+void ring_buffer_init_NAME(struct ring_buffer_NAME*);
+bool ring_buffer_push_NAME(struct ring_buffer_NAME*, TYPE item);
+bool ring_buffer_pop_NAME(struct ring_buffer_NAME*, TYPE* out_item);
+rb_size_t ring_buffer_size_NAME(struct ring_buffer_NAME*);
+```
+
+The items are stored inside the struct (no allocation, it can live on the stack,
+in a global or inside another struct), and the element type and capacity are
+known at compile time, so a push/pop is a typed store/load instead of a memcpy
+of `value_size` bytes.
+
+Works like a RING_BUFFER_SLOT_SEQUENCES ring_buffer, but there are only the
+non-blocking push/pop - they return false if the buffer is full/empty.
+
+The definitions are marked as `static inline` so they are kinda hard on the
+linker but do not require LTO to inline.
+
+Preconditions:
+    - capacity MUST be a power-of-two and > 1.
+    - ring_buffer_init_NAME MUST be called before anything else (not thread-safe).
+
+Example:
+```
+CDATAUTILS_RING_BUFFER_DEFINE(int, int, 1024)
+
+static struct ring_buffer_int rb;
+
+ring_buffer_init_int(&rb);
+ring_buffer_push_int(&rb, 741);
+
+int an_int;
+ring_buffer_pop_int(&rb, &an_int);
+// an_int == 741
+```
+*/
+#define CDATAUTILS_RING_BUFFER_DEFINE(type, name, capacity)                           \
+    CDATAUTILS_RING_BUFFER_STATIC_ASSERT(                                             \
+        (capacity) > 1 && ((capacity) & ((capacity) - 1)) == 0,                       \
+        "ring_buffer_" #name ": capacity must be a power of two"                      \
+    );                                                                                \
+                                                                                      \
+    struct ring_buffer_##name                                                         \
+    {                                                                                 \
+        CDATAUTILS_RING_BUFFER_ATOMIC(rb_size_t) write_ahead;                         \
+        char _write_ahead_padding[CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2];        \
+        CDATAUTILS_RING_BUFFER_ATOMIC(rb_size_t) read_ahead;                          \
+        char _read_ahead_padding[CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2];         \
+        struct                                                                        \
+        {                                                                             \
+            CDATAUTILS_RING_BUFFER_ATOMIC(rb_size_t) sequence;                        \
+            type value;                                                               \
+        } slots[capacity];                                                            \
+    };                                                                                \
+                                                                                      \
+    static inline void ring_buffer_init_##name(struct ring_buffer_##name* rb)         \
+    {                                                                                 \
+        rb_size_t i;                                                                  \
+        CDATAUTILS_RING_BUFFER_STD atomic_store_explicit(                             \
+            &rb->write_ahead,                                                         \
+            0u,                                                                       \
+            CDATAUTILS_RING_BUFFER_STD memory_order_relaxed                           \
+        );                                                                            \
+        CDATAUTILS_RING_BUFFER_STD atomic_store_explicit(                             \
+            &rb->read_ahead,                                                          \
+            0u,                                                                       \
+            CDATAUTILS_RING_BUFFER_STD memory_order_relaxed                           \
+        );                                                                            \
+        for (i = 0; i < (rb_size_t)(capacity); ++i)                                   \
+            CDATAUTILS_RING_BUFFER_STD atomic_store_explicit(                         \
+                &rb->slots[i].sequence,                                               \
+                i,                                                                    \
+                CDATAUTILS_RING_BUFFER_STD memory_order_relaxed                       \
+            );                                                                        \
+        CDATAUTILS_RING_BUFFER_STD atomic_thread_fence(                               \
+            CDATAUTILS_RING_BUFFER_STD memory_order_release                           \
+        );                                                                            \
+    }                                                                                 \
+    static inline bool ring_buffer_push_##name(                                       \
+        struct ring_buffer_##name* rb,                                                \
+        type item                                                                     \
+    )                                                                                 \
+    {                                                                                 \
+        rb_size_t const mask = (rb_size_t)(capacity) - 1u;                            \
+        rb_size_t wa = CDATAUTILS_RING_BUFFER_STD atomic_load_explicit(               \
+            &rb->write_ahead,                                                         \
+            CDATAUTILS_RING_BUFFER_STD memory_order_relaxed                           \
+        );                                                                            \
+        rb_size_t seq;                                                                \
+        for (;;) {                                                                    \
+            seq = CDATAUTILS_RING_BUFFER_STD atomic_load_explicit(                    \
+                &rb->slots[wa & mask].sequence,                                       \
+                CDATAUTILS_RING_BUFFER_STD memory_order_acquire                       \
+            );                                                                        \
+            if (seq == wa) {                                                          \
+                if (CDATAUTILS_RING_BUFFER_STD atomic_compare_exchange_weak_explicit( \
+                        &rb->write_ahead,                                             \
+                        &wa,                                                          \
+                        wa + 1u,                                                      \
+                        CDATAUTILS_RING_BUFFER_STD memory_order_relaxed,              \
+                        CDATAUTILS_RING_BUFFER_STD memory_order_relaxed               \
+                    ))                                                                \
+                    break;                                                            \
+            } else if ((rb_ssize_t)(seq - wa) < 0) {                                  \
+                return false; /* full */                                              \
+            } else {                                                                  \
+                wa = CDATAUTILS_RING_BUFFER_STD atomic_load_explicit(                 \
+                    &rb->write_ahead,                                                 \
+                    CDATAUTILS_RING_BUFFER_STD memory_order_relaxed                   \
+                );                                                                    \
+            }                                                                         \
+        }                                                                             \
+        rb->slots[wa & mask].value = item;                                            \
+        CDATAUTILS_RING_BUFFER_STD atomic_store_explicit(                             \
+            &rb->slots[wa & mask].sequence,                                           \
+            wa + 1u,                                                                  \
+            CDATAUTILS_RING_BUFFER_STD memory_order_release                           \
+        );                                                                            \
+        return true;                                                                  \
+    }                                                                                 \
+    static inline bool ring_buffer_pop_##name(                                        \
+        struct ring_buffer_##name* rb,                                                \
+        type* out_item                                                                \
+    )                                                                                 \
+    {                                                                                 \
+        rb_size_t const mask = (rb_size_t)(capacity) - 1u;                            \
+        rb_size_t ra = CDATAUTILS_RING_BUFFER_STD atomic_load_explicit(               \
+            &rb->read_ahead,                                                          \
+            CDATAUTILS_RING_BUFFER_STD memory_order_relaxed                           \
+        );                                                                            \
+        rb_size_t seq;                                                                \
+        for (;;) {                                                                    \
+            seq = CDATAUTILS_RING_BUFFER_STD atomic_load_explicit(                    \
+                &rb->slots[ra & mask].sequence,                                       \
+                CDATAUTILS_RING_BUFFER_STD memory_order_acquire                       \
+            );                                                                        \
+            if (seq == ra + 1u) {                                                     \
+                if (CDATAUTILS_RING_BUFFER_STD atomic_compare_exchange_weak_explicit( \
+                        &rb->read_ahead,                                              \
+                        &ra,                                                          \
+                        ra + 1u,                                                      \
+                        CDATAUTILS_RING_BUFFER_STD memory_order_relaxed,              \
+                        CDATAUTILS_RING_BUFFER_STD memory_order_relaxed               \
+                    ))                                                                \
+                    break;                                                            \
+            } else if ((rb_ssize_t)(seq - (ra + 1u)) < 0) {                           \
+                return false; /* empty */                                             \
+            } else {                                                                  \
+                ra = CDATAUTILS_RING_BUFFER_STD atomic_load_explicit(                 \
+                    &rb->read_ahead,                                                  \
+                    CDATAUTILS_RING_BUFFER_STD memory_order_relaxed                   \
+                );                                                                    \
+            }                                                                         \
+        }                                                                             \
+        *out_item = rb->slots[ra & mask].value;                                       \
+        CDATAUTILS_RING_BUFFER_STD atomic_store_explicit(                             \
+            &rb->slots[ra & mask].sequence,                                           \
+            ra + (rb_size_t)(capacity),                                               \
+            CDATAUTILS_RING_BUFFER_STD memory_order_release                           \
+        );                                                                            \
+        return true;                                                                  \
+    }                                                                                 \
+    static inline rb_size_t ring_buffer_size_##name(struct ring_buffer_##name* rb)    \
+    {                                                                                 \
+        rb_size_t const ra = CDATAUTILS_RING_BUFFER_STD atomic_load_explicit(         \
+            &rb->read_ahead,                                                          \
+            CDATAUTILS_RING_BUFFER_STD memory_order_acquire                           \
+        );                                                                            \
+        return CDATAUTILS_RING_BUFFER_STD atomic_load_explicit(                       \
+                   &rb->write_ahead,                                                  \
+                   CDATAUTILS_RING_BUFFER_STD memory_order_acquire                    \
+               )                                                                      \
+               - ra;                                                                  \
+    }
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,93 @@
+#ifndef CDATAUTILS_WORK_DEQUE_H
+#define CDATAUTILS_WORK_DEQUE_H
+
+#include <cdatautils/ringbuffer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#define restrict
+#endif
+
+/* A growable, lock-free, power-of-two work-stealing deque of fixed-size items
+(Chase-Lev, with the C11 orderings of Lê et al. 2013).
+
+One thread owns the deque: it pushes and pops at the BOTTOM (LIFO), without any
+CAS except when taking the very last item. Any other thread may steal from the
+TOP (FIFO), with one CAS on TOP per item.
+
+A thread pool gives each worker its own deque: workers push and pop their own
+tasks, and only touch another worker's deque (steal) when theirs is empty. So,
+unlike a single shared ring_buffer, there is no counter that every push/pop of
+every thread goes through.
+
+The slots are the same as ring_buffer's: `value_size` bytes each, the item at
+index `i` being at slot `i & (capacity - 1)`. When the owner pushes in a full
+deque, the storage is replaced by one twice as big. The old storage is only
+freed by work_deque_destroy (thieves may still be reading it), so a deque takes
+at most twice the memory of its biggest storage.
+*/
+struct work_deque;
+
+/* Initializes a work_deque with space for `capacity` items of `value_size` bytes.
+
+Not thread-safe.
+
+Preconditions:
+    - capacity MUST be a power-of-two and > 1.
+*/
+void work_deque_init(
+    struct work_deque** restrict,
+    rb_size_t capacity,
+    rb_size_t value_size
+);
+
+/* Destroys a work_deque immediately, free()-ing all resources (old storage
+included).
+
+Not thread-safe.
+*/
+void work_deque_destroy(struct work_deque* restrict);
+
+/* Pushes a copy of `item` at the BOTTOM, doubling the capacity if the deque is
+full.
+
+Owner only.
+*/
+void work_deque_push(struct work_deque* restrict, void const* restrict item);
+
+/* Pops the item at the BOTTOM (the last one pushed) in `out_item`.
+
+Returns true if the pop was successful.
+Returns false if the deque was empty, or a thief took the last item first.
+
+Owner only.
+*/
+bool work_deque_pop(struct work_deque* restrict, void* restrict out_item);
+
+/* Steals the item at the TOP (the oldest one) in `out_item`.
+
+Returns true if the steal was successful.
+Returns false if the deque was empty, or another thread took the item first. The
+deque may not be empty then, retry (or try another victim). `out_item` may have
+been written to anyway.
+
+Thread safe. Lock-free.
+*/
+bool work_deque_steal(struct work_deque* restrict, void* restrict out_item);
+
+/* Returns the difference between BOTTOM and TOP.
+
+This value will always be inaccurate if used while other threads steal.
+*/
+rb_size_t work_deque_size(struct work_deque* restrict);
+
+/* Returns the capacity of the current storage.
+Owner only.
+*/
+rb_size_t work_deque_capacity(struct work_deque* restrict);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
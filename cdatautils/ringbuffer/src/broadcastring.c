@@ -0,0 +1,299 @@
+#include <cdatautils/broadcastring.h>
+
+#include "wait.h"
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define internal static
+
+#ifdef CDATAUTILS_RINGBUFFER_USE_ASSERT
+#include <assert.h>
+#else
+#define assert(...) (void)(__VA_ARGS__)
+#endif
+
+enum broadcast_ring_reader_state
+{
+    BROADCAST_RING_READER_FREE,
+    /* Claimed by broadcast_ring_subscribe, its cursor isn't written yet. */
+    BROADCAST_RING_READER_JOINING,
+    BROADCAST_RING_READER_ACTIVE,
+};
+
+struct broadcast_ring_reader
+{
+    /* The next item this reader will pop. Only written by the reader. */
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t cursor;
+    /* A broadcast_ring_reader_state. */
+    _Atomic unsigned state;
+};
+
+struct broadcast_ring
+{
+    /* Aligned to CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE. */
+    unsigned char* data;
+    struct broadcast_ring_reader* readers;
+    rb_size_t capacity;
+    rb_size_t value_size;
+    rb_size_t max_readers;
+    unsigned flags;
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t write;
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t write_ahead;
+    /* The slowest cursor, the last time a producer looked. Readers only move
+    forward, so it is never ahead of the real one. */
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t slowest;
+};
+
+internal
+unsigned char*
+broadcast_ring_slot(struct broadcast_ring* restrict br, rb_size_t index)
+{
+    return br->data + (size_t)(index & (br->capacity - 1u)) * br->value_size;
+}
+/* Returns the cursor of the slowest subscribed reader, WRITE if there are none.
+
+A reader subscribing after we looked at it starts at WRITE, which is past every
+cursor (and past the WRITE loaded here), so it is never behind the returned
+value. One in the middle of subscribing may start before that WRITE: wait for
+its cursor.
+*/
+internal
+rb_size_t
+broadcast_ring_slowest(struct broadcast_ring* restrict br, rb_size_t wa)
+{
+    rb_size_t slowest = atomic_load_explicit(&br->write, memory_order_acquire);
+    unsigned spins = 0;
+    unsigned state;
+    rb_size_t cursor;
+    rb_size_t i;
+
+    for (i = 0; i < br->max_readers; ++i) {
+        state = atomic_load_explicit(&br->readers[i].state, memory_order_acquire);
+        while (state == BROADCAST_RING_READER_JOINING) {
+            ring_buffer_backoff(&spins);
+            state = atomic_load_explicit(&br->readers[i].state, memory_order_acquire);
+        }
+        if (state != BROADCAST_RING_READER_ACTIVE)
+            continue;
+        cursor = atomic_load_explicit(&br->readers[i].cursor, memory_order_acquire);
+        if (wa - cursor > wa - slowest)
+            slowest = cursor;
+    }
+    return slowest;
+}
+
+void
+broadcast_ring_init(
+    struct broadcast_ring** restrict br,
+    rb_size_t capacity,
+    rb_size_t value_size,
+    rb_size_t max_readers,
+    unsigned flags
+)
+{
+    struct broadcast_ring* _br;
+    rb_size_t i;
+
+    assert(capacity > 1);
+    assert(((capacity - 1) & capacity) == 0); // power of two
+    assert(max_readers > 0);
+
+    _br = ring_buffer_os_aligned_alloc(alignof(struct broadcast_ring), sizeof(*_br));
+    assert(_br);
+    _br->data = ring_buffer_os_aligned_alloc(
+        CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE,
+        (size_t)capacity * value_size
+    );
+    assert(_br->data);
+    _br->readers = ring_buffer_os_aligned_alloc(
+        alignof(struct broadcast_ring_reader),
+        sizeof(*_br->readers) * max_readers
+    );
+    assert(_br->readers);
+
+    _br->capacity = capacity;
+    _br->value_size = value_size;
+    _br->max_readers = max_readers;
+    _br->flags = flags;
+    atomic_init(&_br->write, 0);
+    atomic_init(&_br->write_ahead, 0);
+    atomic_init(&_br->slowest, 0);
+    for (i = 0; i < max_readers; ++i) {
+        atomic_init(&_br->readers[i].cursor, 0);
+        atomic_init(&_br->readers[i].state, BROADCAST_RING_READER_FREE);
+    }
+
+    *br = _br;
+}
+void
+broadcast_ring_destroy(struct broadcast_ring* restrict br)
+{
+    ring_buffer_os_aligned_free(br->readers);
+    ring_buffer_os_aligned_free(br->data);
+    ring_buffer_os_aligned_free(br);
+}
+
+bool
+broadcast_ring_subscribe(
+    struct broadcast_ring* restrict br,
+    rb_size_t* restrict out_reader
+)
+{
+    rb_size_t i;
+    unsigned expected;
+
+    for (i = 0; i < br->max_readers; ++i) {
+        expected = BROADCAST_RING_READER_FREE;
+        if (!atomic_compare_exchange_strong_explicit(
+                &br->readers[i].state,
+                &expected,
+                BROADCAST_RING_READER_JOINING,
+                memory_order_seq_cst,
+                memory_order_relaxed
+            ))
+            continue;
+
+        /* Claimed first, then WRITE: a producer that missed us is gated on cursors
+        that aren't past this WRITE. One that didn't waits until we are active, the
+        cursor left by the previous reader of the slot is stale. */
+        atomic_store_explicit(
+            &br->readers[i].cursor,
+            atomic_load_explicit(&br->write, memory_order_seq_cst),
+            memory_order_relaxed
+        );
+        atomic_store_explicit(
+            &br->readers[i].state,
+            BROADCAST_RING_READER_ACTIVE,
+            memory_order_release
+        );
+        *out_reader = i;
+        return true;
+    }
+    return false;
+}
+void
+broadcast_ring_unsubscribe(struct broadcast_ring* restrict br, rb_size_t reader)
+{
+    atomic_store_explicit(
+        &br->readers[reader].state,
+        BROADCAST_RING_READER_FREE,
+        memory_order_release
+    );
+}
+
+bool
+broadcast_ring_push(struct broadcast_ring* restrict br, void const* restrict item)
+{
+    rb_size_t const cap = br->capacity;
+    unsigned spins = 0;
+    rb_size_t slowest;
+    rb_size_t wa;
+
+    wa = atomic_load_explicit(&br->write_ahead, memory_order_acquire);
+    do {
+        if (br->flags & BROADCAST_RING_LOSSY)
+            continue;
+
+        /* If the slowest reader is a whole buffer behind, can't push. */
+        slowest = atomic_load_explicit(&br->slowest, memory_order_relaxed);
+        if (wa + 1u - slowest > cap) {
+            slowest = broadcast_ring_slowest(br, wa);
+            atomic_store_explicit(&br->slowest, slowest, memory_order_relaxed);
+            if (wa + 1u - slowest > cap)
+                return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(
+        &br->write_ahead,
+        &wa,
+        wa + 1u,
+        memory_order_acquire,
+        memory_order_acquire
+    ));
+
+    /* Lossy: the claim must be seen before any byte of the item, or a reader
+    lapped by it wouldn't know its copy is torn (pairs with the fence in
+    broadcast_ring_pop). */
+    if (br->flags & BROADCAST_RING_LOSSY)
+        atomic_thread_fence(memory_order_release);
+    memcpy(broadcast_ring_slot(br, wa), item, br->value_size);
+
+    /* When WRITE reaches our WRITE-AHEAD, set WRITE = WRITE-AHEAD + 1. */
+    while (atomic_load_explicit(&br->write, memory_order_acquire) != wa)
+        ring_buffer_backoff(&spins);
+    atomic_store_explicit(&br->write, wa + 1u, memory_order_release);
+    return true;
+}
+
+bool
+broadcast_ring_pop(
+    struct broadcast_ring* restrict br,
+    rb_size_t reader,
+    void* restrict out_item,
+    rb_size_t* restrict out_missed
+)
+{
+    rb_size_t const cap = br->capacity;
+    _Atomic rb_size_t* const cursor = &br->readers[reader].cursor;
+    rb_size_t r = atomic_load_explicit(cursor, memory_order_relaxed);
+    rb_size_t const first = r;
+    rb_size_t w;
+    rb_size_t wa;
+
+    if (out_missed)
+        *out_missed = 0;
+
+    for (;;) {
+        w = atomic_load_explicit(&br->write, memory_order_acquire);
+
+        /* If the reader has seen everything, can't pop. */
+        if (w == r)
+            break;
+
+        /* Lapped: the oldest items that are still there start at WRITE - cap. */
+        if (w - r > cap)
+            r = w - cap;
+
+        memcpy(out_item, broadcast_ring_slot(br, r), br->value_size);
+        if (!(br->flags & BROADCAST_RING_LOSSY)) {
+            atomic_store_explicit(cursor, r + 1u, memory_order_release);
+            return true;
+        }
+
+        /* If a producer claimed the slot for the next lap, the copy may be torn:
+        skip it, and everything else that was claimed over. */
+        atomic_thread_fence(memory_order_acquire);
+        wa = atomic_load_explicit(&br->write_ahead, memory_order_relaxed);
+        if (wa - r > cap) {
+            r = wa - cap;
+            continue;
+        }
+
+        if (out_missed)
+            *out_missed = r - first;
+        atomic_store_explicit(cursor, r + 1u, memory_order_release);
+        return true;
+    }
+
+    if (out_missed)
+        *out_missed = r - first;
+    atomic_store_explicit(cursor, r, memory_order_release);
+    return false;
+}
+
+rb_size_t
+broadcast_ring_size(struct broadcast_ring* restrict br, rb_size_t reader)
+{
+    rb_size_t const r =
+        atomic_load_explicit(&br->readers[reader].cursor, memory_order_relaxed);
+    rb_size_t const size = atomic_load_explicit(&br->write, memory_order_acquire) - r;
+
+    return size < br->capacity ? size : br->capacity;
+}
+rb_size_t
+broadcast_ring_capacity(struct broadcast_ring* restrict br)
+{
+    return br->capacity;
+}
@@ -0,0 +1,466 @@
+#include <cdatautils/bytering.h>
+
+#include "wait.h"
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define internal static
+
+#ifdef CDATAUTILS_RINGBUFFER_USE_ASSERT
+#include <assert.h>
+#else
+#define assert(...) (void)(__VA_ARGS__)
+#endif
+
+/* Set in a header when the record is padding up to the end of the storage. The
+rest of the header is then the number of padding bytes after the header.
+*/
+#define BYTE_RING_PADDING ((rb_size_t)1 << (sizeof(rb_size_t) * 8u - 1u))
+
+struct byte_ring
+{
+    /* Aligned to CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE, records start at multiples
+    of BYTE_RING_HEADER_SIZE.
+    */
+    unsigned char* data;
+    rb_size_t capacity;
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t read;
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t read_ahead;
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t write;
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t write_ahead;
+};
+
+/* Returns the header of the record at `position`.
+
+Headers are read before the record is claimed (and may be overwritten under a
+stale READ-AHEAD), so they are accessed atomically.
+*/
+internal
+_Atomic rb_size_t*
+byte_ring_header(struct byte_ring* restrict rb, rb_size_t position)
+{
+    return (_Atomic rb_size_t*)(void*)(rb->data + (position & (rb->capacity - 1u)));
+}
+/* Returns the number of bytes taken by the record with `header`, header included. */
+internal
+rb_size_t
+byte_ring_step(rb_size_t header)
+{
+    if (header & BYTE_RING_PADDING)
+        return BYTE_RING_HEADER_SIZE + (header & ~BYTE_RING_PADDING);
+    return BYTE_RING_HEADER_SIZE
+           + ((header + BYTE_RING_HEADER_SIZE - 1u) & ~(BYTE_RING_HEADER_SIZE - 1u));
+}
+
+/* Claims `total` contiguous bytes of WRITE-AHEAD. If they don't fit before the end
+of the storage, the rest of the storage is claimed too (for a padding record).
+
+Returns the number of claimed bytes (`total`, or more with padding), and writes the
+first one in `out_wa`.
+Returns 0 if there was no space.
+*/
+internal
+rb_size_t
+byte_ring_claim_write(
+    struct byte_ring* restrict rb,
+    rb_size_t total,
+    rb_size_t* restrict out_wa
+)
+{
+    rb_size_t const cap = rb->capacity;
+    rb_size_t wa;
+    rb_size_t used;
+    rb_size_t tail;
+    rb_size_t claimed;
+
+    wa = atomic_load_explicit(&rb->write_ahead, memory_order_acquire);
+    for (;;) {
+        used = wa - atomic_load_explicit(&rb->read, memory_order_acquire);
+
+        /* READ has moved past our (stale) WRITE-AHEAD, reload it. */
+        if (used > cap) {
+            wa = atomic_load_explicit(&rb->write_ahead, memory_order_acquire);
+            continue;
+        }
+
+        tail = cap - (wa & (cap - 1u));
+        claimed = total <= tail ? total : tail + total;
+
+        /* If the ring is "full", can't push. */
+        if (claimed > cap - used)
+            return 0;
+
+        if (atomic_compare_exchange_weak_explicit(
+                &rb->write_ahead,
+                &wa,
+                wa + claimed,
+                memory_order_acquire,
+                memory_order_acquire
+            ))
+            break;
+    }
+
+    *out_wa = wa;
+    return claimed;
+}
+/* Whether another consumer moved READ-AHEAD away from `*ra` - the headers read
+from there may be stale (records already claimed, or the next lap being
+written). Reloads it in `*ra` if so.
+*/
+internal
+bool
+byte_ring_read_ahead_moved(struct byte_ring* restrict rb, rb_size_t* restrict ra)
+{
+    rb_size_t current;
+
+    /* The headers were read before READ-AHEAD. */
+    atomic_thread_fence(memory_order_acquire);
+    current = atomic_load_explicit(&rb->read_ahead, memory_order_relaxed);
+    if (current == *ra)
+        return false;
+    *ra = current;
+    return true;
+}
+/* Walks the published records from READ-AHEAD and claims up to `max_records` of
+them (padding doesn't count), with a single CAS.
+
+Doesn't claim anything if the first record is bigger than `max_size`.
+`*out_first_size` is set to the size of the first record (0 if there is none).
+
+Returns the number of claimed records, and writes the first claimed byte in
+`out_ra` and the number of claimed bytes in `out_claimed`.
+Returns 0 if nothing was claimed.
+*/
+internal
+rb_size_t
+byte_ring_claim_read(
+    struct byte_ring* restrict rb,
+    rb_size_t max_records,
+    rb_size_t max_size,
+    rb_size_t* restrict out_first_size,
+    rb_size_t* restrict out_ra,
+    rb_size_t* restrict out_claimed
+)
+{
+    rb_size_t ra;
+    rb_size_t w;
+    rb_size_t end;
+    rb_size_t header;
+    rb_size_t step;
+    rb_size_t n;
+
+    ra = atomic_load_explicit(&rb->read_ahead, memory_order_acquire);
+    for (;;) {
+        *out_first_size = 0;
+        w = atomic_load_explicit(&rb->write, memory_order_acquire);
+
+        /* Producers have moved past our (stale) READ-AHEAD, reload it. */
+        if (w - ra > rb->capacity) {
+            ra = atomic_load_explicit(&rb->read_ahead, memory_order_acquire);
+            continue;
+        }
+
+        for (end = ra, n = 0; n < max_records && end != w; end += step) {
+            header = atomic_load_explicit(
+                byte_ring_header(rb, end),
+                memory_order_relaxed
+            );
+            step = byte_ring_step(header);
+
+            /* A header from a stale READ-AHEAD: the CAS below fails, or (if
+            nothing was claimed) the check below retries. */
+            if (step > w - end)
+                break;
+
+            if (!(header & BYTE_RING_PADDING)) {
+                if (n == 0) {
+                    *out_first_size = header;
+                    if (header > max_size)
+                        break;
+                }
+                ++n;
+            }
+        }
+
+        /* If the ring is "empty" (or the first record is too big), can't pop -
+        unless that came from a stale READ-AHEAD. */
+        if (n == 0) {
+            if (byte_ring_read_ahead_moved(rb, &ra))
+                continue;
+            return 0;
+        }
+
+        if (atomic_compare_exchange_weak_explicit(
+                &rb->read_ahead,
+                &ra,
+                end,
+                memory_order_acquire,
+                memory_order_acquire
+            ))
+            break;
+    }
+
+    *out_ra = ra;
+    *out_claimed = end - ra;
+    return n;
+}
+/* Returns the payload of the first record from `*position` (skipping a padding
+record), and moves `*position` after it.
+Only for claimed records.
+*/
+internal
+unsigned char*
+byte_ring_next(
+    struct byte_ring* restrict rb,
+    rb_size_t* restrict position,
+    rb_size_t* restrict out_size
+)
+{
+    rb_size_t header =
+        atomic_load_explicit(byte_ring_header(rb, *position), memory_order_relaxed);
+    unsigned char* payload;
+
+    if (header & BYTE_RING_PADDING) {
+        *position += byte_ring_step(header);
+        header = atomic_load_explicit(
+            byte_ring_header(rb, *position),
+            memory_order_relaxed
+        );
+    }
+
+    payload = rb->data + ((*position + BYTE_RING_HEADER_SIZE) & (rb->capacity - 1u));
+    *out_size = header;
+    *position += byte_ring_step(header);
+    return payload;
+}
+/* When WRITE reaches `wa`, set WRITE = `wa` + `n`. */
+internal
+void
+byte_ring_publish_write(struct byte_ring* restrict rb, rb_size_t wa, rb_size_t n)
+{
+    unsigned spins = 0;
+
+    while (atomic_load_explicit(&rb->write, memory_order_acquire) != wa)
+        ring_buffer_backoff(&spins);
+    atomic_store_explicit(&rb->write, wa + n, memory_order_release);
+}
+/* When READ reaches `ra`, set READ = `ra` + `n`. */
+internal
+void
+byte_ring_publish_read(struct byte_ring* restrict rb, rb_size_t ra, rb_size_t n)
+{
+    unsigned spins = 0;
+
+    while (atomic_load_explicit(&rb->read, memory_order_acquire) != ra)
+        ring_buffer_backoff(&spins);
+    atomic_store_explicit(&rb->read, ra + n, memory_order_release);
+}
+
+void
+byte_ring_init(struct byte_ring** restrict rb, rb_size_t capacity)
+{
+    struct byte_ring* _rb;
+
+    assert(capacity >= 2 * BYTE_RING_HEADER_SIZE);
+    assert(((capacity - 1) & capacity) == 0); // power of two
+
+    _rb = ring_buffer_os_aligned_alloc(alignof(struct byte_ring), sizeof(*_rb));
+    assert(_rb);
+    _rb->data =
+        ring_buffer_os_aligned_alloc(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE, capacity);
+    assert(_rb->data);
+
+    _rb->capacity = capacity;
+    atomic_init(&_rb->read, 0);
+    atomic_init(&_rb->read_ahead, 0);
+    atomic_init(&_rb->write, 0);
+    atomic_init(&_rb->write_ahead, 0);
+
+    *rb = _rb;
+}
+void
+byte_ring_destroy(struct byte_ring* restrict rb)
+{
+    ring_buffer_os_aligned_free(rb->data);
+    rb->data = NULL;
+    ring_buffer_os_aligned_free(rb);
+}
+
+rb_size_t
+byte_ring_capacity(struct byte_ring* restrict rb)
+{
+    return rb->capacity;
+}
+rb_size_t
+byte_ring_max_record_size(struct byte_ring* restrict rb)
+{
+    return rb->capacity / 2u - BYTE_RING_HEADER_SIZE;
+}
+rb_size_t
+byte_ring_size(struct byte_ring* restrict rb)
+{
+    return atomic_load_explicit(&rb->write, memory_order_acquire)
+           - atomic_load_explicit(&rb->read, memory_order_acquire);
+}
+
+bool
+byte_ring_reserve(
+    struct byte_ring* restrict rb,
+    rb_size_t size,
+    struct byte_ring_record* restrict out_record
+)
+{
+    rb_size_t total;
+    rb_size_t wa;
+    rb_size_t claimed;
+    rb_size_t position;
+
+    out_record->data = NULL;
+    out_record->size = 0;
+    out_record->claimed = 0;
+
+    if (size > byte_ring_max_record_size(rb))
+        return false;
+
+    total = byte_ring_step(size);
+    claimed = byte_ring_claim_write(rb, total, &wa);
+    if (claimed == 0)
+        return false;
+
+    /* Didn't fit before the end: pad up to the end, the record is at offset 0. */
+    position = wa;
+    if (claimed != total) {
+        atomic_store_explicit(
+            byte_ring_header(rb, wa),
+            (claimed - total - BYTE_RING_HEADER_SIZE) | BYTE_RING_PADDING,
+            memory_order_relaxed
+        );
+        position = wa + claimed - total;
+    }
+    atomic_store_explicit(byte_ring_header(rb, position), size, memory_order_relaxed);
+
+    out_record->data =
+        rb->data + ((position + BYTE_RING_HEADER_SIZE) & (rb->capacity - 1u));
+    out_record->size = size;
+    out_record->first = wa;
+    out_record->claimed = claimed;
+    return true;
+}
+void
+byte_ring_commit(
+    struct byte_ring* restrict rb,
+    struct byte_ring_record const* restrict record
+)
+{
+    if (record->claimed)
+        byte_ring_publish_write(rb, record->first, record->claimed);
+}
+bool
+byte_ring_push(struct byte_ring* restrict rb, void const* restrict data, rb_size_t size)
+{
+    struct byte_ring_record record;
+
+    if (!byte_ring_reserve(rb, size, &record))
+        return false;
+
+    memcpy(record.data, data, size);
+    byte_ring_commit(rb, &record);
+    return true;
+}
+
+bool
+byte_ring_peek(
+    struct byte_ring* restrict rb,
+    struct byte_ring_record* restrict out_record
+)
+{
+    rb_size_t first_size;
+    rb_size_t ra;
+    rb_size_t claimed;
+    rb_size_t position;
+
+    out_record->data = NULL;
+    out_record->size = 0;
+    out_record->claimed = 0;
+
+    if (!byte_ring_claim_read(rb, 1, (rb_size_t)-1, &first_size, &ra, &claimed))
+        return false;
+
+    position = ra;
+    out_record->data = byte_ring_next(rb, &position, &out_record->size);
+    out_record->first = ra;
+    out_record->claimed = claimed;
+    return true;
+}
+void
+byte_ring_release(
+    struct byte_ring* restrict rb,
+    struct byte_ring_record const* restrict record
+)
+{
+    if (record->claimed)
+        byte_ring_publish_read(rb, record->first, record->claimed);
+}
+bool
+byte_ring_pop(
+    struct byte_ring* restrict rb,
+    void* restrict out_data,
+    rb_size_t out_capacity,
+    rb_size_t* restrict out_size
+)
+{
+    rb_size_t ra;
+    rb_size_t claimed;
+    rb_size_t position;
+    rb_size_t size;
+    unsigned char const* payload;
+
+    if (!byte_ring_claim_read(rb, 1, out_capacity, out_size, &ra, &claimed))
+        return false;
+
+    position = ra;
+    payload = byte_ring_next(rb, &position, &size);
+    memcpy(out_data, payload, size);
+    byte_ring_publish_read(rb, ra, claimed);
+    return true;
+}
+rb_size_t
+byte_ring_drain(
+    struct byte_ring* restrict rb,
+    byte_ring_drain_fn* fn,
+    void* user,
+    rb_size_t max_records
+)
+{
+    rb_size_t first_size;
+    rb_size_t ra;
+    rb_size_t claimed;
+    rb_size_t position;
+    rb_size_t size;
+    rb_size_t n;
+    rb_size_t i;
+    unsigned char const* payload;
+
+    n = byte_ring_claim_read(
+        rb,
+        max_records,
+        (rb_size_t)-1,
+        &first_size,
+        &ra,
+        &claimed
+    );
+    if (n == 0)
+        return 0;
+
+    position = ra;
+    for (i = 0; i < n; ++i) {
+        payload = byte_ring_next(rb, &position, &size);
+        fn(user, payload, size);
+    }
+
+    byte_ring_publish_read(rb, ra, claimed);
+    return n;
+}
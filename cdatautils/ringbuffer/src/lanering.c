@@ -0,0 +1,322 @@
+#include <cdatautils/lanering.h>
+
+#include "wait.h"
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define internal static
+
+#ifdef CDATAUTILS_RINGBUFFER_USE_ASSERT
+#include <assert.h>
+#else
+#define assert(...) (void)(__VA_ARGS__)
+#endif
+
+/* With LANE_RING_STAMPS, the stamp is stored in front of the item, in the slot. */
+#define LANE_RING_STAMP_SIZE sizeof(uint64_t)
+
+struct lane_ring
+{
+    struct ring_buffer** lanes;
+    rb_size_t lane_count;
+    rb_size_t value_size;
+    unsigned flags;
+
+    /* lane_ring_pop_ordered: the first item of each lane (stamp and item, as in
+    the slots), if `staged[i]`. */
+    unsigned char* heads;
+    bool* staged;
+    /* Read by lane_ring_size, from any thread. */
+    _Atomic rb_size_t staged_count;
+
+    /* LANE_RING_STAMPS. */
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic uint64_t next_stamp;
+};
+
+/* Threads get a lane (index + 1) round-robin, on their first push. */
+static _Atomic unsigned lane_ring_next_thread_lane = 0;
+static _Thread_local unsigned lane_ring_thread_lane = 0;
+/* Where the next pop of this thread starts. */
+static _Thread_local rb_size_t lane_ring_thread_cursor = 0;
+
+internal
+rb_size_t
+lane_ring_slot_size(struct lane_ring* restrict lr)
+{
+    return lr->value_size + (lr->flags & LANE_RING_STAMPS ? LANE_RING_STAMP_SIZE : 0u);
+}
+
+/* Pushes `item` in `rb`, with a new stamp in front of it. */
+internal
+bool
+lane_ring_push_stamped(
+    struct lane_ring* restrict lr,
+    struct ring_buffer* restrict rb,
+    void const* restrict item
+)
+{
+    struct ring_buffer_span span;
+    uint64_t stamp;
+
+    if (!ring_buffer_reserve_write(rb, 1, &span))
+        return false;
+
+    /* Taken after the claim, so that the stamps of a single producer's lane follow
+    its slots. */
+    stamp = atomic_fetch_add_explicit(&lr->next_stamp, 1, memory_order_relaxed);
+    memcpy(span.data, &stamp, LANE_RING_STAMP_SIZE);
+    memcpy((char*)span.data + LANE_RING_STAMP_SIZE, item, lr->value_size);
+    ring_buffer_commit_write(rb, &span);
+    return true;
+}
+/* Pops the first item of `rb` in `out_item`, and its stamp in `out_stamp` (if not
+NULL).
+*/
+internal
+bool
+lane_ring_pop_lane(
+    struct lane_ring* restrict lr,
+    struct ring_buffer* restrict rb,
+    void* restrict out_item,
+    uint64_t* restrict out_stamp
+)
+{
+    struct ring_buffer_span span;
+
+    if (!(lr->flags & LANE_RING_STAMPS))
+        return ring_buffer_pop(rb, out_item);
+
+    if (!ring_buffer_peek_read(rb, 1, &span))
+        return false;
+    if (out_stamp)
+        memcpy(out_stamp, span.data, LANE_RING_STAMP_SIZE);
+    memcpy(out_item, (char const*)span.data + LANE_RING_STAMP_SIZE, lr->value_size);
+    ring_buffer_release_read(rb, &span);
+    return true;
+}
+
+void
+lane_ring_init(
+    struct lane_ring** restrict lr,
+    rb_size_t lanes,
+    rb_size_t lane_capacity,
+    rb_size_t value_size,
+    unsigned flags
+)
+{
+    struct lane_ring* _lr;
+    rb_size_t i;
+
+    assert(lanes > 0);
+    /* Stamped items go through ring_buffer_reserve_write/peek_read. */
+    assert(!(flags & LANE_RING_STAMPS) || !(flags & RING_BUFFER_OVERWRITE));
+
+    _lr = ring_buffer_os_aligned_alloc(alignof(struct lane_ring), sizeof(*_lr));
+    assert(_lr);
+    _lr->lane_count = lanes;
+    _lr->value_size = value_size;
+    _lr->flags = flags;
+    atomic_init(&_lr->next_stamp, 0);
+
+    _lr->lanes = calloc(lanes, sizeof(*_lr->lanes));
+    assert(_lr->lanes);
+    for (i = 0; i < lanes; ++i)
+        ring_buffer_init_flags(
+            &_lr->lanes[i],
+            lane_capacity,
+            lane_ring_slot_size(_lr),
+            flags & ~(unsigned)LANE_RING_STAMPS
+        );
+
+    _lr->heads = NULL;
+    _lr->staged = NULL;
+    atomic_init(&_lr->staged_count, 0);
+    if (flags & LANE_RING_STAMPS) {
+        _lr->heads = malloc((size_t)lanes * lane_ring_slot_size(_lr));
+        _lr->staged = calloc(lanes, sizeof(*_lr->staged));
+        assert(_lr->heads && _lr->staged);
+    }
+
+    *lr = _lr;
+}
+void
+lane_ring_destroy(struct lane_ring* restrict lr)
+{
+    rb_size_t i;
+
+    for (i = 0; i < lr->lane_count; ++i)
+        ring_buffer_destroy(lr->lanes[i]);
+    free(lr->lanes);
+    free(lr->heads);
+    free(lr->staged);
+    ring_buffer_os_aligned_free(lr);
+}
+
+bool
+lane_ring_push(struct lane_ring* restrict lr, void const* restrict item)
+{
+    unsigned lane = lane_ring_thread_lane;
+
+    if (!lane) {
+        lane = atomic_fetch_add_explicit(
+                   &lane_ring_next_thread_lane,
+                   1,
+                   memory_order_relaxed
+               )
+               + 1u;
+        lane_ring_thread_lane = lane;
+    }
+    return lane_ring_push_lane(lr, lane - 1u, item);
+}
+bool
+lane_ring_push_lane(
+    struct lane_ring* restrict lr,
+    rb_size_t lane,
+    void const* restrict item
+)
+{
+    struct ring_buffer* const rb = lr->lanes[lane % lr->lane_count];
+
+    if (lr->flags & LANE_RING_STAMPS)
+        return lane_ring_push_stamped(lr, rb, item);
+    return ring_buffer_push(rb, item);
+}
+
+bool
+lane_ring_pop(struct lane_ring* restrict lr, void* restrict out_item)
+{
+    return lane_ring_pop_stamped(lr, out_item, NULL);
+}
+bool
+lane_ring_pop_stamped(
+    struct lane_ring* restrict lr,
+    void* restrict out_item,
+    uint64_t* restrict out_stamp
+)
+{
+    rb_size_t const lanes = lr->lane_count;
+    rb_size_t const start = lane_ring_thread_cursor;
+    rb_size_t lane;
+    rb_size_t i;
+
+    for (i = 0; i < lanes; ++i) {
+        lane = (start + i) % lanes;
+        if (lane_ring_pop_lane(lr, lr->lanes[lane], out_item, out_stamp)) {
+            lane_ring_thread_cursor = lane + 1u;
+            return true;
+        }
+    }
+    return false;
+}
+rb_size_t
+lane_ring_pop_n(
+    struct lane_ring* restrict lr,
+    void* restrict out_items,
+    rb_size_t n_items
+)
+{
+    rb_size_t const lanes = lr->lane_count;
+    rb_size_t const start = lane_ring_thread_cursor;
+    rb_size_t const value_size = lr->value_size;
+    struct ring_buffer_span span;
+    struct ring_buffer* rb;
+    rb_size_t popped = 0;
+    rb_size_t i;
+    rb_size_t j;
+
+    for (i = 0; i < lanes && popped < n_items; ++i) {
+        rb = lr->lanes[(start + i) % lanes];
+
+        if (!(lr->flags & LANE_RING_STAMPS)) {
+            popped += ring_buffer_pop_n(
+                rb,
+                (char*)out_items + (size_t)popped * value_size,
+                n_items - popped
+            );
+            continue;
+        }
+
+        /* Skip the stamps: copy item by item out of (at most two) spans. */
+        while (popped < n_items && ring_buffer_peek_read(rb, n_items - popped, &span)) {
+            for (j = 0; j < span.count; ++j, ++popped)
+                memcpy(
+                    (char*)out_items + (size_t)popped * value_size,
+                    (char const*)span.data + (size_t)j * span.stride
+                        + LANE_RING_STAMP_SIZE,
+                    value_size
+                );
+            ring_buffer_release_read(rb, &span);
+        }
+    }
+    lane_ring_thread_cursor = start + 1u;
+    return popped;
+}
+bool
+lane_ring_pop_ordered(
+    struct lane_ring* restrict lr,
+    void* restrict out_item,
+    uint64_t* restrict out_stamp
+)
+{
+    rb_size_t const slot_size = lane_ring_slot_size(lr);
+    unsigned char* head;
+    uint64_t stamp = 0;
+    uint64_t best_stamp = 0;
+    rb_size_t best = lr->lane_count;
+    rb_size_t i;
+
+    assert(lr->flags & LANE_RING_STAMPS);
+
+    for (i = 0; i < lr->lane_count; ++i) {
+        head = lr->heads + (size_t)i * slot_size;
+
+        if (!lr->staged[i]) {
+            lr->staged[i] = lane_ring_pop_lane(
+                lr,
+                lr->lanes[i],
+                head + LANE_RING_STAMP_SIZE,
+                &stamp
+            );
+            if (!lr->staged[i])
+                continue;
+            memcpy(head, &stamp, LANE_RING_STAMP_SIZE);
+            atomic_fetch_add_explicit(&lr->staged_count, 1, memory_order_relaxed);
+        }
+
+        memcpy(&stamp, head, LANE_RING_STAMP_SIZE);
+        if (best == lr->lane_count || stamp < best_stamp) {
+            best = i;
+            best_stamp = stamp;
+        }
+    }
+
+    /* If all lanes are "empty", can't pop. */
+    if (best == lr->lane_count)
+        return false;
+
+    head = lr->heads + (size_t)best * slot_size;
+    memcpy(out_item, head + LANE_RING_STAMP_SIZE, lr->value_size);
+    *out_stamp = best_stamp;
+    lr->staged[best] = false;
+    atomic_fetch_sub_explicit(&lr->staged_count, 1, memory_order_relaxed);
+    return true;
+}
+
+rb_size_t
+lane_ring_size(struct lane_ring* restrict lr)
+{
+    rb_size_t size = atomic_load_explicit(&lr->staged_count, memory_order_relaxed);
+    rb_size_t i;
+
+    for (i = 0; i < lr->lane_count; ++i)
+        size += ring_buffer_size(lr->lanes[i]);
+    return size;
+}
+rb_size_t
+lane_ring_lanes(struct lane_ring* restrict lr)
+{
+    return lr->lane_count;
+}
@@ -1,27 +1,1184 @@
 #include <cdatautils/ringbuffer.h>
 
+#include "wait.h"
+
 #include <stdalign.h>
 #include <stdatomic.h>
 #include <string.h>
 #include <stdlib.h>
 
+#define internal static
+
 #ifdef CDATAUTILS_RINGBUFFER_USE_ASSERT
 #include <assert.h>
 #else
 #define assert(...) (void)(__VA_ARGS__)
 #endif
 
+/* Internal flag, the buffer lives in memory shared between processes
+(ring_buffer_init_shm). Set in the shared `flags`, so every process sees it.
+*/
+#define RING_BUFFER_SHARED (1u << 31)
+/* The flags that put the storage in its own mapping (ring_buffer_os_map_pages),
+slots and sequences together. */
+#define RING_BUFFER_PLACEMENT                                                   \
+    (RING_BUFFER_HUGE_PAGES | RING_BUFFER_NUMA_INTERLEAVE | RING_BUFFER_NUMA_NODE_MASK)
+
+/* "RBUF" - the first bytes of a shared memory object holding a ring_buffer. */
+#define RING_BUFFER_SHM_MAGIC 0x46554252u
+/* Bumped whenever struct ring_buffer changes in an incompatible way. The width of
+rb_size_t is part of it (it doesn't always change the size of the struct).
+*/
+#define RING_BUFFER_SHM_VERSION (2u | (uint32_t)sizeof(rb_size_t) << 16)
+
+#ifdef CDATAUTILS_RING_BUFFER_STATS
+/* One shard of the counters of struct ring_buffer_stats, see ring_buffer_stat. */
+struct ring_buffer_stats_shard
+{
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE) _Atomic uint64_t pushes;
+    _Atomic uint64_t pops;
+    _Atomic uint64_t push_full;
+    _Atomic uint64_t pop_empty;
+    _Atomic uint64_t push_busy;
+    _Atomic uint64_t pop_busy;
+    _Atomic uint64_t push_cas_failures;
+    _Atomic uint64_t pop_cas_failures;
+    _Atomic uint64_t push_spins;
+    _Atomic uint64_t pop_spins;
+    _Atomic uint64_t push_sleeps;
+    _Atomic uint64_t pop_sleeps;
+    _Atomic rb_size_t high_water_mark;
+};
+#endif
+
 struct ring_buffer
 {
-    void* data;
+    /* RING_BUFFER_SHARED only, checked by ring_buffer_attach_shm.
+    `magic` is stored last (release), once everything else is initialized.
+    */
+    _Atomic uint32_t magic;
+    uint32_t version;
+    /* sizeof(struct ring_buffer), catches processes built with a different
+    CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE or ABI. */
+    uint32_t header_size;
+    /* The size of the whole mapping (header, slots and sequences). */
+    uint64_t map_size;
+
+    /* The storage is addressed with offsets from the struct itself, not pointers,
+    so that the struct can live in memory mapped at a different address in each
+    process. See ring_buffer_data and ring_buffer_sequences.
+    */
+
+    /* Slot storage, aligned to CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE.
+    With RING_BUFFER_INLINE_DATA (and RING_BUFFER_SHARED), it is right after this
+    struct, in the same block.
+    */
+    intptr_t data_offset;
+    /* RING_BUFFER_SLOT_SEQUENCES only, 0 otherwise. One per slot.
+
+    The slot of index `i` is free for the push of index `i` when its sequence is
+    `i`, and holds the item of index `i` when its sequence is `i + 1`. Popping it
+    sets the sequence to `i + capacity`, freeing it for the next lap.
+    WRITE-AHEAD and READ-AHEAD are the next push/pop index, WRITE and READ are
+    not used.
+
+    RING_BUFFER_OVERWRITE uses them as seqlocks instead, see
+    ring_buffer_push_overwrite.
+    */
+    intptr_t sequences_offset;
     rb_size_t value_size;
     rb_size_t capacity;
+    /* Distance between two slots in `data`, in bytes.
+    `value_size`, rounded up to a cache line with RING_BUFFER_PAD_SLOTS.
+    */
+    rb_size_t stride;
+    /* Distance between two sequences in `sequences`, in elements.
+    1, or a whole cache line with RING_BUFFER_PAD_SLOTS.
+    */
+    rb_size_t sequence_stride;
+    unsigned flags;
     alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t read;
+    /* RING_BUFFER_SINGLE_CONSUMER only. The last WRITE seen by the consumer. */
+    rb_size_t cached_write;
     alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t read_ahead;
     alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t write;
+    /* RING_BUFFER_SINGLE_PRODUCER only. The last READ seen by the producer. */
+    rb_size_t cached_read;
     alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t write_ahead;
+
+    /* Blocking (see ring_buffer_block).
+    Only written when someone actually goes to sleep, so this line stays shared
+    (read-only) in all caches while nobody is waiting.
+    */
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic uint32_t push_waiters;
+    _Atomic uint32_t pop_waiters;
+    /* Bumped after READ moves, if there are `push_waiters`. */
+    _Atomic uint32_t read_event;
+    /* Bumped after WRITE moves, if there are `pop_waiters`. */
+    _Atomic uint32_t write_event;
+
+    /* RING_BUFFER_OVERWRITE only, see ring_buffer_dropped. */
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic uint64_t dropped;
+
+#ifdef CDATAUTILS_RING_BUFFER_STATS
+    struct ring_buffer_stats_shard stats[CDATAUTILS_RING_BUFFER_STATS_SHARDS];
+#endif
 };
 
+#ifdef CDATAUTILS_RING_BUFFER_STATS
+/* Each thread gets its own shard of the counters (round-robin, on its first
+count), so counting is a relaxed add on a line that no other thread writes - as
+long as there are no more threads than shards.
+*/
+static _Atomic unsigned ring_buffer_stats_next_shard = 0;
+static _Thread_local unsigned ring_buffer_stats_thread_shard = 0; /* index + 1 */
+
+internal
+struct ring_buffer_stats_shard*
+ring_buffer_stats_shard(struct ring_buffer* restrict rb)
+{
+    unsigned shard = ring_buffer_stats_thread_shard;
+
+    if (!shard) {
+        shard = atomic_fetch_add_explicit(
+            &ring_buffer_stats_next_shard,
+            1,
+            memory_order_relaxed
+        );
+        shard = shard % CDATAUTILS_RING_BUFFER_STATS_SHARDS + 1u;
+        ring_buffer_stats_thread_shard = shard;
+    }
+    return &rb->stats[shard - 1u];
+}
+/* Counts `n` pushed items, and raises the high-water mark of our shard. */
+internal
+void
+ring_buffer_stats_pushed(struct ring_buffer* restrict rb, rb_size_t n)
+{
+    struct ring_buffer_stats_shard* const shard = ring_buffer_stats_shard(rb);
+    rb_size_t const size = ring_buffer_size(rb);
+    rb_size_t high =
+        atomic_load_explicit(&shard->high_water_mark, memory_order_relaxed);
+
+    atomic_fetch_add_explicit(&shard->pushes, n, memory_order_relaxed);
+    while (size > high
+           && !atomic_compare_exchange_weak_explicit(
+               &shard->high_water_mark,
+               &high,
+               size,
+               memory_order_relaxed,
+               memory_order_relaxed
+           ))
+        ;
+}
+
+/* Adds `n` to `counter` (a field of struct ring_buffer_stats). */
+#define ring_buffer_stat(rb, counter, n)       \
+    atomic_fetch_add_explicit(                 \
+        &ring_buffer_stats_shard(rb)->counter, \
+        (uint64_t)(n),                         \
+        memory_order_relaxed                   \
+    )
+/* The result of the CAS `cas`, counted in `counter` if it failed. */
+#define ring_buffer_stat_cas(rb, counter, cas) \
+    ((cas) || (ring_buffer_stat(rb, counter, 1), false))
+#define ring_buffer_stat_pushed(rb, n) ring_buffer_stats_pushed((rb), (n))
+#else
+#define ring_buffer_stat(rb, counter, n) ((void)0)
+#define ring_buffer_stat_cas(rb, counter, cas) (cas)
+#define ring_buffer_stat_pushed(rb, n) ((void)0)
+#endif
+
+/* Returns a pointer to `offset` bytes from `rb` (the offset may be negative, when
+the storage was allocated separately).
+*/
+internal
+void*
+ring_buffer_at(struct ring_buffer* restrict rb, intptr_t offset)
+{
+    return (void*)((uintptr_t)rb + (uintptr_t)offset);
+}
+internal
+intptr_t
+ring_buffer_offset_of(struct ring_buffer* restrict rb, void* memory)
+{
+    return (intptr_t)((uintptr_t)memory - (uintptr_t)rb);
+}
+#define ring_buffer_data(rb) ((char*)ring_buffer_at((rb), (rb)->data_offset))
+#define ring_buffer_sequences(rb) \
+    ((_Atomic rb_size_t*)ring_buffer_at((rb), (rb)->sequences_offset))
+
+/* Called after every store to WRITE/READ. Wakes up the other side, but only if
+someone is sleeping on `event`.
+
+The fence pairs with the one in ring_buffer_block: either the sleeper sees the
+new WRITE/READ when it re-checks, or we see the sleeper in `waiters`. The sleeper
+pays for the heavy half so that push/pop usually get away with a compiler barrier.
+
+Not across processes though: the heavy fence only reaches the threads of the
+process that issues it, so RING_BUFFER_SHARED buffers use full fences on both sides.
+*/
+internal
+void
+ring_buffer_notify(
+    struct ring_buffer* restrict rb,
+    _Atomic uint32_t* waiters,
+    _Atomic uint32_t* event
+)
+{
+    bool const shared = rb->flags & RING_BUFFER_SHARED;
+
+    if (shared)
+        atomic_thread_fence(memory_order_seq_cst);
+    else
+        ring_buffer_light_fence();
+    if (atomic_load_explicit(waiters, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(event, 1, memory_order_release);
+        ring_buffer_os_wake_all(event, shared);
+    }
+}
+#define ring_buffer_notify_consumers(rb) \
+    ring_buffer_notify((rb), &(rb)->pop_waiters, &(rb)->write_event)
+#define ring_buffer_notify_producers(rb) \
+    ring_buffer_notify((rb), &(rb)->push_waiters, &(rb)->read_event)
+
+/* Single-producer and single-consumer sides don't need WRITE-AHEAD/READ-AHEAD at
+all. There is only one thread that can move WRITE (or READ), so it "claims" slots
+by just looking at its own counter, and publishes them with a plain store.
+The other side's counter is cached, so it is only loaded (and its cache line only
+bounced) when the cached value says the buffer is full (or empty).
+*/
+internal
+rb_size_t
+ring_buffer_claim_write_single(
+    struct ring_buffer* restrict rb,
+    rb_size_t min,
+    rb_size_t max,
+    bool contiguous,
+    rb_size_t* restrict out_w
+)
+{
+    rb_size_t const cap = rb->capacity;
+    rb_size_t const w = atomic_load_explicit(&rb->write, memory_order_relaxed);
+    rb_size_t n = cap - (w - rb->cached_read);
+
+    if (n < min || n < max) {
+        rb->cached_read = atomic_load_explicit(&rb->read, memory_order_acquire);
+        n = cap - (w - rb->cached_read);
+    }
+    if (n > max)
+        n = max;
+    if (contiguous && n > cap - (w & (cap - 1u)))
+        n = cap - (w & (cap - 1u));
+
+    /* If the buffer is "full", can't push. */
+    if (n < min) {
+        ring_buffer_stat(rb, push_full, 1);
+        return 0;
+    }
+
+    *out_w = w;
+    return n;
+}
+internal
+rb_size_t
+ring_buffer_claim_read_single(
+    struct ring_buffer* restrict rb,
+    rb_size_t min,
+    rb_size_t max,
+    bool contiguous,
+    rb_size_t* restrict out_r
+)
+{
+    rb_size_t const cap = rb->capacity;
+    rb_size_t const r = atomic_load_explicit(&rb->read, memory_order_relaxed);
+    rb_size_t n = rb->cached_write - r;
+
+    if (n < min || n < max) {
+        rb->cached_write = atomic_load_explicit(&rb->write, memory_order_acquire);
+        n = rb->cached_write - r;
+    }
+    if (n > max)
+        n = max;
+    if (contiguous && n > cap - (r & (cap - 1u)))
+        n = cap - (r & (cap - 1u));
+
+    /* If the buffer is "empty", can't pop. */
+    if (n < min) {
+        ring_buffer_stat(rb, pop_empty, 1);
+        return 0;
+    }
+
+    *out_r = r;
+    return n;
+}
+
+/* Returns the sequence of the slot of the `index`th WRITE/READ.
+RING_BUFFER_SLOT_SEQUENCES and RING_BUFFER_OVERWRITE only.
+*/
+internal
+_Atomic rb_size_t*
+ring_buffer_sequence(struct ring_buffer* restrict rb, rb_size_t index)
+{
+    return ring_buffer_sequences(rb)
+           + (size_t)(index & (rb->capacity - 1u)) * rb->sequence_stride;
+}
+
+/* RING_BUFFER_SLOT_SEQUENCES: each claimed slot is checked on its own sequence
+number, there is no WRITE/READ to wait on.
+
+Looks at the slots from WRITE-AHEAD on, counts how many in a row are free, then
+claims them with a single CAS. A free slot can only be taken by whoever owns
+its WRITE-AHEAD index, so they are still free once the CAS succeeds.
+*/
+internal
+rb_size_t
+ring_buffer_claim_write_slots(
+    struct ring_buffer* restrict rb,
+    rb_size_t min,
+    rb_size_t max,
+    bool contiguous,
+    rb_size_t* restrict out_wa
+)
+{
+    rb_size_t const cap = rb->capacity;
+    rb_size_t wa = atomic_load_explicit(&rb->write_ahead, memory_order_relaxed);
+    rb_size_t limit;
+    rb_size_t seq;
+    rb_size_t n;
+
+    for (;;) {
+        limit = max < cap ? max : cap;
+        if (contiguous && limit > cap - (wa & (cap - 1u)))
+            limit = cap - (wa & (cap - 1u));
+
+        seq = wa;
+        for (n = 0; n < limit; ++n) {
+            seq = atomic_load_explicit(
+                ring_buffer_sequence(rb, wa + n),
+                memory_order_acquire
+            );
+            if (seq != wa + n)
+                break;
+        }
+
+        /* Another producer already took this slot, our WRITE-AHEAD is stale. */
+        if (n < limit && (rb_ssize_t)(seq - (wa + n)) > 0) {
+            wa = atomic_load_explicit(&rb->write_ahead, memory_order_relaxed);
+            continue;
+        }
+
+        /* If the buffer is "full" (the slot wasn't popped yet), can't push. */
+        if (n < min) {
+            ring_buffer_stat(rb, push_full, 1);
+            return 0;
+        }
+
+        if (ring_buffer_stat_cas(
+                rb,
+                push_cas_failures,
+                atomic_compare_exchange_weak_explicit(
+                    &rb->write_ahead,
+                    &wa,
+                    wa + n,
+                    memory_order_relaxed,
+                    memory_order_relaxed
+                )
+            ))
+            break;
+    }
+
+    *out_wa = wa;
+    return n;
+}
+/* Same as ring_buffer_claim_write_slots, for READ-AHEAD. */
+internal
+rb_size_t
+ring_buffer_claim_read_slots(
+    struct ring_buffer* restrict rb,
+    rb_size_t min,
+    rb_size_t max,
+    bool contiguous,
+    rb_size_t* restrict out_ra
+)
+{
+    rb_size_t const cap = rb->capacity;
+    rb_size_t ra = atomic_load_explicit(&rb->read_ahead, memory_order_relaxed);
+    rb_size_t limit;
+    rb_size_t seq;
+    rb_size_t n;
+
+    for (;;) {
+        limit = max < cap ? max : cap;
+        if (contiguous && limit > cap - (ra & (cap - 1u)))
+            limit = cap - (ra & (cap - 1u));
+
+        seq = ra + 1u;
+        for (n = 0; n < limit; ++n) {
+            seq = atomic_load_explicit(
+                ring_buffer_sequence(rb, ra + n),
+                memory_order_acquire
+            );
+            if (seq != ra + n + 1u)
+                break;
+        }
+
+        /* Another consumer already took this slot, our READ-AHEAD is stale. */
+        if (n < limit && (rb_ssize_t)(seq - (ra + n + 1u)) > 0) {
+            ra = atomic_load_explicit(&rb->read_ahead, memory_order_relaxed);
+            continue;
+        }
+
+        /* If the buffer is "empty" (the slot wasn't pushed yet), can't pop. */
+        if (n < min) {
+            ring_buffer_stat(rb, pop_empty, 1);
+            return 0;
+        }
+
+        if (ring_buffer_stat_cas(
+                rb,
+                pop_cas_failures,
+                atomic_compare_exchange_weak_explicit(
+                    &rb->read_ahead,
+                    &ra,
+                    ra + n,
+                    memory_order_relaxed,
+                    memory_order_relaxed
+                )
+            ))
+            break;
+    }
+
+    *out_ra = ra;
+    return n;
+}
+
+/* Claims between `min` and `max` (inclusive) consecutive WRITE-AHEAD slots, with a
+single CAS.
+
+If `contiguous` is set, the claim also stops at the wrap point, so that all
+claimed slots are adjacent in memory.
+
+Returns the number of claimed slots and writes the first one in `out_wa`.
+Returns 0 if there was no space for at least `min` items.
+*/
+internal
+rb_size_t
+ring_buffer_claim_write(
+    struct ring_buffer* restrict rb,
+    rb_size_t min,
+    rb_size_t max,
+    bool contiguous,
+    rb_size_t* restrict out_wa
+)
+{
+    rb_size_t const cap = rb->capacity;
+    rb_size_t wa;
+    rb_size_t used;
+    rb_size_t n;
+
+    /* Claimed slots could be overwritten before they are published. */
+    if (rb->flags & RING_BUFFER_OVERWRITE)
+        return 0;
+    if (rb->flags & RING_BUFFER_SLOT_SEQUENCES)
+        return ring_buffer_claim_write_slots(rb, min, max, contiguous, out_wa);
+    if (rb->flags & RING_BUFFER_SINGLE_PRODUCER)
+        return ring_buffer_claim_write_single(rb, min, max, contiguous, out_wa);
+
+    wa = atomic_load_explicit(&rb->write_ahead, memory_order_acquire);
+    for (;;) {
+        used = wa - atomic_load_explicit(&rb->read, memory_order_acquire);
+
+        /* READ has moved past our (stale) WRITE-AHEAD, reload it. */
+        if (used > cap) {
+            wa = atomic_load_explicit(&rb->write_ahead, memory_order_acquire);
+            continue;
+        }
+
+        n = cap - used;
+        if (n > max)
+            n = max;
+        if (contiguous && n > cap - (wa & (cap - 1u)))
+            n = cap - (wa & (cap - 1u));
+
+        /* If the buffer is "full", can't push. */
+        if (n < min) {
+            ring_buffer_stat(rb, push_full, 1);
+            return 0;
+        }
+
+        if (ring_buffer_stat_cas(
+                rb,
+                push_cas_failures,
+                atomic_compare_exchange_weak_explicit(
+                    &rb->write_ahead,
+                    &wa,
+                    wa + n,
+                    memory_order_acquire,
+                    memory_order_acquire
+                )
+            ))
+            break;
+    }
+
+    *out_wa = wa;
+    return n;
+}
+/* Claims between `min` and `max` (inclusive) consecutive READ-AHEAD slots, with a
+single CAS.
+
+If `contiguous` is set, the claim also stops at the wrap point, so that all
+claimed slots are adjacent in memory.
+
+Returns the number of claimed slots and writes the first one in `out_ra`.
+Returns 0 if there were less than `min` items.
+*/
+internal
+rb_size_t
+ring_buffer_claim_read(
+    struct ring_buffer* restrict rb,
+    rb_size_t min,
+    rb_size_t max,
+    bool contiguous,
+    rb_size_t* restrict out_ra
+)
+{
+    rb_size_t const cap = rb->capacity;
+    rb_size_t ra;
+    rb_size_t n;
+
+    /* Claimed slots could be overwritten before they are released. */
+    if (rb->flags & RING_BUFFER_OVERWRITE)
+        return 0;
+    if (rb->flags & RING_BUFFER_SLOT_SEQUENCES)
+        return ring_buffer_claim_read_slots(rb, min, max, contiguous, out_ra);
+    if (rb->flags & RING_BUFFER_SINGLE_CONSUMER)
+        return ring_buffer_claim_read_single(rb, min, max, contiguous, out_ra);
+
+    ra = atomic_load_explicit(&rb->read_ahead, memory_order_acquire);
+    do {
+        n = atomic_load_explicit(&rb->write, memory_order_acquire) - ra;
+        if (n > max)
+            n = max;
+        if (contiguous && n > cap - (ra & (cap - 1u)))
+            n = cap - (ra & (cap - 1u));
+
+        /* If the buffer is "empty", can't pop. */
+        if (n < min) {
+            ring_buffer_stat(rb, pop_empty, 1);
+            return 0;
+        }
+    } while (!ring_buffer_stat_cas(
+        rb,
+        pop_cas_failures,
+        atomic_compare_exchange_weak_explicit(
+            &rb->read_ahead,
+            &ra,
+            ra + n,
+            memory_order_acquire,
+            memory_order_acquire
+        )
+    ));
+
+    *out_ra = ra;
+    return n;
+}
+/* Returns a pointer to the slot of the `index`th WRITE/READ. */
+internal
+char*
+ring_buffer_slot(struct ring_buffer* restrict rb, rb_size_t index)
+{
+    return ring_buffer_data(rb) + (index & (rb->capacity - 1u)) * (size_t)rb->stride;
+}
+/* Copies `n` items from `items` in the slots starting at `first`.
+At most two memcpy calls, one on each side of the wrap point (one with
+RING_BUFFER_DOUBLE_MAPPED, or one per item with RING_BUFFER_PAD_SLOTS).
+*/
+internal
+void
+ring_buffer_copy_in(
+    struct ring_buffer* restrict rb,
+    rb_size_t first,
+    rb_size_t n,
+    void const* restrict items
+)
+{
+    size_t const value_size = rb->value_size;
+    rb_size_t const cap = rb->capacity;
+    rb_size_t const index = first & (cap - 1u);
+    rb_size_t const n_tail = n < cap - index || (rb->flags & RING_BUFFER_DOUBLE_MAPPED)
+                                 ? n
+                                 : cap - index;
+    char* const data = ring_buffer_data(rb);
+    rb_size_t i;
+
+    if (rb->stride != value_size) {
+        for (i = 0; i < n; ++i)
+            memcpy(
+                ring_buffer_slot(rb, first + i),
+                (char const*)items + i * value_size,
+                value_size
+            );
+        return;
+    }
+
+    memcpy(data + index * value_size, items, n_tail * value_size);
+    if (n > n_tail)
+        memcpy(
+            data,
+            (char const*)items + n_tail * value_size,
+            (n - n_tail) * value_size
+        );
+}
+/* Copies `n` items from the slots starting at `first` in `out_items`.
+At most two memcpy calls, one on each side of the wrap point (one with
+RING_BUFFER_DOUBLE_MAPPED, or one per item with RING_BUFFER_PAD_SLOTS).
+*/
+internal
+void
+ring_buffer_copy_out(
+    struct ring_buffer* restrict rb,
+    rb_size_t first,
+    rb_size_t n,
+    void* restrict out_items
+)
+{
+    size_t const value_size = rb->value_size;
+    rb_size_t const cap = rb->capacity;
+    rb_size_t const index = first & (cap - 1u);
+    rb_size_t const n_tail = n < cap - index || (rb->flags & RING_BUFFER_DOUBLE_MAPPED)
+                                 ? n
+                                 : cap - index;
+    char const* const data = ring_buffer_data(rb);
+    rb_size_t i;
+
+    if (rb->stride != value_size) {
+        for (i = 0; i < n; ++i)
+            memcpy(
+                (char*)out_items + i * value_size,
+                ring_buffer_slot(rb, first + i),
+                value_size
+            );
+        return;
+    }
+
+    memcpy(out_items, data + index * value_size, n_tail * value_size);
+    if (n > n_tail)
+        memcpy(
+            (char*)out_items + n_tail * value_size,
+            data,
+            (n - n_tail) * value_size
+        );
+}
+/* When WRITE reaches `wa`, set WRITE = `wa` + `n`.
+With RING_BUFFER_SLOT_SEQUENCES, mark the slots as full instead (no waiting).
+*/
+internal
+void
+ring_buffer_publish_write(struct ring_buffer* restrict rb, rb_size_t wa, rb_size_t n)
+{
+    unsigned spins = 0;
+    rb_size_t i;
+
+    if (rb->flags & RING_BUFFER_SLOT_SEQUENCES) {
+        for (i = 0; i < n; ++i)
+            atomic_store_explicit(
+                ring_buffer_sequence(rb, wa + i),
+                wa + i + 1u,
+                memory_order_release
+            );
+        ring_buffer_stat_pushed(rb, n);
+        ring_buffer_notify_consumers(rb);
+        return;
+    }
+
+    if (!(rb->flags & RING_BUFFER_SINGLE_PRODUCER)) {
+        while (atomic_load_explicit(&rb->write, memory_order_acquire) != wa)
+            ring_buffer_backoff(&spins);
+        ring_buffer_stat(rb, push_spins, spins);
+    }
+    atomic_store_explicit(&rb->write, wa + n, memory_order_release);
+    ring_buffer_stat_pushed(rb, n);
+    ring_buffer_notify_consumers(rb);
+}
+/* When READ reaches `ra`, set READ = `ra` + `n`.
+With RING_BUFFER_SLOT_SEQUENCES, free the slots for the next lap instead.
+*/
+internal
+void
+ring_buffer_publish_read(struct ring_buffer* restrict rb, rb_size_t ra, rb_size_t n)
+{
+    rb_size_t const cap = rb->capacity;
+    unsigned spins = 0;
+    rb_size_t i;
+
+    if (rb->flags & RING_BUFFER_SLOT_SEQUENCES) {
+        for (i = 0; i < n; ++i)
+            atomic_store_explicit(
+                ring_buffer_sequence(rb, ra + i),
+                ra + i + cap,
+                memory_order_release
+            );
+        ring_buffer_stat(rb, pops, n);
+        ring_buffer_notify_producers(rb);
+        return;
+    }
+
+    if (!(rb->flags & RING_BUFFER_SINGLE_CONSUMER)) {
+        while (atomic_load_explicit(&rb->read, memory_order_acquire) != ra)
+            ring_buffer_backoff(&spins);
+        ring_buffer_stat(rb, pop_spins, spins);
+    }
+    atomic_store_explicit(&rb->read, ra + n, memory_order_release);
+    ring_buffer_stat(rb, pops, n);
+    ring_buffer_notify_producers(rb);
+}
+
+/* The whole single-producer push: no CAS, no spinning. */
+internal
+bool
+ring_buffer_push_single(struct ring_buffer* restrict rb, void const* restrict item)
+{
+    rb_size_t w;
+
+    if (!ring_buffer_claim_write_single(rb, 1, 1, false, &w))
+        return false;
+
+    memcpy(ring_buffer_slot(rb, w), item, rb->value_size);
+    atomic_store_explicit(&rb->write, w + 1, memory_order_release);
+    ring_buffer_stat_pushed(rb, 1);
+    ring_buffer_notify_consumers(rb);
+    return true;
+}
+/* The whole single-consumer pop: no CAS, no spinning. */
+internal
+bool
+ring_buffer_pop_single(struct ring_buffer* restrict rb, void* restrict out_item)
+{
+    rb_size_t r;
+
+    if (!ring_buffer_claim_read_single(rb, 1, 1, false, &r))
+        return false;
+
+    memcpy(out_item, ring_buffer_slot(rb, r), rb->value_size);
+    atomic_store_explicit(&rb->read, r + 1, memory_order_release);
+    ring_buffer_stat(rb, pops, 1);
+    ring_buffer_notify_producers(rb);
+    return true;
+}
+
+/* The whole RING_BUFFER_SLOT_SEQUENCES push (D. Vyukov's bounded MPMC queue).
+
+Only ever waits on its own slot: if it is free, take it with a CAS on WRITE-AHEAD,
+if it still holds an item from the previous lap, the buffer is full.
+*/
+internal
+bool
+ring_buffer_push_slots(struct ring_buffer* restrict rb, void const* restrict item)
+{
+    rb_size_t wa = atomic_load_explicit(&rb->write_ahead, memory_order_relaxed);
+    _Atomic rb_size_t* slot_seq;
+    rb_size_t seq;
+
+    for (;;) {
+        slot_seq = ring_buffer_sequence(rb, wa);
+        seq = atomic_load_explicit(slot_seq, memory_order_acquire);
+
+        if (seq == wa) {
+            if (ring_buffer_stat_cas(
+                    rb,
+                    push_cas_failures,
+                    atomic_compare_exchange_weak_explicit(
+                        &rb->write_ahead,
+                        &wa,
+                        wa + 1u,
+                        memory_order_relaxed,
+                        memory_order_relaxed
+                    )
+                ))
+                break;
+        } else if ((rb_ssize_t)(seq - wa) < 0) {
+            /* If the buffer is "full", can't push. */
+            ring_buffer_stat(rb, push_full, 1);
+            return false;
+        } else {
+            wa = atomic_load_explicit(&rb->write_ahead, memory_order_relaxed);
+        }
+    }
+
+    memcpy(ring_buffer_slot(rb, wa), item, rb->value_size);
+    atomic_store_explicit(slot_seq, wa + 1u, memory_order_release);
+    ring_buffer_stat_pushed(rb, 1);
+    ring_buffer_notify_consumers(rb);
+    return true;
+}
+/* The whole RING_BUFFER_SLOT_SEQUENCES pop, see ring_buffer_push_slots. */
+internal
+bool
+ring_buffer_pop_slots(struct ring_buffer* restrict rb, void* restrict out_item)
+{
+    rb_size_t const cap = rb->capacity;
+    rb_size_t ra = atomic_load_explicit(&rb->read_ahead, memory_order_relaxed);
+    _Atomic rb_size_t* slot_seq;
+    rb_size_t seq;
+
+    for (;;) {
+        slot_seq = ring_buffer_sequence(rb, ra);
+        seq = atomic_load_explicit(slot_seq, memory_order_acquire);
+
+        if (seq == ra + 1u) {
+            if (ring_buffer_stat_cas(
+                    rb,
+                    pop_cas_failures,
+                    atomic_compare_exchange_weak_explicit(
+                        &rb->read_ahead,
+                        &ra,
+                        ra + 1u,
+                        memory_order_relaxed,
+                        memory_order_relaxed
+                    )
+                ))
+                break;
+        } else if ((rb_ssize_t)(seq - (ra + 1u)) < 0) {
+            /* If the buffer is "empty", can't pop. */
+            ring_buffer_stat(rb, pop_empty, 1);
+            return false;
+        } else {
+            ra = atomic_load_explicit(&rb->read_ahead, memory_order_relaxed);
+        }
+    }
+
+    memcpy(out_item, ring_buffer_slot(rb, ra), rb->value_size);
+    atomic_store_explicit(slot_seq, ra + cap, memory_order_release);
+    ring_buffer_stat(rb, pops, 1);
+    ring_buffer_notify_producers(rb);
+    return true;
+}
+
+/* The lap of the item `index`, in the sequence of its slot (the slot bits are
+implied by the slot).
+*/
+#define ring_buffer_lap(rb, index) ((index) & ~((rb)->capacity - 1u))
+/* The low bit of a RING_BUFFER_OVERWRITE sequence: the slot holds the item of the
+lap, otherwise a producer is in the middle of writing it.
+*/
+#define RING_BUFFER_SEQUENCE_WRITTEN 1u
+
+/* The whole RING_BUFFER_OVERWRITE push.
+
+WRITE-AHEAD is simply incremented, without looking at READ-AHEAD. The sequence of
+the slot works as a seqlock: set to the lap of `wa` (not written) with a CAS, so
+that two producers a lap apart don't write the slot at the same time, then to the
+lap | RING_BUFFER_SEQUENCE_WRITTEN once the item is there.
+*/
+internal
+bool
+ring_buffer_push_overwrite(struct ring_buffer* restrict rb, void const* restrict item)
+{
+    unsigned spins = 0;
+    rb_size_t const wa =
+        atomic_fetch_add_explicit(&rb->write_ahead, 1u, memory_order_relaxed);
+    rb_size_t const lap = ring_buffer_lap(rb, wa);
+    _Atomic rb_size_t* const slot_seq = ring_buffer_sequence(rb, wa);
+    rb_size_t seq = atomic_load_explicit(slot_seq, memory_order_relaxed);
+
+    for (;;) {
+        /* A producer of a later lap already took the slot: our item is as good as
+        overwritten. Consumers skip (and count) it. */
+        if ((rb_ssize_t)(ring_buffer_lap(rb, seq) - lap) >= 0) {
+            ring_buffer_stat_pushed(rb, 1);
+            return true;
+        }
+
+        /* A producer of an earlier lap is still writing the slot. */
+        if (!(seq & RING_BUFFER_SEQUENCE_WRITTEN)) {
+            ring_buffer_backoff(&spins);
+            seq = atomic_load_explicit(slot_seq, memory_order_relaxed);
+            continue;
+        }
+
+        if (atomic_compare_exchange_weak_explicit(
+                slot_seq,
+                &seq,
+                lap,
+                memory_order_relaxed,
+                memory_order_relaxed
+            ))
+            break;
+    }
+    ring_buffer_stat(rb, push_spins, spins);
+
+    /* The sequence must be seen as "being written" before any byte of the item
+    (pairs with the fence in ring_buffer_pop_overwrite). */
+    atomic_thread_fence(memory_order_release);
+    memcpy(ring_buffer_slot(rb, wa), item, rb->value_size);
+    atomic_store_explicit(
+        slot_seq,
+        lap | RING_BUFFER_SEQUENCE_WRITTEN,
+        memory_order_release
+    );
+    ring_buffer_stat_pushed(rb, 1);
+    ring_buffer_notify_consumers(rb);
+    return true;
+}
+/* The whole RING_BUFFER_OVERWRITE pop, see ring_buffer_push_overwrite.
+
+Copies the item of READ-AHEAD out of its slot, then checks that the sequence is
+still the same (otherwise the copy may be torn), and only then takes it with a CAS
+on READ-AHEAD. If the slot was taken by a later lap, READ-AHEAD jumps to the
+oldest item that may still be there.
+*/
+internal
+bool
+ring_buffer_pop_overwrite(struct ring_buffer* restrict rb, void* restrict out_item)
+{
+    rb_size_t const cap = rb->capacity;
+    rb_size_t ra = atomic_load_explicit(&rb->read_ahead, memory_order_relaxed);
+    _Atomic rb_size_t* slot_seq;
+    rb_size_t seq;
+    rb_size_t next;
+    rb_ssize_t ahead;
+
+    for (;;) {
+        slot_seq = ring_buffer_sequence(rb, ra);
+        seq = atomic_load_explicit(slot_seq, memory_order_acquire);
+        ahead = (rb_ssize_t)(ring_buffer_lap(rb, seq) - ring_buffer_lap(rb, ra));
+
+        if (ahead < 0 || (ahead == 0 && !(seq & RING_BUFFER_SEQUENCE_WRITTEN))) {
+            /* If the buffer is "empty" (or another consumer moved READ-AHEAD past
+            a slot that is not written yet), can't pop. */
+            next = atomic_load_explicit(&rb->read_ahead, memory_order_relaxed);
+            if (next != ra) {
+                ra = next;
+                continue;
+            }
+            ring_buffer_stat(rb, pop_empty, 1);
+            return false;
+        }
+
+        if (ahead > 0) {
+            /* Overwritten, skip to the oldest item that may still be there. */
+            next = atomic_load_explicit(&rb->write_ahead, memory_order_relaxed) - cap;
+            if ((rb_ssize_t)(next - ra) <= 0)
+                next = ra + 1u;
+            if (ring_buffer_stat_cas(
+                    rb,
+                    pop_cas_failures,
+                    atomic_compare_exchange_strong_explicit(
+                        &rb->read_ahead,
+                        &ra,
+                        next,
+                        memory_order_relaxed,
+                        memory_order_relaxed
+                    )
+                )) {
+                atomic_fetch_add_explicit(
+                    &rb->dropped,
+                    next - ra,
+                    memory_order_relaxed
+                );
+                ra = next;
+            }
+            continue;
+        }
+
+        memcpy(out_item, ring_buffer_slot(rb, ra), rb->value_size);
+
+        /* If a producer started overwriting the slot meanwhile, the copy may be
+        torn. The next round sees the later lap and skips it. */
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(slot_seq, memory_order_relaxed) != seq)
+            continue;
+
+        if (ring_buffer_stat_cas(
+                rb,
+                pop_cas_failures,
+                atomic_compare_exchange_weak_explicit(
+                    &rb->read_ahead,
+                    &ra,
+                    ra + 1u,
+                    memory_order_relaxed,
+                    memory_order_relaxed
+                )
+            ))
+            break;
+    }
+
+    ring_buffer_stat(rb, pops, 1);
+    return true;
+}
+
+/* The slow path of the blocking push/pop, once the buffer was found full/empty.
+
+Spins briefly, then yields, then sleeps until the other side signals progress.
+Retries ring_buffer_push(push_item) if `push_item` is set, otherwise
+ring_buffer_pop(pop_item).
+
+Returns true once the push/pop succeeded.
+Returns false if `timeout_ns` passed first.
+*/
+internal
+bool
+ring_buffer_block(
+    struct ring_buffer* restrict rb,
+    void const* restrict push_item,
+    void* restrict pop_item,
+    uint64_t timeout_ns
+)
+{
+    bool const push = push_item != NULL;
+    bool const shared = rb->flags & RING_BUFFER_SHARED;
+    _Atomic uint32_t* const waiters = push ? &rb->push_waiters : &rb->pop_waiters;
+    _Atomic uint32_t* const event = push ? &rb->read_event : &rb->write_event;
+    uint64_t deadline = RING_BUFFER_WAIT_FOREVER;
+    uint64_t now;
+    uint32_t seen_event;
+    unsigned i;
+    bool done;
+
+    if (timeout_ns == 0)
+        return false;
+    if (timeout_ns != RING_BUFFER_WAIT_FOREVER)
+        deadline = ring_buffer_os_now_ns() + timeout_ns;
+
+    for (i = 0; i < CDATAUTILS_RING_BUFFER_SPIN_COUNT
+                        + CDATAUTILS_RING_BUFFER_YIELD_COUNT;
+         ++i) {
+        if (i < CDATAUTILS_RING_BUFFER_SPIN_COUNT)
+            ring_buffer_cpu_relax();
+        else
+            ring_buffer_os_yield();
+
+        if (push ? ring_buffer_push(rb, push_item) : ring_buffer_pop(rb, pop_item))
+            return true;
+    }
+
+    for (;;) {
+        if (deadline != RING_BUFFER_WAIT_FOREVER) {
+            now = ring_buffer_os_now_ns();
+            if (now >= deadline)
+                return false;
+            timeout_ns = deadline - now;
+        }
+
+        /* Register as a waiter BEFORE the last check, see ring_buffer_notify. */
+        atomic_fetch_add_explicit(waiters, 1, memory_order_seq_cst);
+        if (shared)
+            atomic_thread_fence(memory_order_seq_cst);
+        else
+            ring_buffer_os_heavy_fence();
+        seen_event = atomic_load_explicit(event, memory_order_acquire);
+
+        done = push ? ring_buffer_push(rb, push_item) : ring_buffer_pop(rb, pop_item);
+        if (!done) {
+            ring_buffer_stat(rb, push_sleeps, push);
+            ring_buffer_stat(rb, pop_sleeps, !push);
+            ring_buffer_os_wait(event, seen_event, timeout_ns, shared);
+        }
+
+        atomic_fetch_sub_explicit(waiters, 1, memory_order_relaxed);
+        if (done)
+            return true;
+    }
+}
+
+/* Computes the distances between slots/sequences and the sizes of their storage.
+Both sizes are multiples of a cache line, so the sequences can follow the slots in
+the same block.
+*/
+internal
+void
+ring_buffer_layout(
+    rb_size_t capacity,
+    rb_size_t value_size,
+    unsigned flags,
+    rb_size_t* restrict out_stride,
+    rb_size_t* restrict out_sequence_stride,
+    size_t* restrict out_data_size,
+    size_t* restrict out_sequences_size
+)
+{
+    size_t const line = CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE;
+
+    *out_stride = value_size;
+    *out_sequence_stride = 1;
+    if (flags & RING_BUFFER_PAD_SLOTS) {
+        *out_stride = (rb_size_t)((value_size + line - 1u) & ~(line - 1u));
+        *out_sequence_stride = (rb_size_t)(line / sizeof(rb_size_t));
+    }
+
+    *out_data_size = ((size_t)capacity * *out_stride + line - 1u) & ~(line - 1u);
+    *out_sequences_size = 0;
+    if (flags & (RING_BUFFER_SLOT_SEQUENCES | RING_BUFFER_OVERWRITE)) {
+        *out_sequences_size = (size_t)capacity * *out_sequence_stride;
+        *out_sequences_size *= sizeof(rb_size_t);
+        *out_sequences_size = (*out_sequences_size + line - 1u) & ~(line - 1u);
+    }
+}
+/* Initializes the fields of `rb`, whose storage is already allocated. */
+internal
+void
+ring_buffer_setup(
+    struct ring_buffer* restrict rb,
+    void* data,
+    _Atomic rb_size_t* sequences,
+    rb_size_t capacity,
+    rb_size_t value_size,
+    unsigned flags
+)
+{
+    size_t data_size;
+    size_t sequences_size;
+    rb_size_t i;
+
+    ring_buffer_layout(
+        capacity,
+        value_size,
+        flags,
+        &rb->stride,
+        &rb->sequence_stride,
+        &data_size,
+        &sequences_size
+    );
+
+    atomic_init(&rb->magic, 0);
+    rb->version = RING_BUFFER_SHM_VERSION;
+    rb->header_size = sizeof(*rb);
+    rb->map_size = 0;
+    rb->data_offset = ring_buffer_offset_of(rb, data);
+    rb->sequences_offset = 0;
+    if (sequences) {
+        rb->sequences_offset = ring_buffer_offset_of(rb, sequences);
+        /* RING_BUFFER_OVERWRITE: written by the lap before the first one, so
+        consumers see them as "empty" and producers can take them. */
+        for (i = 0; i < capacity; ++i)
+            atomic_init(
+                &sequences[(size_t)i * rb->sequence_stride],
+                flags & RING_BUFFER_OVERWRITE
+                    ? (0u - capacity) | RING_BUFFER_SEQUENCE_WRITTEN
+                    : i
+            );
+    }
+
+    rb->value_size = value_size;
+    rb->capacity = capacity;
+    rb->flags = flags;
+    rb->cached_read = 0;
+    rb->cached_write = 0;
+    atomic_init(&rb->read, 0);
+    atomic_init(&rb->write, 0);
+    atomic_init(&rb->read_ahead, 0);
+    atomic_init(&rb->write_ahead, 0);
+    atomic_init(&rb->push_waiters, 0);
+    atomic_init(&rb->pop_waiters, 0);
+    atomic_init(&rb->read_event, 0);
+    atomic_init(&rb->write_event, 0);
+    atomic_init(&rb->dropped, 0);
+#ifdef CDATAUTILS_RING_BUFFER_STATS
+    memset(rb->stats, 0, sizeof(rb->stats));
+#endif
+}
+
 void
 ring_buffer_init(
     struct ring_buffer** restrict rb,
@@ -29,50 +1186,238 @@ ring_buffer_init(
     rb_size_t value_size
 )
 {
-    struct ring_buffer* _rb = malloc(sizeof(*_rb));
+    ring_buffer_init_flags(rb, capacity, value_size, RING_BUFFER_MPMC);
+}
+void
+ring_buffer_init_flags(
+    struct ring_buffer** restrict rb,
+    rb_size_t capacity,
+    rb_size_t value_size,
+    unsigned flags
+)
+{
+    size_t const line = CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE;
+    struct ring_buffer* _rb;
+    void* data = NULL;
+    _Atomic rb_size_t* sequences = NULL;
+    rb_size_t stride;
+    rb_size_t sequence_stride;
+    size_t data_size;
+    size_t sequences_size;
+
+    assert(capacity > 1);
+    assert(((capacity - 1) & capacity) == 0); // power of two
+    assert(!(flags & RING_BUFFER_SHARED));
+
+    ring_buffer_layout(
+        capacity,
+        value_size,
+        flags,
+        &stride,
+        &sequence_stride,
+        &data_size,
+        &sequences_size
+    );
+
+    if (flags & RING_BUFFER_DOUBLE_MAPPED) {
+        /* The mirror must start exactly at slot `capacity`. */
+        if ((size_t)capacity * stride % ring_buffer_os_page_size() == 0)
+            data = ring_buffer_os_map_mirrored(data_size);
+        if (data) {
+            flags &= ~(unsigned)(RING_BUFFER_INLINE_DATA | RING_BUFFER_HUGE_PAGES);
+            ring_buffer_os_bind(data, data_size, flags);
+        } else {
+            flags &= ~(unsigned)RING_BUFFER_DOUBLE_MAPPED;
+        }
+    }
+    if (!data && (flags & RING_BUFFER_PLACEMENT)) {
+        data = ring_buffer_os_map_pages(data_size + sequences_size, flags);
+        if (data) {
+            flags &= ~(unsigned)RING_BUFFER_INLINE_DATA;
+            if (sequences_size)
+                sequences = (_Atomic rb_size_t*)(void*)((char*)data + data_size);
+        } else {
+            flags &= ~(unsigned)RING_BUFFER_PLACEMENT;
+        }
+    }
+
+    if (flags & RING_BUFFER_INLINE_DATA) {
+        /* sizeof(struct ring_buffer) is a multiple of its (cache line) alignment. */
+        _rb = ring_buffer_os_aligned_alloc(
+            alignof(struct ring_buffer),
+            sizeof(*_rb) + data_size
+        );
+        assert(_rb);
+        data = _rb + 1;
+    } else {
+        _rb = ring_buffer_os_aligned_alloc(alignof(struct ring_buffer), sizeof(*_rb));
+        assert(_rb);
+        if (!data)
+            data = ring_buffer_os_aligned_alloc(line, data_size);
+        assert(data);
+    }
+    if (sequences_size && !sequences) {
+        sequences = ring_buffer_os_aligned_alloc(line, sequences_size);
+        assert(sequences);
+    }
+
+    ring_buffer_setup(_rb, data, sequences, capacity, value_size, flags);
+    if (flags & RING_BUFFER_PREFAULT) {
+        ring_buffer_os_prefault(data, data_size);
+        if (sequences_size)
+            ring_buffer_os_prefault(sequences, sequences_size);
+    }
+    ring_buffer_os_heavy_fence_init();
+
+    *rb = _rb;
+}
+bool
+ring_buffer_init_shm(
+    struct ring_buffer** restrict rb,
+    int fd,
+    rb_size_t capacity,
+    rb_size_t value_size,
+    unsigned flags
+)
+{
+    struct ring_buffer* _rb;
+    char* data;
+    rb_size_t stride;
+    rb_size_t sequence_stride;
+    size_t data_size;
+    size_t sequences_size;
+    size_t map_size;
 
-    assert(_rb);
     assert(capacity > 1);
     assert(((capacity - 1) & capacity) == 0); // power of two
+    assert(!(flags & RING_BUFFER_SHARED));
 
-    _rb->data = calloc(capacity, value_size);
-    assert(_rb->data);
+    /* Everything in one block: the header, then the slots, then the sequences.
+    (So no second mapping of the slots, and no huge pages.) */
+    flags &= ~(unsigned)(RING_BUFFER_DOUBLE_MAPPED | RING_BUFFER_HUGE_PAGES);
+    flags |= RING_BUFFER_SHARED | RING_BUFFER_INLINE_DATA;
+    ring_buffer_layout(
+        capacity,
+        value_size,
+        flags,
+        &stride,
+        &sequence_stride,
+        &data_size,
+        &sequences_size
+    );
+    map_size = sizeof(*_rb) + data_size + sequences_size;
+
+    _rb = ring_buffer_os_map_shared(fd, map_size, true);
+    if (!_rb)
+        return false;
+    data = (char*)(_rb + 1);
+    ring_buffer_os_bind(_rb, map_size, flags);
+    if (flags & RING_BUFFER_PREFAULT)
+        ring_buffer_os_prefault(_rb, map_size);
 
-    _rb->value_size = value_size;
-    _rb->capacity = capacity;
-    atomic_init(&_rb->read, 0);
-    atomic_init(&_rb->write, 0);
-    atomic_init(&_rb->read_ahead, 0);
-    atomic_init(&_rb->write_ahead, 0);
+    ring_buffer_setup(
+        _rb,
+        data,
+        sequences_size ? (_Atomic rb_size_t*)(void*)(data + data_size) : NULL,
+        capacity,
+        value_size,
+        flags
+    );
+    _rb->map_size = map_size;
+    atomic_store_explicit(&_rb->magic, RING_BUFFER_SHM_MAGIC, memory_order_release);
 
     *rb = _rb;
+    return true;
+}
+bool
+ring_buffer_attach_shm(struct ring_buffer** restrict rb, int fd)
+{
+    size_t const size = ring_buffer_os_shared_size(fd);
+    struct ring_buffer* _rb;
+
+    if (size < sizeof(*_rb))
+        return false;
+    _rb = ring_buffer_os_map_shared(fd, size, false);
+    if (!_rb)
+        return false;
+
+    if (atomic_load_explicit(&_rb->magic, memory_order_acquire) != RING_BUFFER_SHM_MAGIC
+        || _rb->version != RING_BUFFER_SHM_VERSION || _rb->header_size != sizeof(*_rb)
+        || _rb->map_size != size) {
+        ring_buffer_os_unmap_shared(_rb, size);
+        return false;
+    }
+
+    *rb = _rb;
+    return true;
 }
 
 void
 ring_buffer_destroy(struct ring_buffer* restrict rb)
 {
-    free(rb->data);
-    rb->data = NULL;
-    free(rb);
+    rb_size_t stride;
+    rb_size_t sequence_stride;
+    size_t data_size;
+    size_t sequences_size;
+
+    if (rb->flags & RING_BUFFER_SHARED) {
+        ring_buffer_os_unmap_shared(rb, (size_t)rb->map_size);
+        return;
+    }
+    if (rb->flags & RING_BUFFER_DOUBLE_MAPPED) {
+        ring_buffer_os_unmap_mirrored(
+            ring_buffer_data(rb),
+            (size_t)rb->capacity * rb->stride
+        );
+    } else if (rb->flags & RING_BUFFER_PLACEMENT) {
+        /* The sequences are in the same mapping. */
+        ring_buffer_layout(
+            rb->capacity,
+            rb->value_size,
+            rb->flags,
+            &stride,
+            &sequence_stride,
+            &data_size,
+            &sequences_size
+        );
+        ring_buffer_os_unmap_pages(
+            ring_buffer_data(rb),
+            data_size + sequences_size,
+            rb->flags
+        );
+        ring_buffer_os_aligned_free(rb);
+        return;
+    } else if (!(rb->flags & RING_BUFFER_INLINE_DATA)) {
+        ring_buffer_os_aligned_free(ring_buffer_data(rb));
+    }
+    if (rb->sequences_offset)
+        ring_buffer_os_aligned_free(ring_buffer_sequences(rb));
+    ring_buffer_os_aligned_free(rb);
 }
+internal
 bool
-ring_buffer_maybe_push(struct ring_buffer* restrict rb, void const* restrict item)
+ring_buffer_maybe_push_multi(struct ring_buffer* restrict rb, void const* restrict item)
 {
     rb_size_t const cap = rb->capacity;
     rb_size_t const value_size = rb->value_size;
+    size_t const stride = rb->stride;
     rb_size_t const cap_mask = cap - 1u;
-    char* const data = rb->data;
+    char* const data = ring_buffer_data(rb);
 
     rb_size_t wa = atomic_load_explicit(&rb->write_ahead, memory_order_acquire);
 
     /* If the buffer is "full", can't push. */
-    if (wa - atomic_load_explicit(&rb->read, memory_order_acquire) >= cap)
+    if (wa - atomic_load_explicit(&rb->read, memory_order_acquire) >= cap) {
+        ring_buffer_stat(rb, push_full, 1);
         return false;
+    }
 
     /* If there is someone writing behind us, we will have to spin on the write
     to WRITE, so just don't. */
-    if (atomic_load_explicit(&rb->write, memory_order_acquire) != wa)
+    if (atomic_load_explicit(&rb->write, memory_order_acquire) != wa) {
+        ring_buffer_stat(rb, push_busy, 1);
         return false;
+    }
 
     /* If someone stole our WRITE-AHEAD slot, we can't push.
     Otherwise, take the WRITE-AHEAD slot, as it guaranteed that we will not block.
@@ -83,24 +1428,42 @@ ring_buffer_maybe_push(struct ring_buffer* restrict rb, void const* restrict ite
             wa + 1,
             memory_order_acquire,
             memory_order_acquire
-        ))
+        )) {
+        ring_buffer_stat(rb, push_busy, 1);
         return false;
+    }
 
     /* Alright, (WRITE == WRITE-AHEAD) && (WRITE-AHEAD - READ < cap).
     We can finally read. */
-    memcpy(data + (wa & cap_mask) * (size_t)value_size, item, value_size);
+    memcpy(data + (wa & cap_mask) * stride, item, value_size);
 
     /* "Increment" WRITE. */
     atomic_store_explicit(&rb->write, wa + 1, memory_order_release);
+    ring_buffer_stat_pushed(rb, 1);
+    ring_buffer_notify_consumers(rb);
     return true;
 }
 bool
-ring_buffer_push(struct ring_buffer* restrict rb, void const* restrict item)
+ring_buffer_maybe_push(struct ring_buffer* restrict rb, void const* restrict item)
+{
+    if (rb->flags & RING_BUFFER_OVERWRITE)
+        return ring_buffer_push_overwrite(rb, item);
+    if (rb->flags & RING_BUFFER_SLOT_SEQUENCES)
+        return ring_buffer_push_slots(rb, item);
+    if (rb->flags & RING_BUFFER_SINGLE_PRODUCER)
+        return ring_buffer_push_single(rb, item);
+    return ring_buffer_maybe_push_multi(rb, item);
+}
+internal
+bool
+ring_buffer_push_multi(struct ring_buffer* restrict rb, void const* restrict item)
 {
     rb_size_t const cap = rb->capacity;
     rb_size_t const value_size = rb->value_size;
+    size_t const stride = rb->stride;
     rb_size_t const cap_mask = cap - 1u;
-    char* const data = rb->data;
+    char* const data = ring_buffer_data(rb);
+    unsigned spins = 0;
     rb_size_t wa;
 
     /* Initial WRITE-AHEAD. */
@@ -111,110 +1474,89 @@ ring_buffer_push(struct ring_buffer* restrict rb, void const* restrict item)
     */
     do {
         /* If the buffer is "full", can't push. */
-        if (wa - atomic_load_explicit(&rb->read, memory_order_acquire) >= cap)
+        if (wa - atomic_load_explicit(&rb->read, memory_order_acquire) >= cap) {
+            ring_buffer_stat(rb, push_full, 1);
             return false;
-    } while (!atomic_compare_exchange_weak_explicit(
-        &rb->write_ahead,
-        &wa,
-        wa + 1,
-        memory_order_acquire,
-        memory_order_acquire
+        }
+    } while (!ring_buffer_stat_cas(
+        rb,
+        push_cas_failures,
+        atomic_compare_exchange_weak_explicit(
+            &rb->write_ahead,
+            &wa,
+            wa + 1,
+            memory_order_acquire,
+            memory_order_acquire
+        )
     ));
     /* We've acquired a WRITE-AHEAD slot. */
 
     /* Actually write the item in the buffer. */
-    memcpy(data + (wa & cap_mask) * (size_t)value_size, item, value_size);
+    memcpy(data + (wa & cap_mask) * stride, item, value_size);
 
     /* When WRITE reaches our WRITE-AHEAD, set WRITE = WRITE-AHEAD + 1. */
     while (atomic_load_explicit(&rb->write, memory_order_acquire) != wa)
-        ;
+        ring_buffer_backoff(&spins);
+    ring_buffer_stat(rb, push_spins, spins);
     atomic_store_explicit(&rb->write, wa + 1, memory_order_release);
+    ring_buffer_stat_pushed(rb, 1);
+    ring_buffer_notify_consumers(rb);
     return true;
 }
+bool
+ring_buffer_push(struct ring_buffer* restrict rb, void const* restrict item)
+{
+    if (rb->flags & RING_BUFFER_OVERWRITE)
+        return ring_buffer_push_overwrite(rb, item);
+    if (rb->flags & RING_BUFFER_SLOT_SEQUENCES)
+        return ring_buffer_push_slots(rb, item);
+    if (rb->flags & RING_BUFFER_SINGLE_PRODUCER)
+        return ring_buffer_push_single(rb, item);
+    return ring_buffer_push_multi(rb, item);
+}
 void
 ring_buffer_deadlock_push(struct ring_buffer* restrict rb, void const* restrict item)
 {
-    rb_size_t const cap = rb->capacity;
-    rb_size_t const value_size = rb->value_size;
-    rb_size_t const cap_mask = cap - 1u;
-    char* const data = rb->data;
-
-    /* Initial WRITE-AHEAD. */
-    rb_size_t r;
-    rb_size_t wa = atomic_load_explicit(&rb->write_ahead, memory_order_acquire);
-
-    /* If someone stole our WRITE-AHEAD slot, we have to wait.
-    Otherwise, take the WRITE-AHEAD slot, as it guaranteed that we will not block.
-    */
-    do {
-        r = atomic_load_explicit(&rb->read, memory_order_acquire);
-        while (wa - r >= cap) {
-            /* If the buffer is "full", can't push. This is the potential DEADLOCK. */
-            wa = atomic_load_explicit(&rb->write_ahead, memory_order_acquire);
-            r = atomic_load_explicit(&rb->read, memory_order_acquire);
-        }
-    } while (!atomic_compare_exchange_weak_explicit(
-        &rb->write_ahead,
-        &wa,
-        wa + 1,
-        memory_order_acquire,
-        memory_order_acquire
-    ));
-    /* We've acquired a WRITE-AHEAD slot. */
-
-    /* Actually write the item in the buffer. */
-    memcpy(data + (wa & cap_mask) * (size_t)value_size, item, value_size);
-
-    /* When WRITE reaches our WRITE-AHEAD, set WRITE = WRITE-AHEAD + 1. */
-    while (atomic_load_explicit(&rb->write, memory_order_acquire) != wa)
-        ;
-    atomic_store_explicit(&rb->write, wa + 1, memory_order_release);
+    if (!ring_buffer_push(rb, item))
+        ring_buffer_block(rb, item, NULL, RING_BUFFER_WAIT_FOREVER);
+}
+bool
+ring_buffer_push_timeout(
+    struct ring_buffer* restrict rb,
+    void const* restrict item,
+    uint64_t timeout_ns
+)
+{
+    return ring_buffer_push(rb, item)
+           || ring_buffer_block(rb, item, NULL, timeout_ns);
 }
 
 void
 ring_buffer_deadlock_pop(struct ring_buffer* restrict rb, void* restrict out_item)
 {
-    rb_size_t const cap = rb->capacity;
-    rb_size_t const value_size = rb->value_size;
-    rb_size_t const cap_mask = cap - 1u;
-    char const* const data = rb->data;
-
-    rb_size_t w = atomic_load_explicit(&rb->write, memory_order_acquire);
-    rb_size_t ra = atomic_load_explicit(&rb->read_ahead, memory_order_acquire);
-
-    /* If someone stole our READ-AHEAD slot, we have to wait.
-    Otherwise, take the READ-AHEAD slot, as it guaranteed that we will not block.
-    */
-    do {
-        /* If the buffer is "empty", can't pop. This is the potential DEADLOCK. */
-        while (ra == w) {
-            ra = atomic_load_explicit(&rb->read_ahead, memory_order_acquire);
-            w = atomic_load_explicit(&rb->write, memory_order_acquire);
-        }
-    } while (!atomic_compare_exchange_weak_explicit(
-        &rb->read_ahead,
-        &ra,
-        ra + 1,
-        memory_order_acquire,
-        memory_order_acquire
-    ));
-    /* We've acquired a READ-AHEAD slot. */
-
-    /* Actually read the item. */
-    memcpy(out_item, data + (ra & cap_mask) * (size_t)value_size, value_size);
-
-    /* When READ reaches our READ-AHEAD, set READ = READ-AHEAD + 1. */
-    while (atomic_load_explicit(&rb->read, memory_order_acquire) != ra)
-        ;
-    atomic_store_explicit(&rb->read, ra + 1, memory_order_release);
+    if (!ring_buffer_pop(rb, out_item))
+        ring_buffer_block(rb, NULL, out_item, RING_BUFFER_WAIT_FOREVER);
 }
 bool
-ring_buffer_pop(struct ring_buffer* restrict rb, void* restrict out_item)
+ring_buffer_pop_timeout(
+    struct ring_buffer* restrict rb,
+    void* restrict out_item,
+    uint64_t timeout_ns
+)
+{
+    return ring_buffer_pop(rb, out_item)
+           || ring_buffer_block(rb, NULL, out_item, timeout_ns);
+}
+internal
+bool
+ring_buffer_pop_multi(struct ring_buffer* restrict rb, void* restrict out_item)
 {
     rb_size_t const cap = rb->capacity;
     rb_size_t const value_size = rb->value_size;
+    size_t const stride = rb->stride;
     rb_size_t const cap_mask = cap - 1u;
-    char const* const data = rb->data;
+    char const* const data = ring_buffer_data(rb);
+    unsigned spins = 0;
 
     /* Initial READ-AHEAD slot. */
     rb_size_t ra = atomic_load_explicit(&rb->read_ahead, memory_order_acquire);
@@ -224,43 +1566,69 @@ ring_buffer_pop(struct ring_buffer* restrict rb, void* restrict out_item)
     */
     do {
         /* If the buffer is "empty", can't pop. */
-        if (atomic_load_explicit(&rb->write, memory_order_acquire) == ra)
+        if (atomic_load_explicit(&rb->write, memory_order_acquire) == ra) {
+            ring_buffer_stat(rb, pop_empty, 1);
             return false;
-    } while (!atomic_compare_exchange_weak_explicit(
-        &rb->read_ahead,
-        &ra,
-        ra + 1,
-        memory_order_acquire,
-        memory_order_acquire
+        }
+    } while (!ring_buffer_stat_cas(
+        rb,
+        pop_cas_failures,
+        atomic_compare_exchange_weak_explicit(
+            &rb->read_ahead,
+            &ra,
+            ra + 1,
+            memory_order_acquire,
+            memory_order_acquire
+        )
     ));
     /* We've acquired a READ-AHEAD slot. */
 
     /* Actually read the item. */
-    memcpy(out_item, data + (ra & cap_mask) * (size_t)value_size, value_size);
+    memcpy(out_item, data + (ra & cap_mask) * stride, value_size);
 
     /* When READ reaches our READ-AHEAD, set READ = READ-AHEAD + 1. */
     while (atomic_load_explicit(&rb->read, memory_order_acquire) != ra)
-        ;
+        ring_buffer_backoff(&spins);
+    ring_buffer_stat(rb, pop_spins, spins);
     atomic_store_explicit(&rb->read, ra + 1, memory_order_release);
+    ring_buffer_stat(rb, pops, 1);
+    ring_buffer_notify_producers(rb);
     return true;
 }
 bool
-ring_buffer_maybe_pop(struct ring_buffer* restrict rb, void* restrict out_item)
+ring_buffer_pop(struct ring_buffer* restrict rb, void* restrict out_item)
+{
+    if (rb->flags & RING_BUFFER_OVERWRITE)
+        return ring_buffer_pop_overwrite(rb, out_item);
+    if (rb->flags & RING_BUFFER_SLOT_SEQUENCES)
+        return ring_buffer_pop_slots(rb, out_item);
+    if (rb->flags & RING_BUFFER_SINGLE_CONSUMER)
+        return ring_buffer_pop_single(rb, out_item);
+    return ring_buffer_pop_multi(rb, out_item);
+}
+internal
+bool
+ring_buffer_maybe_pop_multi(struct ring_buffer* restrict rb, void* restrict out_item)
 {
     rb_size_t const value_size = rb->value_size;
+    size_t const stride = rb->stride;
     rb_size_t const cap_mask = rb->capacity - 1u;
-    char const* const data = rb->data;
+    char const* const data = ring_buffer_data(rb);
 
     rb_size_t ra = atomic_load_explicit(&rb->read_ahead, memory_order_acquire);
 
     /* If the buffer is "empty", nothing to pop. */
-    if (atomic_load_explicit(&rb->write, memory_order_acquire) == ra)
+    if (atomic_load_explicit(&rb->write, memory_order_acquire) == ra) {
+        ring_buffer_stat(rb, pop_empty, 1);
         return false;
+    }
 
     /* If there is someone reading behind us, we will have to spin on the write
     to READ, so just don't. */
-    if (atomic_load_explicit(&rb->read, memory_order_acquire) != ra)
+    if (atomic_load_explicit(&rb->read, memory_order_acquire) != ra) {
+        ring_buffer_stat(rb, pop_busy, 1);
         return false;
+    }
 
     /* If someone managed to steal our READ-AHEAD slot, we can't pop.
     Otherwise, take the READ-AHEAD slot, as it guaranteed that we will not block.
@@ -271,19 +1639,224 @@ ring_buffer_maybe_pop(struct ring_buffer* restrict rb, void* restrict out_item)
             ra + 1,
             memory_order_acquire,
             memory_order_acquire
-        ))
+        )) {
+        ring_buffer_stat(rb, pop_busy, 1);
         return false;
+    }
 
     /* Alright, (READ == READ-AHEAD) && (READ-AHEAD != WRITE).
     We can finally read. */
 
-    memcpy(out_item, data + (ra & cap_mask) * (size_t)value_size, value_size);
+    memcpy(out_item, data + (ra & cap_mask) * stride, value_size);
 
     /* "Increment" READ. */
     atomic_store_explicit(&rb->read, ra + 1, memory_order_release);
+    ring_buffer_stat(rb, pops, 1);
+    ring_buffer_notify_producers(rb);
+
+    return true;
+}
+bool
+ring_buffer_maybe_pop(struct ring_buffer* restrict rb, void* restrict out_item)
+{
+    if (rb->flags & RING_BUFFER_OVERWRITE)
+        return ring_buffer_pop_overwrite(rb, out_item);
+    if (rb->flags & RING_BUFFER_SLOT_SEQUENCES)
+        return ring_buffer_pop_slots(rb, out_item);
+    if (rb->flags & RING_BUFFER_SINGLE_CONSUMER)
+        return ring_buffer_pop_single(rb, out_item);
+    return ring_buffer_maybe_pop_multi(rb, out_item);
+}
+
+rb_size_t
+ring_buffer_push_n(
+    struct ring_buffer* restrict rb,
+    void const* restrict items,
+    rb_size_t n_items
+)
+{
+    rb_size_t wa;
+    rb_size_t n;
+
+    if (n_items == 0)
+        return 0;
+
+    if (rb->flags & RING_BUFFER_OVERWRITE) {
+        /* Each item on its own seqlock. */
+        for (n = 0; n < n_items; ++n)
+            ring_buffer_push_overwrite(
+                rb,
+                (char const*)items + (size_t)n * rb->value_size
+            );
+        return n;
+    }
+
+    n = ring_buffer_claim_write(rb, 1, n_items, false, &wa);
+    if (n == 0)
+        return 0;
+
+    ring_buffer_copy_in(rb, wa, n, items);
+    ring_buffer_publish_write(rb, wa, n);
+    return n;
+}
+bool
+ring_buffer_push_n_exact(
+    struct ring_buffer* restrict rb,
+    void const* restrict items,
+    rb_size_t n_items
+)
+{
+    rb_size_t wa;
+
+    if (n_items == 0)
+        return true;
+    if (n_items > rb->capacity)
+        return false;
+
+    if (rb->flags & RING_BUFFER_OVERWRITE)
+        return ring_buffer_push_n(rb, items, n_items) == n_items;
+
+    if (!ring_buffer_claim_write(rb, n_items, n_items, false, &wa))
+        return false;
+
+    ring_buffer_copy_in(rb, wa, n_items, items);
+    ring_buffer_publish_write(rb, wa, n_items);
+    return true;
+}
+rb_size_t
+ring_buffer_pop_n(
+    struct ring_buffer* restrict rb,
+    void* restrict out_items,
+    rb_size_t n_items
+)
+{
+    rb_size_t ra;
+    rb_size_t n;
+
+    if (n_items == 0)
+        return 0;
+
+    if (rb->flags & RING_BUFFER_OVERWRITE) {
+        n = 0;
+        while (n < n_items
+               && ring_buffer_pop_overwrite(
+                   rb,
+                   (char*)out_items + (size_t)n * rb->value_size
+               ))
+            ++n;
+        return n;
+    }
+
+    n = ring_buffer_claim_read(rb, 1, n_items, false, &ra);
+    if (n == 0)
+        return 0;
 
+    ring_buffer_copy_out(rb, ra, n, out_items);
+    ring_buffer_publish_read(rb, ra, n);
+    return n;
+}
+bool
+ring_buffer_pop_n_exact(
+    struct ring_buffer* restrict rb,
+    void* restrict out_items,
+    rb_size_t n_items
+)
+{
+    rb_size_t ra;
+
+    if (n_items == 0)
+        return true;
+
+    if (!ring_buffer_claim_read(rb, n_items, n_items, false, &ra))
+        return false;
+
+    ring_buffer_copy_out(rb, ra, n_items, out_items);
+    ring_buffer_publish_read(rb, ra, n_items);
     return true;
 }
+rb_size_t
+ring_buffer_reserve_write(
+    struct ring_buffer* restrict rb,
+    rb_size_t n_items,
+    struct ring_buffer_span* restrict out_span
+)
+{
+    rb_size_t wa;
+    rb_size_t n;
+
+    out_span->data = NULL;
+    out_span->count = 0;
+    out_span->stride = rb->stride;
+
+    if (n_items == 0)
+        return 0;
+
+    /* Double-mapped slots are contiguous past the wrap point. */
+    n = ring_buffer_claim_write(
+        rb,
+        1,
+        n_items,
+        !(rb->flags & RING_BUFFER_DOUBLE_MAPPED),
+        &wa
+    );
+    if (n == 0)
+        return 0;
+
+    out_span->data = ring_buffer_slot(rb, wa);
+    out_span->count = n;
+    out_span->first = wa;
+    return n;
+}
+void
+ring_buffer_commit_write(
+    struct ring_buffer* restrict rb,
+    struct ring_buffer_span const* restrict span
+)
+{
+    if (span->count)
+        ring_buffer_publish_write(rb, span->first, span->count);
+}
+rb_size_t
+ring_buffer_peek_read(
+    struct ring_buffer* restrict rb,
+    rb_size_t n_items,
+    struct ring_buffer_span* restrict out_span
+)
+{
+    rb_size_t ra;
+    rb_size_t n;
+
+    out_span->data = NULL;
+    out_span->count = 0;
+    out_span->stride = rb->stride;
+
+    if (n_items == 0)
+        return 0;
+
+    n = ring_buffer_claim_read(
+        rb,
+        1,
+        n_items,
+        !(rb->flags & RING_BUFFER_DOUBLE_MAPPED),
+        &ra
+    );
+    if (n == 0)
+        return 0;
+
+    out_span->data = ring_buffer_slot(rb, ra);
+    out_span->count = n;
+    out_span->first = ra;
+    return n;
+}
+void
+ring_buffer_release_read(
+    struct ring_buffer* restrict rb,
+    struct ring_buffer_span const* restrict span
+)
+{
+    if (span->count)
+        ring_buffer_publish_read(rb, span->first, span->count);
+}
 
 rb_size_t
 ring_buffer_capacity(struct ring_buffer* restrict rb)
@@ -298,8 +1871,34 @@ ring_buffer_value_size(struct ring_buffer* restrict rb)
 void
 ring_buffer_clear(struct ring_buffer* restrict rb)
 {
+    unsigned spins = 0;
     rb_size_t w;
     rb_size_t ra;
+    rb_size_t n;
+
+    if (rb->flags & RING_BUFFER_OVERWRITE) {
+        /* Nothing to free, consumers skip whatever READ-AHEAD jumped over. */
+        atomic_store_explicit(
+            &rb->read_ahead,
+            atomic_load_explicit(&rb->write_ahead, memory_order_acquire),
+            memory_order_release
+        );
+        return;
+    }
+    if (rb->flags & RING_BUFFER_SLOT_SEQUENCES) {
+        /* No WRITE to jump to, free the slots that were pushed, run by run. */
+        while ((n = ring_buffer_claim_read_slots(rb, 1, rb->capacity, false, &ra)))
+            ring_buffer_publish_read(rb, ra, n);
+        return;
+    }
+    if (rb->flags & RING_BUFFER_SINGLE_CONSUMER) {
+        /* We are the consumer, nobody else can move READ. */
+        if (ring_buffer_claim_read_single(rb, 1, rb->capacity, false, &ra)) {
+            atomic_store_explicit(&rb->read, rb->cached_write, memory_order_release);
+            ring_buffer_notify_producers(rb);
+        }
+        return;
+    }
 
     ra = atomic_load_explicit(&rb->read_ahead, memory_order_acquire);
 
@@ -320,14 +1919,73 @@ ring_buffer_clear(struct ring_buffer* restrict rb)
 
     /* Wait for other consumers to finish their work. */
     while (atomic_load_explicit(&rb->read, memory_order_acquire) != ra)
-        ;
+        ring_buffer_backoff(&spins);
 
     /* "Increment" the write pointer to the target value (WRITE). */
     atomic_store_explicit(&rb->read, w, memory_order_release);
+    ring_buffer_notify_producers(rb);
 }
 rb_size_t
 ring_buffer_size(struct ring_buffer* restrict rb)
 {
-    return atomic_load_explicit(&rb->write, memory_order_acquire)
-           - atomic_load_explicit(&rb->read, memory_order_acquire);
+    rb_size_t r;
+    rb_size_t size;
+
+    /* READ(-AHEAD) first: WRITE(-AHEAD) is never behind it, and only grows. Loading
+    them the other way around, a pop in between could make the size "negative". */
+    if (rb->flags & (RING_BUFFER_SLOT_SEQUENCES | RING_BUFFER_OVERWRITE)) {
+        r = atomic_load_explicit(&rb->read_ahead, memory_order_acquire);
+        size = atomic_load_explicit(&rb->write_ahead, memory_order_acquire) - r;
+    } else {
+        r = atomic_load_explicit(&rb->read, memory_order_acquire);
+        size = atomic_load_explicit(&rb->write, memory_order_acquire) - r;
+    }
+
+    /* Pushes after our load of READ(-AHEAD) can make it look too big. */
+    return size < rb->capacity ? size : rb->capacity;
+}
+uint64_t
+ring_buffer_dropped(struct ring_buffer* restrict rb)
+{
+    return atomic_load_explicit(&rb->dropped, memory_order_relaxed);
+}
+void
+ring_buffer_stats_snapshot(
+    struct ring_buffer* restrict rb,
+    struct ring_buffer_stats* restrict out_stats
+)
+{
+#ifdef CDATAUTILS_RING_BUFFER_STATS
+    struct ring_buffer_stats_shard* shard;
+    rb_size_t high;
+    unsigned i;
+#endif
+
+    memset(out_stats, 0, sizeof(*out_stats));
+#ifdef CDATAUTILS_RING_BUFFER_STATS
+    for (i = 0; i < CDATAUTILS_RING_BUFFER_STATS_SHARDS; ++i) {
+        shard = &rb->stats[i];
+#define RING_BUFFER_STATS_SUM(counter) \
+    out_stats->counter += atomic_load_explicit(&shard->counter, memory_order_relaxed)
+        RING_BUFFER_STATS_SUM(pushes);
+        RING_BUFFER_STATS_SUM(pops);
+        RING_BUFFER_STATS_SUM(push_full);
+        RING_BUFFER_STATS_SUM(pop_empty);
+        RING_BUFFER_STATS_SUM(push_busy);
+        RING_BUFFER_STATS_SUM(pop_busy);
+        RING_BUFFER_STATS_SUM(push_cas_failures);
+        RING_BUFFER_STATS_SUM(pop_cas_failures);
+        RING_BUFFER_STATS_SUM(push_spins);
+        RING_BUFFER_STATS_SUM(pop_spins);
+        RING_BUFFER_STATS_SUM(push_sleeps);
+        RING_BUFFER_STATS_SUM(pop_sleeps);
+#undef RING_BUFFER_STATS_SUM
+
+        high = atomic_load_explicit(&shard->high_water_mark, memory_order_relaxed);
+        if (high > out_stats->high_water_mark)
+            out_stats->high_water_mark = high;
+    }
+#else
+    (void)rb;
+#endif
 }
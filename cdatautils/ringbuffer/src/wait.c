@@ -0,0 +1,544 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#elif !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "wait.h"
+
+#include <stdlib.h>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+void*
+ring_buffer_os_aligned_alloc(size_t alignment, size_t size)
+{
+    /* aligned_alloc wants a multiple of the alignment. */
+    size = (size + alignment - 1u) & ~(alignment - 1u);
+#ifdef _MSC_VER
+    return _aligned_malloc(size, alignment);
+#else
+    return aligned_alloc(alignment, size);
+#endif
+}
+void
+ring_buffer_os_aligned_free(void* memory)
+{
+#ifdef _MSC_VER
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+void
+ring_buffer_os_prefault(void* memory, size_t size)
+{
+    /* volatile, the compiler would happily drop stores of zeros to fresh memory. */
+    unsigned char volatile* const bytes = memory;
+    size_t const page = ring_buffer_os_page_size();
+    size_t i;
+
+    if (!size)
+        return;
+    for (i = 0; i < size; i += page)
+        bytes[i] = bytes[i];
+    bytes[size - 1u] = bytes[size - 1u];
+}
+
+#if defined(_WIN32)
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+/* WaitOnAddress only works inside a process, but there's no shared memory support
+on Windows anyway (ring_buffer_os_map_shared).
+*/
+void
+ring_buffer_os_wait(
+    _Atomic uint32_t* address,
+    uint32_t expected,
+    uint64_t timeout_ns,
+    bool shared
+)
+{
+    DWORD timeout_ms = INFINITE;
+    (void)shared;
+    if (timeout_ns != RING_BUFFER_WAIT_FOREVER) {
+        /* Rounded up, without overflowing for timeouts close to the maximum. */
+        uint64_t ms = timeout_ns / 1000000u + (timeout_ns % 1000000u != 0);
+        timeout_ms = ms >= INFINITE ? INFINITE - 1u : (DWORD)ms;
+    }
+    WaitOnAddress((volatile VOID*)address, &expected, sizeof(expected), timeout_ms);
+}
+void
+ring_buffer_os_wake_all(_Atomic uint32_t* address, bool shared)
+{
+    (void)shared;
+    WakeByAddressAll((PVOID)address);
+}
+_Atomic int ring_buffer_os_heavy_fence_ready = 1;
+void
+ring_buffer_os_heavy_fence_init(void)
+{
+}
+void
+ring_buffer_os_heavy_fence(void)
+{
+    FlushProcessWriteBuffers();
+}
+void
+ring_buffer_os_yield(void)
+{
+    SwitchToThread();
+}
+void*
+ring_buffer_os_map_shared(int fd, size_t size, bool create)
+{
+    (void)fd;
+    (void)size;
+    (void)create;
+    return NULL;
+}
+size_t
+ring_buffer_os_shared_size(int fd)
+{
+    (void)fd;
+    return 0;
+}
+void
+ring_buffer_os_unmap_shared(void* memory, size_t size)
+{
+    (void)memory;
+    (void)size;
+}
+size_t
+ring_buffer_os_page_size(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+}
+/* Possible with VirtualAlloc2 placeholders + MapViewOfFile3, not done yet. */
+void*
+ring_buffer_os_map_mirrored(size_t size)
+{
+    (void)size;
+    return NULL;
+}
+void
+ring_buffer_os_unmap_mirrored(void* memory, size_t size)
+{
+    (void)memory;
+    (void)size;
+}
+/* Large pages need SeLockMemoryPrivilege, and NUMA placement VirtualAllocExNuma,
+not done yet. */
+void*
+ring_buffer_os_map_pages(size_t size, unsigned flags)
+{
+    (void)size;
+    (void)flags;
+    return NULL;
+}
+void
+ring_buffer_os_unmap_pages(void* memory, size_t size, unsigned flags)
+{
+    (void)memory;
+    (void)size;
+    (void)flags;
+}
+void
+ring_buffer_os_bind(void* memory, size_t size, unsigned flags)
+{
+    (void)memory;
+    (void)size;
+    (void)flags;
+}
+uint64_t
+ring_buffer_os_now_ns(void)
+{
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)counter.QuadPart / (uint64_t)frequency.QuadPart * 1000000000u
+           + (uint64_t)counter.QuadPart % (uint64_t)frequency.QuadPart * 1000000000u
+                 / (uint64_t)frequency.QuadPart;
+}
+
+#else
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <linux/membarrier.h>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+
+void
+ring_buffer_os_wait(
+    _Atomic uint32_t* address,
+    uint32_t expected,
+    uint64_t timeout_ns,
+    bool shared
+)
+{
+    struct timespec timeout;
+    struct timespec* ptimeout = NULL;
+
+    if (timeout_ns != RING_BUFFER_WAIT_FOREVER) {
+        timeout.tv_sec = (time_t)(timeout_ns / 1000000000u);
+        timeout.tv_nsec = (long)(timeout_ns % 1000000000u);
+        ptimeout = &timeout;
+    }
+
+    /* EAGAIN (value already changed), EINTR and ETIMEDOUT all mean "go check". */
+    syscall(
+        SYS_futex,
+        address,
+        shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE,
+        expected,
+        ptimeout,
+        NULL,
+        0
+    );
+}
+void
+ring_buffer_os_wake_all(_Atomic uint32_t* address, bool shared)
+{
+    syscall(
+        SYS_futex,
+        address,
+        shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE,
+        INT32_MAX,
+        NULL,
+        NULL,
+        0
+    );
+}
+
+_Atomic int ring_buffer_os_heavy_fence_ready = 0;
+
+void
+ring_buffer_os_heavy_fence_init(void)
+{
+    if (atomic_load_explicit(&ring_buffer_os_heavy_fence_ready, memory_order_relaxed))
+        return;
+    /* Registering is idempotent, so racing threads may all do it. Fails on kernels
+    older than 4.14, and then the light fence stays a full fence. */
+    if (syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0)
+        atomic_store_explicit(
+            &ring_buffer_os_heavy_fence_ready,
+            1,
+            memory_order_relaxed
+        );
+}
+void
+ring_buffer_os_heavy_fence(void)
+{
+    if (!atomic_load_explicit(&ring_buffer_os_heavy_fence_ready, memory_order_relaxed)
+        || syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0) != 0)
+        atomic_thread_fence(memory_order_seq_cst);
+}
+
+#else
+#include <pthread.h>
+
+/* One condition variable for everyone. Waking is rare (only when someone is already
+asleep), so the occasional spurious wake-up of an unrelated waiter is cheap.
+*/
+static pthread_mutex_t ring_buffer_os_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ring_buffer_os_cond = PTHREAD_COND_INITIALIZER;
+
+/* The mutex can't reach other processes. Waiters on shared memory poll instead, a
+millisecond at a time.
+*/
+#define RING_BUFFER_OS_SHARED_POLL_NS 1000000u
+
+/* Longer timeouts wait "only" about 68 years: the deadline must not overflow. */
+#define RING_BUFFER_OS_MAX_TIMEOUT_NS ((uint64_t)INT32_MAX * 1000000000u)
+
+void
+ring_buffer_os_wait(
+    _Atomic uint32_t* address,
+    uint32_t expected,
+    uint64_t timeout_ns,
+    bool shared
+)
+{
+    struct timespec deadline;
+    uint64_t ns;
+
+    if (shared) {
+        ns = timeout_ns < RING_BUFFER_OS_SHARED_POLL_NS ? timeout_ns
+                                                        : RING_BUFFER_OS_SHARED_POLL_NS;
+        deadline.tv_sec = 0;
+        deadline.tv_nsec = (long)ns;
+        if (atomic_load_explicit(address, memory_order_acquire) == expected)
+            nanosleep(&deadline, NULL);
+        return;
+    }
+    if (timeout_ns != RING_BUFFER_WAIT_FOREVER) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        ns = timeout_ns < RING_BUFFER_OS_MAX_TIMEOUT_NS ? timeout_ns
+                                                        : RING_BUFFER_OS_MAX_TIMEOUT_NS;
+        ns += (uint64_t)deadline.tv_nsec;
+        deadline.tv_sec += (time_t)(ns / 1000000000u);
+        deadline.tv_nsec = (long)(ns % 1000000000u);
+    }
+
+    pthread_mutex_lock(&ring_buffer_os_mutex);
+    if (atomic_load_explicit(address, memory_order_acquire) == expected) {
+        if (timeout_ns == RING_BUFFER_WAIT_FOREVER)
+            pthread_cond_wait(&ring_buffer_os_cond, &ring_buffer_os_mutex);
+        else
+            pthread_cond_timedwait(
+                &ring_buffer_os_cond,
+                &ring_buffer_os_mutex,
+                &deadline
+            );
+    }
+    pthread_mutex_unlock(&ring_buffer_os_mutex);
+}
+void
+ring_buffer_os_wake_all(_Atomic uint32_t* address, bool shared)
+{
+    (void)address;
+    if (shared)
+        return;
+    pthread_mutex_lock(&ring_buffer_os_mutex);
+    pthread_cond_broadcast(&ring_buffer_os_cond);
+    pthread_mutex_unlock(&ring_buffer_os_mutex);
+}
+
+_Atomic int ring_buffer_os_heavy_fence_ready = 0;
+
+void
+ring_buffer_os_heavy_fence_init(void)
+{
+}
+void
+ring_buffer_os_heavy_fence(void)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+#endif
+
+void
+ring_buffer_os_yield(void)
+{
+    sched_yield();
+}
+void*
+ring_buffer_os_map_shared(int fd, size_t size, bool create)
+{
+    void* memory;
+
+    if (create && ftruncate(fd, (off_t)size) != 0)
+        return NULL;
+    memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+size_t
+ring_buffer_os_shared_size(int fd)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size < 0)
+        return 0;
+    return (size_t)st.st_size;
+}
+void
+ring_buffer_os_unmap_shared(void* memory, size_t size)
+{
+    munmap(memory, size);
+}
+size_t
+ring_buffer_os_page_size(void)
+{
+    long const size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : 4096u;
+}
+#if defined(__linux__)
+void*
+ring_buffer_os_map_mirrored(size_t size)
+{
+    int const fd = memfd_create("cdatautils-ringbuffer", MFD_CLOEXEC);
+    char* memory = MAP_FAILED;
+    bool mapped = false;
+
+    if (fd < 0)
+        return NULL;
+
+    /* Reserve both halves first, so that nothing else can be mapped in between. */
+    if (ftruncate(fd, (off_t)size) == 0)
+        memory = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory != MAP_FAILED)
+        mapped =
+            mmap(memory, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0)
+                != MAP_FAILED
+            && mmap(
+                   memory + size,
+                   size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_FIXED,
+                   fd,
+                   0
+               ) != MAP_FAILED;
+    /* The mappings keep the memory alive. */
+    close(fd);
+
+    if (!mapped) {
+        if (memory != MAP_FAILED)
+            munmap(memory, size * 2);
+        return NULL;
+    }
+    return memory;
+}
+#else
+void*
+ring_buffer_os_map_mirrored(size_t size)
+{
+    (void)size;
+    return NULL;
+}
+#endif
+void
+ring_buffer_os_unmap_mirrored(void* memory, size_t size)
+{
+    munmap(memory, size * 2);
+}
+#if defined(__linux__)
+/* The size of the mapping of ring_buffer_os_map_pages(size, flags). */
+static size_t
+ring_buffer_os_pages_size(size_t size, unsigned flags)
+{
+    size_t const page = flags & RING_BUFFER_HUGE_PAGES ? RING_BUFFER_OS_HUGE_PAGE_SIZE
+                                                       : ring_buffer_os_page_size();
+
+    return (size + page - 1u) & ~(page - 1u);
+}
+void*
+ring_buffer_os_map_pages(size_t size, unsigned flags)
+{
+    size_t const huge = RING_BUFFER_OS_HUGE_PAGE_SIZE;
+    char* memory = MAP_FAILED;
+    size_t head;
+
+    size = ring_buffer_os_pages_size(size, flags);
+    if (!(flags & RING_BUFFER_HUGE_PAGES)) {
+        memory = mmap(
+            NULL,
+            size,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0
+        );
+        if (memory == MAP_FAILED)
+            return NULL;
+        ring_buffer_os_bind(memory, size, flags);
+        return memory;
+    }
+
+#ifdef MAP_HUGETLB
+    memory = mmap(
+        NULL,
+        size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+        -1,
+        0
+    );
+#endif
+    if (memory == MAP_FAILED) {
+        /* No reserved huge pages: a 2 MB aligned mapping that transparent huge
+        pages can back. Map one huge page more, and trim both ends. */
+        memory = mmap(
+            NULL,
+            size + huge,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0
+        );
+        if (memory == MAP_FAILED)
+            return NULL;
+        head = (huge - (uintptr_t)memory % huge) % huge;
+        if (head)
+            munmap(memory, head);
+        munmap(memory + head + size, huge - head);
+        memory += head;
+#ifdef MADV_HUGEPAGE
+        madvise(memory, size, MADV_HUGEPAGE);
+#endif
+    }
+    ring_buffer_os_bind(memory, size, flags);
+    return memory;
+}
+void
+ring_buffer_os_unmap_pages(void* memory, size_t size, unsigned flags)
+{
+    munmap(memory, ring_buffer_os_pages_size(size, flags));
+}
+void
+ring_buffer_os_bind(void* memory, size_t size, unsigned flags)
+{
+    unsigned long const node = (flags & RING_BUFFER_NUMA_NODE_MASK) >> 24;
+    unsigned long mask;
+    int mode;
+
+    if (flags & RING_BUFFER_NUMA_INTERLEAVE) {
+        mode = MPOL_INTERLEAVE;
+        mask = ~0ul;
+    } else if (node) {
+        mode = MPOL_BIND;
+        mask = 1ul << (node - 1u);
+    } else {
+        return;
+    }
+
+    /* No libnuma, the raw syscall. It takes the number of bits of the mask plus
+    one (historical). Errors (no NUMA, offline node) leave the default policy. */
+    syscall(SYS_mbind, memory, size, mode, &mask, sizeof(mask) * 8u + 1u, 0u);
+}
+#else
+void*
+ring_buffer_os_map_pages(size_t size, unsigned flags)
+{
+    (void)size;
+    (void)flags;
+    return NULL;
+}
+void
+ring_buffer_os_unmap_pages(void* memory, size_t size, unsigned flags)
+{
+    (void)memory;
+    (void)size;
+    (void)flags;
+}
+void
+ring_buffer_os_bind(void* memory, size_t size, unsigned flags)
+{
+    (void)memory;
+    (void)size;
+    (void)flags;
+}
+#endif
+uint64_t
+ring_buffer_os_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef CDATAUTILS_RING_BUFFER_WAIT_H
+#define CDATAUTILS_RING_BUFFER_WAIT_H
+
+/* OS-specific waiting (and memory) primitives used by ringbuffer.c and the queues
+built next to it (bytering.c, workdeque.c, lanering.c, broadcastring.c).
+Internal, not installed.
+
+    - Linux: futex.
+    - Windows: WaitOnAddress/WakeByAddressAll.
+    - Everything else: a process-wide pthread mutex + condition variable.
+*/
+
+#include <cdatautils/ringbuffer.h>
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Pass as `timeout_ns` to wait without a timeout. */
+#define RING_BUFFER_WAIT_FOREVER UINT64_MAX
+
+/* Sleeps while `*address == expected`, for at most `timeout_ns`.
+
+`shared` if `address` is in memory shared with other processes (the waker may be
+in another process).
+
+May return early (spuriously), the caller is expected to re-check its condition.
+*/
+void ring_buffer_os_wait(
+    _Atomic uint32_t* address,
+    uint32_t expected,
+    uint64_t timeout_ns,
+    bool shared
+);
+
+/* Wakes all threads sleeping in ring_buffer_os_wait on `address`. */
+void ring_buffer_os_wake_all(_Atomic uint32_t* address, bool shared);
+
+/* Gives the rest of the time slice to another thread. */
+void ring_buffer_os_yield(void);
+
+/* Monotonic clock, in nanoseconds. */
+uint64_t ring_buffer_os_now_ns(void);
+
+/* A pair of asymmetric fences, that together act as two seq_cst fences.
+
+The fast side (every push/pop) calls ring_buffer_light_fence, the slow side (a
+thread about to sleep) calls ring_buffer_os_heavy_fence. Where the OS can make
+the heavy fence run a barrier on all threads of the process (membarrier on Linux,
+FlushProcessWriteBuffers on Windows), the light fence is only a compiler barrier.
+Otherwise both are plain seq_cst fences.
+
+ring_buffer_os_heavy_fence_init must be called before the buffer is shared (it is
+cheap after the first call). A thread that saw the light fence as a full fence
+is still correctly paired with any later heavy fence.
+*/
+extern _Atomic int ring_buffer_os_heavy_fence_ready;
+void ring_buffer_os_heavy_fence_init(void);
+void ring_buffer_os_heavy_fence(void);
+
+static inline void
+ring_buffer_light_fence(void)
+{
+    if (atomic_load_explicit(&ring_buffer_os_heavy_fence_ready, memory_order_relaxed))
+        atomic_signal_fence(memory_order_seq_cst);
+    else
+        atomic_thread_fence(memory_order_seq_cst);
+}
+
+/* `alignment`-aligned memory, `alignment` must be a power of two.
+Must be freed with ring_buffer_os_aligned_free.
+*/
+void* ring_buffer_os_aligned_alloc(size_t alignment, size_t size);
+void ring_buffer_os_aligned_free(void* memory);
+
+/* Resizes the shared memory object `fd` to `size` bytes if `create` is set, then
+maps all of it, shared, read-write.
+Returns NULL on failure (or on platforms without mmap).
+*/
+void* ring_buffer_os_map_shared(int fd, size_t size, bool create);
+/* Returns the size of the shared memory object `fd`, 0 on failure. */
+size_t ring_buffer_os_shared_size(int fd);
+void ring_buffer_os_unmap_shared(void* memory, size_t size);
+
+/* The size of a page of virtual memory. */
+size_t ring_buffer_os_page_size(void);
+/* Maps `size` bytes (a multiple of the page size) twice, back to back: byte
+`size + i` is the same memory as byte `i`. Returns the start of the first copy.
+Returns NULL on failure (or where it isn't supported - only Linux for now).
+*/
+void* ring_buffer_os_map_mirrored(size_t size);
+void ring_buffer_os_unmap_mirrored(void* memory, size_t size);
+
+/* The size of a huge page, for RING_BUFFER_HUGE_PAGES. */
+#define RING_BUFFER_OS_HUGE_PAGE_SIZE ((size_t)2 << 20)
+/* Maps `size` bytes of private, zeroed memory, placed as asked by the
+RING_BUFFER_HUGE_PAGES and RING_BUFFER_NUMA_* bits of `flags` (see
+ring_buffer_os_bind). `size` is rounded up to a page, or to a huge page.
+Returns NULL on failure (or on platforms without mmap).
+Must be unmapped with ring_buffer_os_unmap_pages, with the same `size` and `flags`.
+*/
+void* ring_buffer_os_map_pages(size_t size, unsigned flags);
+void ring_buffer_os_unmap_pages(void* memory, size_t size, unsigned flags);
+/* Applies the RING_BUFFER_NUMA_* bits of `flags` to the pages of `memory` (page
+aligned), before they are touched. Best effort, does nothing where NUMA policies
+aren't supported.
+*/
+void ring_buffer_os_bind(void* memory, size_t size, unsigned flags);
+/* Writes to every page of `memory`, so that they are all faulted in now. */
+void ring_buffer_os_prefault(void* memory, size_t size);
+
+/* Tells the CPU we're spinning. */
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define ring_buffer_cpu_relax() _mm_pause()
+#elif defined(_MSC_VER) && (defined(_M_ARM64) || defined(_M_ARM))
+#include <intrin.h>
+#define ring_buffer_cpu_relax() __yield()
+#elif defined(__x86_64__) || defined(__i386__)
+#define ring_buffer_cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define ring_buffer_cpu_relax() __asm__ __volatile__("yield")
+#else
+#define ring_buffer_cpu_relax() ((void)0)
+#endif
+
+/* Waiting for another producer/consumer to move WRITE/READ (commit order).
+They are in the middle of a push/pop, so this is usually short - spin for a bit,
+but if they got preempted, give them our time slice.
+*/
+static inline void
+ring_buffer_backoff(unsigned* spins)
+{
+    if (++*spins < CDATAUTILS_RING_BUFFER_SPIN_COUNT)
+        ring_buffer_cpu_relax();
+    else
+        ring_buffer_os_yield();
+}
+
+#endif
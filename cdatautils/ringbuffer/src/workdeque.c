@@ -0,0 +1,229 @@
+#include <cdatautils/workdeque.h>
+
+#include "wait.h"
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define internal static
+
+#ifdef CDATAUTILS_RINGBUFFER_USE_ASSERT
+#include <assert.h>
+#else
+#define assert(...) (void)(__VA_ARGS__)
+#endif
+
+/* The slots of a work_deque, right after this header (in the same allocation). */
+struct work_deque_storage
+{
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE) rb_size_t capacity;
+    /* The storage this one replaced, freed by work_deque_destroy. */
+    struct work_deque_storage* previous;
+};
+
+struct work_deque
+{
+    rb_size_t value_size;
+    /* Thieves claim items here, with a CAS. */
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t top;
+    /* Only written by the owner. */
+    alignas(CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE * 2) _Atomic rb_size_t bottom;
+    _Atomic(struct work_deque_storage*) storage;
+};
+
+/* sizeof(struct work_deque_storage) is a multiple of its (cache line) alignment,
+so the slots are aligned too.
+*/
+internal
+struct work_deque_storage*
+work_deque_storage_alloc(
+    rb_size_t capacity,
+    rb_size_t value_size,
+    struct work_deque_storage* previous
+)
+{
+    struct work_deque_storage* storage = ring_buffer_os_aligned_alloc(
+        alignof(struct work_deque_storage),
+        sizeof(*storage) + (size_t)capacity * value_size
+    );
+    assert(storage);
+    storage->capacity = capacity;
+    storage->previous = previous;
+    return storage;
+}
+/* Returns the slot of the item at `index`. */
+internal
+unsigned char*
+work_deque_slot(
+    struct work_deque_storage* restrict storage,
+    rb_size_t value_size,
+    rb_size_t index
+)
+{
+    return (unsigned char*)(storage + 1)
+           + (size_t)(index & (storage->capacity - 1u)) * value_size;
+}
+
+/* Replaces the full `storage` with one twice as big, holding the items from `t` to
+`b` (excluded). Owner only.
+*/
+internal
+struct work_deque_storage*
+work_deque_grow(
+    struct work_deque* restrict dq,
+    struct work_deque_storage* storage,
+    rb_size_t t,
+    rb_size_t b
+)
+{
+    rb_size_t const value_size = dq->value_size;
+    struct work_deque_storage* grown =
+        work_deque_storage_alloc(storage->capacity * 2u, value_size, storage);
+    rb_size_t i;
+
+    for (i = t; i != b; ++i)
+        memcpy(
+            work_deque_slot(grown, value_size, i),
+            work_deque_slot(storage, value_size, i),
+            value_size
+        );
+
+    /* Thieves that loaded the old storage still read valid items from it: its
+    slots are never written again. */
+    atomic_store_explicit(&dq->storage, grown, memory_order_release);
+    return grown;
+}
+
+void
+work_deque_init(
+    struct work_deque** restrict dq,
+    rb_size_t capacity,
+    rb_size_t value_size
+)
+{
+    struct work_deque* _dq;
+
+    assert(capacity > 1);
+    assert(((capacity - 1) & capacity) == 0); // power of two
+
+    _dq = ring_buffer_os_aligned_alloc(alignof(struct work_deque), sizeof(*_dq));
+    assert(_dq);
+
+    _dq->value_size = value_size;
+    atomic_init(&_dq->top, 0);
+    atomic_init(&_dq->bottom, 0);
+    atomic_init(&_dq->storage, work_deque_storage_alloc(capacity, value_size, NULL));
+
+    *dq = _dq;
+}
+void
+work_deque_destroy(struct work_deque* restrict dq)
+{
+    struct work_deque_storage* storage =
+        atomic_load_explicit(&dq->storage, memory_order_relaxed);
+    struct work_deque_storage* previous;
+
+    while (storage) {
+        previous = storage->previous;
+        ring_buffer_os_aligned_free(storage);
+        storage = previous;
+    }
+    ring_buffer_os_aligned_free(dq);
+}
+
+void
+work_deque_push(struct work_deque* restrict dq, void const* restrict item)
+{
+    rb_size_t const b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+    rb_size_t const t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    struct work_deque_storage* storage =
+        atomic_load_explicit(&dq->storage, memory_order_relaxed);
+
+    if (b - t >= storage->capacity)
+        storage = work_deque_grow(dq, storage, t, b);
+
+    memcpy(work_deque_slot(storage, dq->value_size, b), item, dq->value_size);
+    /* The item (and the storage) before BOTTOM. */
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&dq->bottom, b + 1u, memory_order_relaxed);
+}
+bool
+work_deque_pop(struct work_deque* restrict dq, void* restrict out_item)
+{
+    rb_size_t const b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1u;
+    struct work_deque_storage* const storage =
+        atomic_load_explicit(&dq->storage, memory_order_relaxed);
+    rb_size_t t;
+    bool popped = true;
+
+    /* Take the item first, then look at TOP: a thief either sees the new BOTTOM and
+    leaves the item alone, or we see its TOP. */
+    atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+
+    /* If the deque is "empty", can't pop. */
+    if ((rb_ssize_t)(b - t) < 0) {
+        atomic_store_explicit(&dq->bottom, b + 1u, memory_order_relaxed);
+        return false;
+    }
+
+    memcpy(out_item, work_deque_slot(storage, dq->value_size, b), dq->value_size);
+
+    /* The last item: race the thieves for it, on TOP. */
+    if (t == b) {
+        popped = atomic_compare_exchange_strong_explicit(
+            &dq->top,
+            &t,
+            t + 1u,
+            memory_order_seq_cst,
+            memory_order_relaxed
+        );
+        atomic_store_explicit(&dq->bottom, b + 1u, memory_order_relaxed);
+    }
+    return popped;
+}
+bool
+work_deque_steal(struct work_deque* restrict dq, void* restrict out_item)
+{
+    rb_size_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    struct work_deque_storage* storage;
+    rb_size_t b;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+
+    /* If the deque is "empty", can't steal. */
+    if ((rb_ssize_t)(b - t) <= 0)
+        return false;
+
+    /* The copy may race with the owner only if the slot was reused for a later
+    item, and then TOP has moved and the CAS fails: the copy is thrown away. */
+    storage = atomic_load_explicit(&dq->storage, memory_order_acquire);
+    memcpy(out_item, work_deque_slot(storage, dq->value_size, t), dq->value_size);
+
+    return atomic_compare_exchange_strong_explicit(
+        &dq->top,
+        &t,
+        t + 1u,
+        memory_order_seq_cst,
+        memory_order_relaxed
+    );
+}
+
+rb_size_t
+work_deque_size(struct work_deque* restrict dq)
+{
+    rb_size_t const t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    rb_size_t const b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+
+    /* A pop in progress can briefly put BOTTOM below TOP. */
+    return (rb_ssize_t)(b - t) > 0 ? b - t : 0;
+}
+rb_size_t
+work_deque_capacity(struct work_deque* restrict dq)
+{
+    return atomic_load_explicit(&dq->storage, memory_order_relaxed)->capacity;
+}
@@ -0,0 +1,219 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cdatautils/broadcastring.h>
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/* Necessary wrappers so that Catch2 correctly calls destructors.
+ */
+
+struct broadcast_ring_deleter
+{
+    void
+    operator()(broadcast_ring* br)
+    {
+        broadcast_ring_destroy(br);
+    }
+};
+struct broadcast_ring_wrapper
+{
+    broadcast_ring_wrapper(rb_size_t capacity, rb_size_t max_readers, unsigned flags)
+    {
+        broadcast_ring* br = 0;
+        broadcast_ring_init(&br, capacity, sizeof(int), max_readers, flags);
+        _br.reset(br);
+    }
+
+    std::optional<rb_size_t>
+    subscribe()
+    {
+        rb_size_t reader;
+        if (broadcast_ring_subscribe(_br.get(), &reader))
+            return reader;
+        else
+            return {};
+    }
+
+    bool
+    push(int item)
+    {
+        return broadcast_ring_push(_br.get(), &item);
+    }
+
+    /* Returns -1 if there was nothing to pop. */
+    int
+    pop(rb_size_t reader, rb_size_t* out_missed = nullptr)
+    {
+        int item;
+        if (broadcast_ring_pop(_br.get(), reader, &item, out_missed))
+            return item;
+        else
+            return -1;
+    }
+
+    broadcast_ring*
+    get()
+    {
+        return _br.get();
+    }
+
+private:
+    std::unique_ptr<broadcast_ring, broadcast_ring_deleter> _br;
+};
+
+TEST_CASE("broadcast ring", "[broadcast_ring]")
+{
+    broadcast_ring_wrapper br(4, 2, 0);
+
+    GIVEN("a buffer without readers")
+    {
+        THEN("pushes always succeed, nobody is behind")
+        {
+            for (int i = 0; i < 10; ++i)
+                REQUIRE(br.push(i));
+        }
+        THEN("at most max_readers can subscribe")
+        {
+            REQUIRE(br.subscribe() == 0u);
+            REQUIRE(br.subscribe() == 1u);
+            REQUIRE(br.subscribe() == std::nullopt);
+            broadcast_ring_unsubscribe(br.get(), 0);
+            REQUIRE(br.subscribe() == 0u);
+        }
+    }
+    GIVEN("two readers")
+    {
+        rb_size_t a = *br.subscribe();
+        rb_size_t b = *br.subscribe();
+        REQUIRE(br.pop(a) == -1);
+
+        WHEN("items are pushed")
+        {
+            REQUIRE(br.push(1));
+            REQUIRE(br.push(2));
+
+            THEN("each reader sees all of them, in order")
+            {
+                REQUIRE(broadcast_ring_size(br.get(), a) == 2);
+                REQUIRE(br.pop(a) == 1);
+                REQUIRE(br.pop(a) == 2);
+                REQUIRE(br.pop(a) == -1);
+                REQUIRE(br.pop(b) == 1);
+                REQUIRE(br.pop(b) == 2);
+                REQUIRE(br.pop(b) == -1);
+            }
+        }
+        WHEN("one reader is a whole buffer behind")
+        {
+            for (int i = 0; i < 4; ++i) {
+                REQUIRE(br.push(i));
+                REQUIRE(br.pop(a) == i);
+            }
+
+            THEN("producers wait for it")
+            {
+                REQUIRE(br.push(4) == false);
+                REQUIRE(br.pop(b) == 0);
+                REQUIRE(br.push(4) == true);
+                REQUIRE(br.push(5) == false);
+            }
+            THEN("producers stop waiting for it once it unsubscribes")
+            {
+                broadcast_ring_unsubscribe(br.get(), b);
+                REQUIRE(br.push(4) == true);
+                REQUIRE(br.pop(a) == 4);
+            }
+        }
+        WHEN("a reader subscribes later")
+        {
+            REQUIRE(br.push(1));
+            broadcast_ring_unsubscribe(br.get(), b);
+            b = *br.subscribe();
+            REQUIRE(br.push(2));
+
+            THEN("it only sees the items pushed after")
+            {
+                REQUIRE(br.pop(b) == 2);
+                REQUIRE(br.pop(b) == -1);
+            }
+        }
+    }
+}
+
+TEST_CASE("broadcast ring lossy", "[broadcast_ring]")
+{
+    broadcast_ring_wrapper br(4, 2, BROADCAST_RING_LOSSY);
+    rb_size_t reader = *br.subscribe();
+    rb_size_t missed = 100;
+
+    THEN("pushes never fail, and a lapped reader is told what it missed")
+    {
+        for (int i = 0; i < 10; ++i)
+            REQUIRE(br.push(i));
+
+        REQUIRE(broadcast_ring_size(br.get(), reader) == 4);
+        REQUIRE(br.pop(reader, &missed) == 6);
+        REQUIRE(missed == 6);
+        REQUIRE(br.pop(reader, &missed) == 7);
+        REQUIRE(missed == 0);
+    }
+    THEN("a reader that keeps up misses nothing")
+    {
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE(br.push(i));
+            REQUIRE(br.pop(reader, &missed) == i);
+            REQUIRE(missed == 0);
+        }
+    }
+}
+
+TEST_CASE("broadcast ring readers", "[broadcast_ring][threads]")
+{
+    unsigned flags = 0;
+    SECTION("gated") { flags = 0; }
+    SECTION("BROADCAST_RING_LOSSY") { flags = BROADCAST_RING_LOSSY; }
+
+    constexpr int c = 3;
+    constexpr int n = 100'000;
+    broadcast_ring_wrapper br(64, c, flags);
+    std::atomic_int bad = 0;
+
+    std::vector<rb_size_t> readers;
+    for (int i = 0; i < c; ++i)
+        readers.push_back(*br.subscribe());
+
+    // Every reader gets 0, 1, 2... minus what it missed (nothing, if gated). The
+    // last item is never overwritten, so they all get to it.
+    auto reader = [&br, &bad, flags](rb_size_t id) {
+        int expected = 0;
+        while (expected < n) {
+            rb_size_t missed;
+            int item = br.pop(id, &missed);
+            if (item == -1) {
+                std::this_thread::yield();
+                continue;
+            }
+            bad += item != expected + (int)missed;
+            bad += !(flags & BROADCAST_RING_LOSSY) && missed != 0;
+            expected = item + 1;
+        }
+    };
+
+    std::thread threads[c];
+    for (int i = 0; i < c; ++i)
+        threads[i] = std::thread(reader, readers[(size_t)i]);
+
+    for (int i = 0; i < n; ++i) {
+        while (!br.push(i))
+            std::this_thread::yield();
+    }
+
+    for (int i = 0; i < c; ++i)
+        threads[i].join();
+
+    REQUIRE(bad == 0);
+}
@@ -0,0 +1,297 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cdatautils/bytering.h>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Necessary wrappers so that Catch2 correctly calls destructors.
+ */
+
+struct byte_ring_deleter
+{
+    void
+    operator()(byte_ring* rb)
+    {
+        byte_ring_destroy(rb);
+    }
+};
+struct byte_ring_wrapper
+{
+    byte_ring_wrapper(rb_size_t capacity)
+    {
+        byte_ring* rb = 0;
+        byte_ring_init(&rb, capacity);
+        _rb.reset(rb);
+    }
+
+    bool
+    push(std::string const& record)
+    {
+        return byte_ring_push(_rb.get(), record.data(), (rb_size_t)record.size());
+    }
+
+    /* Returns "<empty>" if there was nothing to pop. */
+    std::string
+    pop()
+    {
+        char buffer[1024];
+        rb_size_t size;
+        if (!byte_ring_pop(_rb.get(), buffer, sizeof(buffer), &size))
+            return "<empty>";
+        return std::string(buffer, size);
+    }
+
+    std::vector<std::string>
+    drain(rb_size_t max_records)
+    {
+        std::vector<std::string> records;
+        byte_ring_drain(
+            _rb.get(),
+            [](void* user, void const* data, rb_size_t size) {
+                ((std::vector<std::string>*)user)
+                    ->emplace_back((char const*)data, size);
+            },
+            &records,
+            max_records
+        );
+        return records;
+    }
+
+    byte_ring*
+    get()
+    {
+        return _rb.get();
+    }
+
+private:
+    std::unique_ptr<byte_ring, byte_ring_deleter> _rb;
+};
+
+TEST_CASE("byte ring", "[byte_ring]")
+{
+    byte_ring_wrapper rb(64);
+
+    GIVEN("just-initialized ring of 64 bytes")
+    {
+        REQUIRE(byte_ring_capacity(rb.get()) == 64);
+        REQUIRE(byte_ring_max_record_size(rb.get()) == 24);
+
+        THEN("the ring is empty")
+        {
+            REQUIRE(byte_ring_size(rb.get()) == 0);
+            REQUIRE(rb.pop() == "<empty>");
+        }
+        THEN("records bigger than the max record size can't be pushed")
+        {
+            REQUIRE(rb.push(std::string(25, 'x')) == false);
+            REQUIRE(rb.push(std::string(24, 'x')) == true);
+        }
+        WHEN("records of different sizes are pushed")
+        {
+            REQUIRE(rb.push("a") == true);
+            REQUIRE(rb.push("") == true);
+            REQUIRE(rb.push("0123456789abcdef") == true);
+
+            THEN("they take their size, padded to 8, plus a header each")
+            {
+                REQUIRE(byte_ring_size(rb.get()) == 16 + 8 + 24);
+                REQUIRE(rb.push("too much!") == false);
+                REQUIRE(rb.push("fits") == true);
+            }
+            THEN("they can be pop-ed, in the same order")
+            {
+                REQUIRE(rb.pop() == "a");
+                REQUIRE(rb.pop() == "");
+                REQUIRE(rb.pop() == "0123456789abcdef");
+                REQUIRE(rb.pop() == "<empty>");
+            }
+            THEN("a pop into a too small buffer fails and leaves the record")
+            {
+                char buffer[1];
+                rb_size_t size = 0;
+                REQUIRE(rb.pop() == "a");
+                REQUIRE(rb.pop() == "");
+                REQUIRE(byte_ring_pop(rb.get(), buffer, 1, &size) == false);
+                REQUIRE(size == 16);
+                REQUIRE(rb.pop() == "0123456789abcdef");
+            }
+            THEN("they can all be drained at once")
+            {
+                auto records = rb.drain(UINT32_MAX);
+                REQUIRE(records.size() == 3);
+                REQUIRE(records[0] == "a");
+                REQUIRE(records[1] == "");
+                REQUIRE(records[2] == "0123456789abcdef");
+                REQUIRE(byte_ring_size(rb.get()) == 0);
+            }
+            THEN("a drain stops after max_records")
+            {
+                REQUIRE(rb.drain(2).size() == 2);
+                REQUIRE(rb.pop() == "0123456789abcdef");
+            }
+        }
+    }
+    GIVEN("a ring whose next record is 16 bytes from the end")
+    {
+        REQUIRE(rb.push(std::string(24, 'x')) == true);
+        REQUIRE(rb.push(std::string(8, 'y')) == true);
+        REQUIRE(rb.pop() == std::string(24, 'x'));
+        REQUIRE(rb.pop() == std::string(8, 'y'));
+
+        THEN("a record that doesn't fit is padded to the start")
+        {
+            REQUIRE(rb.push("0123456789abcdef") == true);
+            REQUIRE(byte_ring_size(rb.get()) == 16 + 24);
+
+            struct byte_ring_record record;
+            REQUIRE(byte_ring_peek(rb.get(), &record) == true);
+            REQUIRE(record.size == 16);
+            REQUIRE(std::memcmp(record.data, "0123456789abcdef", 16) == 0);
+            byte_ring_release(rb.get(), &record);
+            REQUIRE(byte_ring_size(rb.get()) == 0);
+        }
+        THEN("a record that fits is not padded")
+        {
+            REQUIRE(rb.push("01234567") == true);
+            REQUIRE(byte_ring_size(rb.get()) == 16);
+            REQUIRE(rb.pop() == "01234567");
+        }
+    }
+    GIVEN("records written in place")
+    {
+        struct byte_ring_record record;
+        REQUIRE(byte_ring_reserve(rb.get(), 5, &record) == true);
+        REQUIRE(record.size == 5);
+        REQUIRE((uintptr_t)record.data % BYTE_RING_HEADER_SIZE == 0);
+        std::memcpy(record.data, "hello", 5);
+
+        THEN("they are not visible before the commit")
+        {
+            REQUIRE(rb.pop() == "<empty>");
+            byte_ring_commit(rb.get(), &record);
+            REQUIRE(rb.pop() == "hello");
+        }
+    }
+    GIVEN("a ring that is walked around many times")
+    {
+        THEN("records of all sizes come out intact")
+        {
+            auto record = [](int i) {
+                return std::string((size_t)(i % 25), (char)('a' + i % 26));
+            };
+            for (int i = 0; i < 1000; ++i) {
+                REQUIRE(rb.push(record(i)) == true);
+                REQUIRE(rb.pop() == record(i));
+            }
+        }
+    }
+}
+
+TEST_CASE("byte ring MPMC", "[byte_ring][threads]")
+{
+    byte_ring_wrapper rb(1024);
+
+    constexpr int c = 4;
+    constexpr int n = 20'000;
+    std::atomic_int popped = 0;
+    std::atomic_int bad = 0;
+
+    // Each record is `size` bytes of `size`, so a consumer can check it.
+    auto producer = [&rb](int seed) {
+        for (int i = 0; i < n; ++i) {
+            unsigned char size = (unsigned char)((seed + i * 7) % 200);
+            std::string record(size, (char)size);
+            while (!rb.push(record))
+                std::this_thread::yield();
+        }
+    };
+    auto consumer = [&rb, &popped, &bad]() {
+        while (popped < c * n) {
+            rb_size_t count = byte_ring_drain(
+                rb.get(),
+                [](void* user, void const* data, rb_size_t size) {
+                    for (rb_size_t i = 0; i < size; ++i) {
+                        if (((unsigned char const*)data)[i] != size)
+                            ++*(std::atomic_int*)user;
+                    }
+                },
+                &bad,
+                3
+            );
+            if (count == 0)
+                std::this_thread::yield();
+            popped += (int)count;
+        }
+    };
+
+    std::thread threads[c * 2];
+    for (int i = 0; i < c; ++i) {
+        threads[i * 2] = std::thread(producer, i);
+        threads[i * 2 + 1] = std::thread(consumer);
+    }
+    for (int i = 0; i < c * 2; ++i) {
+        threads[i].join();
+    }
+
+    REQUIRE(popped == c * n);
+    REQUIRE(bad == 0);
+    REQUIRE(byte_ring_size(rb.get()) == 0);
+}
+
+TEST_CASE("byte ring MPMC with buffers of different sizes", "[byte_ring][threads]")
+{
+    byte_ring_wrapper rb(1024);
+
+    constexpr int c = 3;
+    constexpr int n = 20'000;
+    constexpr rb_size_t small = 64;
+    std::atomic_int popped = 0;
+    std::atomic_int bad = 0;
+
+    // Records on both sides of `small`, each `size` bytes of `size`.
+    auto producer = [&rb](int seed) {
+        for (int i = 0; i < n; ++i) {
+            unsigned char size = (unsigned char)(1 + (seed + i * 7) % 128);
+            std::string record(size, (char)size);
+            while (!rb.push(record))
+                std::this_thread::yield();
+        }
+    };
+    auto consumer = [&rb, &popped, &bad](rb_size_t capacity) {
+        unsigned char buffer[256];
+        rb_size_t size;
+        while (popped < c * n) {
+            if (!byte_ring_pop(rb.get(), buffer, capacity, &size)) {
+                // Either empty, or the oldest record really is too big.
+                if (size != 0 && size <= capacity)
+                    ++bad;
+                std::this_thread::yield();
+                continue;
+            }
+            for (rb_size_t i = 0; i < size; ++i) {
+                if (buffer[i] != size)
+                    ++bad;
+            }
+            ++popped;
+        }
+    };
+
+    std::thread threads[c * 3];
+    for (int i = 0; i < c; ++i) {
+        threads[i * 3] = std::thread(producer, i);
+        threads[i * 3 + 1] = std::thread(consumer, small);
+        threads[i * 3 + 2] = std::thread(consumer, (rb_size_t)256);
+    }
+    for (int i = 0; i < c * 3; ++i) {
+        threads[i].join();
+    }
+
+    REQUIRE(popped == c * n);
+    REQUIRE(bad == 0);
+    REQUIRE(byte_ring_size(rb.get()) == 0);
+}
@@ -0,0 +1,153 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cdatautils/lanering.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/* Necessary wrappers so that Catch2 correctly calls destructors.
+ */
+
+struct lane_ring_deleter
+{
+    void
+    operator()(lane_ring* lr)
+    {
+        lane_ring_destroy(lr);
+    }
+};
+static std::unique_ptr<lane_ring, lane_ring_deleter>
+make_lane_ring(rb_size_t lanes, rb_size_t lane_capacity, unsigned flags)
+{
+    lane_ring* lr = 0;
+    lane_ring_init(&lr, lanes, lane_capacity, sizeof(int), flags);
+    return std::unique_ptr<lane_ring, lane_ring_deleter>(lr);
+}
+
+TEST_CASE("lane ring", "[lane_ring]")
+{
+    auto lr = make_lane_ring(4, 4, RING_BUFFER_MPMC);
+
+    GIVEN("items pushed in different lanes")
+    {
+        REQUIRE(lane_ring_lanes(lr.get()) == 4);
+        for (int i = 0; i < 8; ++i)
+            REQUIRE(lane_ring_push_lane(lr.get(), (rb_size_t)i, &i));
+        REQUIRE(lane_ring_size(lr.get()) == 8);
+
+        THEN("pops go round-robin over the lanes, FIFO within each lane")
+        {
+            std::vector<int> popped;
+            int item;
+            while (lane_ring_pop(lr.get(), &item))
+                popped.push_back(item);
+
+            REQUIRE(popped.size() == 8);
+            REQUIRE(lane_ring_size(lr.get()) == 0);
+            // Lane 0 holds 0 and 4, lane 1 holds 1 and 5...
+            for (int lane = 0; lane < 4; ++lane) {
+                auto first = std::find(popped.begin(), popped.end(), lane);
+                auto second = std::find(popped.begin(), popped.end(), lane + 4);
+                REQUIRE(first < second);
+            }
+        }
+        THEN("they can be drained in one batch")
+        {
+            int items[16] = {};
+            REQUIRE(lane_ring_pop_n(lr.get(), items, 16) == 8);
+            REQUIRE(lane_ring_pop_n(lr.get(), items, 16) == 0);
+        }
+        THEN("a full lane rejects pushes, even if the others have space")
+        {
+            int item = 100;
+            REQUIRE(lane_ring_push_lane(lr.get(), 0, &item));
+            REQUIRE(lane_ring_push_lane(lr.get(), 0, &item));
+            REQUIRE(lane_ring_push_lane(lr.get(), 0, &item) == false);
+            REQUIRE(lane_ring_push_lane(lr.get(), 1, &item));
+        }
+    }
+}
+
+TEST_CASE("lane ring stamps", "[lane_ring]")
+{
+    auto lr = make_lane_ring(3, 8, RING_BUFFER_MPMC | LANE_RING_STAMPS);
+
+    // Lane i % 3, but in global order i.
+    for (int i = 0; i < 12; ++i)
+        REQUIRE(lane_ring_push_lane(lr.get(), (rb_size_t)(i * 7 % 3), &i));
+
+    THEN("the stamps follow the pushes")
+    {
+        int item;
+        uint64_t stamp;
+        REQUIRE(lane_ring_pop_stamped(lr.get(), &item, &stamp));
+        REQUIRE(stamp == (uint64_t)item);
+    }
+    THEN("the ordered pop merges the lanes back in push order")
+    {
+        int item;
+        uint64_t stamp;
+        for (int i = 0; i < 12; ++i) {
+            REQUIRE(lane_ring_pop_ordered(lr.get(), &item, &stamp));
+            REQUIRE(item == i);
+            REQUIRE(stamp == (uint64_t)i);
+        }
+        REQUIRE(lane_ring_pop_ordered(lr.get(), &item, &stamp) == false);
+        REQUIRE(lane_ring_size(lr.get()) == 0);
+    }
+    THEN("batches skip the stamps")
+    {
+        int items[12] = {};
+        REQUIRE(lane_ring_pop_n(lr.get(), items, 12) == 12);
+        int sum = 0;
+        for (int item : items)
+            sum += item;
+        REQUIRE(sum == 11 * 12 / 2);
+    }
+}
+
+TEST_CASE("lane ring MPMC", "[lane_ring][threads]")
+{
+    auto lr = make_lane_ring(4, 64, RING_BUFFER_MPMC | LANE_RING_STAMPS);
+
+    constexpr int c = 4;
+    constexpr int n = 20'000;
+    std::atomic_int popped = 0;
+    std::atomic_int bad = 0;
+
+    // Each producer thread gets its own lane.
+    auto producer = [&lr](int seed) {
+        for (int i = 0; i < n; ++i) {
+            int item = seed * n + i;
+            while (!lane_ring_push(lr.get(), &item))
+                std::this_thread::yield();
+        }
+    };
+    auto consumer = [&lr, &popped, &bad]() {
+        int items[16];
+        while (popped < c * n) {
+            rb_size_t count = lane_ring_pop_n(lr.get(), items, 16);
+            for (rb_size_t i = 0; i < count; ++i)
+                bad += items[i] < 0 || items[i] >= c * n;
+            if (count == 0)
+                std::this_thread::yield();
+            popped += (int)count;
+        }
+    };
+
+    std::thread threads[c * 2];
+    for (int i = 0; i < c; ++i) {
+        threads[i * 2] = std::thread(producer, i);
+        threads[i * 2 + 1] = std::thread(consumer);
+    }
+    for (int i = 0; i < c * 2; ++i) {
+        threads[i].join();
+    }
+
+    REQUIRE(popped == c * n);
+    REQUIRE(bad == 0);
+    REQUIRE(lane_ring_size(lr.get()) == 0);
+}
@@ -0,0 +1,173 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cdatautils/ringbuffer.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+
+/* An anonymous shared memory object: a memfd on Linux, an unlinked shm_open name
+everywhere else.
+*/
+static int
+make_shm_fd()
+{
+#ifdef __linux__
+    return memfd_create("cdatautils-ringbuffer-test", 0);
+#else
+    std::string name = "/cdatautils-ringbuffer-test-" + std::to_string(getpid());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    shm_unlink(name.c_str());
+    return fd;
+#endif
+}
+
+/* Runs `fn` in a child process, returns its pid. The child exits with 0 if `fn`
+returned true, 1 otherwise.
+*/
+template<class F>
+static pid_t
+fork_child(F fn)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+        _exit(fn() ? 0 : 1);
+    return pid;
+}
+
+static bool
+child_succeeded(pid_t pid)
+{
+    int status = 0;
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status)
+           && WEXITSTATUS(status) == 0;
+}
+
+TEST_CASE("ring buffer shared memory", "[ring_buffer][shm]")
+{
+    int fd = make_shm_fd();
+    REQUIRE(fd >= 0);
+
+    GIVEN("a buffer created in a shared memory object")
+    {
+        ring_buffer* rb = nullptr;
+        REQUIRE(ring_buffer_init_shm(&rb, fd, 8, sizeof(int), RING_BUFFER_MPMC));
+        REQUIRE(ring_buffer_capacity(rb) == 8);
+        REQUIRE(ring_buffer_value_size(rb) == sizeof(int));
+
+        WHEN("it is attached a second time")
+        {
+            ring_buffer* other = nullptr;
+            REQUIRE(ring_buffer_attach_shm(&other, fd));
+
+            THEN("both mappings see the same buffer, at different addresses")
+            {
+                REQUIRE(other != rb);
+
+                int item = 741;
+                REQUIRE(ring_buffer_push(rb, &item));
+                REQUIRE(ring_buffer_size(other) == 1);
+
+                item = 0;
+                REQUIRE(ring_buffer_pop(other, &item));
+                REQUIRE(item == 741);
+                REQUIRE(ring_buffer_size(rb) == 0);
+            }
+            THEN("zero-copy spans point inside the caller's mapping")
+            {
+                ring_buffer_span span;
+                REQUIRE(ring_buffer_reserve_write(other, 2, &span) == 2);
+                ((int*)span.data)[0] = 1;
+                ((int*)span.data)[1] = 2;
+                ring_buffer_commit_write(other, &span);
+
+                int items[2] = {};
+                REQUIRE(ring_buffer_pop_n_exact(rb, items, 2));
+                REQUIRE(items[0] == 1);
+                REQUIRE(items[1] == 2);
+            }
+
+            ring_buffer_destroy(other);
+        }
+        WHEN("the header is from another version")
+        {
+            uint32_t version = 0xdeadbeef;
+            REQUIRE(pwrite(fd, &version, sizeof(version), 4) == sizeof(version));
+
+            THEN("it can't be attached")
+            {
+                ring_buffer* other = nullptr;
+                REQUIRE(ring_buffer_attach_shm(&other, fd) == false);
+                REQUIRE(other == nullptr);
+            }
+        }
+
+        ring_buffer_destroy(rb);
+    }
+    GIVEN("a shared memory object that doesn't hold a buffer")
+    {
+        ring_buffer* rb = nullptr;
+
+        THEN("it can't be attached")
+        {
+            REQUIRE(ring_buffer_attach_shm(&rb, fd) == false);
+            REQUIRE(ftruncate(fd, 4096) == 0);
+            REQUIRE(ring_buffer_attach_shm(&rb, fd) == false);
+            REQUIRE(rb == nullptr);
+        }
+    }
+
+    close(fd);
+}
+
+TEST_CASE("ring buffer shared memory between processes", "[ring_buffer][shm][threads]")
+{
+    unsigned flags = RING_BUFFER_MPMC;
+    SECTION("RING_BUFFER_MPMC") { flags = RING_BUFFER_MPMC; }
+    SECTION("RING_BUFFER_SPSC") { flags = RING_BUFFER_SPSC; }
+    SECTION("RING_BUFFER_SLOT_SEQUENCES") { flags = RING_BUFFER_SLOT_SEQUENCES; }
+    SECTION("PAD_SLOTS") { flags = RING_BUFFER_PAD_SLOTS; }
+
+    constexpr int n = 100'000;
+    int fd = make_shm_fd();
+    REQUIRE(fd >= 0);
+
+    // Small, so that both processes end up sleeping on each other.
+    ring_buffer* rb = nullptr;
+    REQUIRE(ring_buffer_init_shm(&rb, fd, 8, sizeof(int), flags));
+
+    // Each child attaches its own mapping, instead of using the inherited one.
+    pid_t producer = fork_child([fd]() {
+        ring_buffer* rb = nullptr;
+        if (!ring_buffer_attach_shm(&rb, fd))
+            return false;
+        for (int i = 0; i < n; ++i)
+            ring_buffer_deadlock_push(rb, &i);
+        ring_buffer_destroy(rb);
+        return true;
+    });
+    pid_t consumer = fork_child([fd]() {
+        ring_buffer* rb = nullptr;
+        bool ok = ring_buffer_attach_shm(&rb, fd);
+        for (int i = 0; ok && i < n; ++i) {
+            int item = -1;
+            ring_buffer_deadlock_pop(rb, &item);
+            ok = item == i;
+        }
+        ring_buffer_destroy(rb);
+        return ok;
+    });
+
+    REQUIRE(producer > 0);
+    REQUIRE(consumer > 0);
+    REQUIRE(child_succeeded(producer));
+    REQUIRE(child_succeeded(consumer));
+    REQUIRE(ring_buffer_size(rb) == 0);
+
+    ring_buffer_destroy(rb);
+    close(fd);
+}
@@ -6,6 +6,11 @@
 #include <optional>
 #include <atomic>
 #include <thread>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+CDATAUTILS_RING_BUFFER_DEFINE(int, int, 8)
 
 /* Necessary wrappers so that Catch2 correctly calls destructors.
  */
@@ -21,10 +26,10 @@ struct ring_buffer_deleter
 template<class T>
 struct ring_buffer_wrapper
 {
-    ring_buffer_wrapper(rb_size_t capacity)
+    ring_buffer_wrapper(rb_size_t capacity, unsigned flags = RING_BUFFER_MPMC)
     {
         ring_buffer* rb = 0;
-        ring_buffer_init(&rb, capacity, sizeof(T));
+        ring_buffer_init_flags(&rb, capacity, sizeof(T), flags);
         _rb.reset(rb);
     }
 
@@ -58,6 +63,22 @@ struct ring_buffer_wrapper
         return item;
     }
 
+    bool
+    push_timeout(T const& item, uint64_t timeout_ns)
+    {
+        return ring_buffer_push_timeout(_rb.get(), &item, timeout_ns);
+    }
+
+    std::optional<T>
+    pop_timeout(uint64_t timeout_ns)
+    {
+        T item;
+        if (ring_buffer_pop_timeout(_rb.get(), &item, timeout_ns))
+            return item;
+        else
+            return {};
+    }
+
     bool
     maybe_pop(T& out_item)
     {
@@ -70,6 +91,58 @@ struct ring_buffer_wrapper
         return ring_buffer_maybe_push(_rb.get(), &item);
     }
 
+    rb_size_t
+    push_n(T const* items, rb_size_t n_items)
+    {
+        return ring_buffer_push_n(_rb.get(), items, n_items);
+    }
+
+    bool
+    push_n_exact(T const* items, rb_size_t n_items)
+    {
+        return ring_buffer_push_n_exact(_rb.get(), items, n_items);
+    }
+
+    rb_size_t
+    pop_n(T* out_items, rb_size_t n_items)
+    {
+        return ring_buffer_pop_n(_rb.get(), out_items, n_items);
+    }
+
+    bool
+    pop_n_exact(T* out_items, rb_size_t n_items)
+    {
+        return ring_buffer_pop_n_exact(_rb.get(), out_items, n_items);
+    }
+
+    ring_buffer_span
+    reserve_write(rb_size_t n_items)
+    {
+        ring_buffer_span span;
+        ring_buffer_reserve_write(_rb.get(), n_items, &span);
+        return span;
+    }
+
+    void
+    commit_write(ring_buffer_span const& span)
+    {
+        ring_buffer_commit_write(_rb.get(), &span);
+    }
+
+    ring_buffer_span
+    peek_read(rb_size_t n_items)
+    {
+        ring_buffer_span span;
+        ring_buffer_peek_read(_rb.get(), n_items, &span);
+        return span;
+    }
+
+    void
+    release_read(ring_buffer_span const& span)
+    {
+        ring_buffer_release_read(_rb.get(), &span);
+    }
+
     rb_size_t
     size() const
     {
@@ -90,6 +163,18 @@ struct ring_buffer_wrapper
     {
         return ring_buffer_clear(_rb.get());
     }
+    uint64_t
+    dropped() const
+    {
+        return ring_buffer_dropped(_rb.get());
+    }
+    ring_buffer_stats
+    stats() const
+    {
+        ring_buffer_stats stats;
+        ring_buffer_stats_snapshot(_rb.get(), &stats);
+        return stats;
+    }
 
 private:
     std::unique_ptr<ring_buffer, ring_buffer_deleter> _rb;
@@ -152,10 +237,494 @@ TEST_CASE("ring buffer", "[ring_buffer]")
     }
 }
 
+TEST_CASE("ring buffer batches", "[ring_buffer]")
+{
+    ring_buffer_wrapper<int> rb(8);
+    int const items[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+
+    GIVEN("a buffer of 8 with 5 items")
+    {
+        REQUIRE(rb.push_n(items, 5) == 5);
+        REQUIRE(rb.size() == 5);
+
+        THEN("only 3 more items fit")
+        {
+            REQUIRE(rb.push_n(items + 5, 5) == 3);
+            REQUIRE(rb.size() == 8);
+            REQUIRE(rb.push_n(items, 1) == 0);
+        }
+        THEN("an exact push of 4 items fails and the buffer is unchanged")
+        {
+            REQUIRE(rb.push_n_exact(items + 5, 4) == false);
+            REQUIRE(rb.size() == 5);
+        }
+        THEN("an exact pop of 6 items fails and the buffer is unchanged")
+        {
+            int out[6];
+            REQUIRE(rb.pop_n_exact(out, 6) == false);
+            REQUIRE(rb.size() == 5);
+        }
+        THEN("all items can be pop-ed at once, in the same order")
+        {
+            int out[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+            REQUIRE(rb.pop_n(out, 8) == 5);
+            for (int i = 0; i < 5; ++i)
+                REQUIRE(out[i] == i);
+            REQUIRE(out[5] == -1);
+            REQUIRE(rb.size() == 0);
+        }
+        WHEN("4 items are pop-ed and 7 are pushed (across the wrap point)")
+        {
+            int out[8];
+            REQUIRE(rb.pop_n_exact(out, 4) == true);
+            REQUIRE(rb.push_n_exact(items + 3, 7) == true);
+
+            THEN("the items come out in the same order")
+            {
+                REQUIRE(rb.pop_n(out, 8) == 8);
+                REQUIRE(out[0] == 4);
+                for (int i = 1; i < 8; ++i)
+                    REQUIRE(out[i] == i + 2);
+            }
+        }
+    }
+    GIVEN("an empty buffer of 8")
+    {
+        THEN("more than 8 items can never be pushed exactly")
+        {
+            REQUIRE(rb.push_n_exact(items, 9) == false);
+            REQUIRE(rb.size() == 0);
+        }
+        THEN("nothing can be pop-ed")
+        {
+            int out[1];
+            REQUIRE(rb.pop_n(out, 1) == 0);
+        }
+    }
+}
+
+TEST_CASE("ring buffer zero-copy", "[ring_buffer]")
+{
+    ring_buffer_wrapper<int> rb(8);
+
+    GIVEN("an empty buffer of 8")
+    {
+        THEN("nothing can be peek-ed")
+        {
+            REQUIRE(rb.peek_read(1).count == 0);
+            REQUIRE(rb.peek_read(1).data == nullptr);
+        }
+        WHEN("3 items are written in place and committed")
+        {
+            ring_buffer_span span = rb.reserve_write(3);
+            REQUIRE(span.count == 3);
+            REQUIRE(span.data != nullptr);
+
+            int* items = (int*)span.data;
+            items[0] = 10;
+            items[1] = 11;
+            items[2] = 12;
+
+            THEN("they are not visible before the commit")
+            {
+                REQUIRE(rb.size() == 0);
+                REQUIRE(rb.pop() == std::nullopt);
+            }
+            AND_WHEN("they are committed")
+            {
+                rb.commit_write(span);
+
+                THEN("they can be pop-ed")
+                {
+                    REQUIRE(rb.size() == 3);
+                    REQUIRE(rb.pop() == 10);
+                    REQUIRE(rb.pop() == 11);
+                    REQUIRE(rb.pop() == 12);
+                }
+                THEN("they can be peek-ed in place")
+                {
+                    ring_buffer_span read = rb.peek_read(8);
+                    REQUIRE(read.count == 3);
+                    REQUIRE(read.data == span.data);
+                    REQUIRE(((int*)read.data)[2] == 12);
+
+                    AND_THEN("their slots are given back after the release")
+                    {
+                        REQUIRE(rb.push_n_exact(items, 5) == true);
+                        REQUIRE(rb.push(0) == false);
+
+                        rb.release_read(read);
+                        REQUIRE(rb.push_n_exact(items, 3) == true);
+                    }
+                }
+            }
+        }
+    }
+    GIVEN("a buffer whose next slot is 6")
+    {
+        int const items[] = { 0, 1, 2, 3, 4, 5 };
+        int out[6];
+        REQUIRE(rb.push_n_exact(items, 6) == true);
+        REQUIRE(rb.pop_n_exact(out, 6) == true);
+
+        THEN("the reserved span stops at the wrap point")
+        {
+            ring_buffer_span span = rb.reserve_write(5);
+            REQUIRE(span.count == 2);
+            rb.commit_write(span);
+
+            span = rb.reserve_write(5);
+            REQUIRE(span.count == 5);
+            rb.commit_write(span);
+
+            AND_THEN("the peeked span stops at the wrap point")
+            {
+                ring_buffer_span read = rb.peek_read(8);
+                REQUIRE(read.count == 2);
+                rb.release_read(read);
+
+                read = rb.peek_read(8);
+                REQUIRE(read.count == 5);
+                rb.release_read(read);
+                REQUIRE(rb.size() == 0);
+            }
+        }
+    }
+}
+
+TEST_CASE("ring buffer padded slots", "[ring_buffer]")
+{
+    ring_buffer_wrapper<int> rb(8, RING_BUFFER_PAD_SLOTS | RING_BUFFER_INLINE_DATA);
+    int const items[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    int out[8];
+
+    GIVEN("a buffer whose next slot is 6")
+    {
+        REQUIRE(rb.push_n_exact(items, 6) == true);
+        REQUIRE(rb.pop_n_exact(out, 6) == true);
+
+        THEN("each slot has its own cache line")
+        {
+            ring_buffer_span span = rb.reserve_write(2);
+            REQUIRE(span.count == 2);
+            REQUIRE(span.stride == CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE);
+            REQUIRE((uintptr_t)span.data % CDATAUTILS_RING_BUFFER_CACHE_LINE_SIZE == 0);
+            *(int*)((char*)span.data + 0 * span.stride) = 10;
+            *(int*)((char*)span.data + 1 * span.stride) = 11;
+            rb.commit_write(span);
+
+            REQUIRE(rb.pop() == 10);
+            REQUIRE(rb.pop() == 11);
+        }
+        THEN("batches are copied around the wrap point")
+        {
+            REQUIRE(rb.push_n_exact(items, 8) == true);
+            REQUIRE(rb.pop_n_exact(out, 8) == true);
+            for (int i = 0; i < 8; ++i)
+                REQUIRE(out[i] == i);
+        }
+    }
+}
+
+TEST_CASE("ring buffer double-mapped", "[ring_buffer]")
+{
+    // 1024 ints is a 4 KiB page (the mirror needs a whole number of pages).
+    ring_buffer_wrapper<int> rb(1024, RING_BUFFER_DOUBLE_MAPPED);
+    std::vector<int> items(1024);
+    std::vector<int> out(1024);
+    for (int i = 0; i < 1024; ++i)
+        items[(size_t)i] = i;
+
+    GIVEN("a buffer whose next slot is 1020")
+    {
+        REQUIRE(rb.push_n_exact(items.data(), 1020) == true);
+        REQUIRE(rb.pop_n_exact(out.data(), 1020) == true);
+
+        THEN("batches are copied around the wrap point")
+        {
+            REQUIRE(rb.push_n_exact(items.data(), 1024) == true);
+            REQUIRE(rb.pop_n_exact(out.data(), 1024) == true);
+            REQUIRE(out == items);
+        }
+#ifdef __linux__
+        THEN("spans don't stop at the wrap point")
+        {
+            ring_buffer_span span = rb.reserve_write(8);
+            REQUIRE(span.count == 8);
+            for (int i = 0; i < 8; ++i)
+                ((int*)span.data)[i] = 10 + i;
+            rb.commit_write(span);
+
+            span = rb.peek_read(1024);
+            REQUIRE(span.count == 8);
+            for (int i = 0; i < 8; ++i)
+                REQUIRE(((int*)span.data)[i] == 10 + i);
+            rb.release_read(span);
+
+            // The last 4 went through the mirror, to the first slots.
+            span = rb.reserve_write(1024);
+            REQUIRE(span.count == 1024);
+            REQUIRE(((int*)span.data)[1020] == 14);
+            rb.commit_write(span);
+        }
+#endif
+    }
+    GIVEN("a buffer that is not a whole number of pages")
+    {
+        ring_buffer_wrapper<int> small(8, RING_BUFFER_DOUBLE_MAPPED);
+        int const few[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+        int few_out[8];
+        REQUIRE(small.push_n_exact(few, 6) == true);
+        REQUIRE(small.pop_n_exact(few_out, 6) == true);
+
+        THEN("it falls back to spans that stop at the wrap point")
+        {
+            ring_buffer_span span = small.reserve_write(8);
+            REQUIRE(span.count == 2);
+            small.commit_write(span);
+        }
+    }
+}
+
+TEST_CASE("ring buffer modes", "[ring_buffer]")
+{
+    unsigned flags = RING_BUFFER_MPMC;
+    SECTION("RING_BUFFER_MPMC") { flags = RING_BUFFER_MPMC; }
+    SECTION("RING_BUFFER_SPSC") { flags = RING_BUFFER_SPSC; }
+    SECTION("RING_BUFFER_MPSC") { flags = RING_BUFFER_MPSC; }
+    SECTION("RING_BUFFER_SPMC") { flags = RING_BUFFER_SPMC; }
+    SECTION("RING_BUFFER_SLOT_SEQUENCES") { flags = RING_BUFFER_SLOT_SEQUENCES; }
+    SECTION("RING_BUFFER_PAD_SLOTS") { flags = RING_BUFFER_PAD_SLOTS; }
+    SECTION("RING_BUFFER_INLINE_DATA") { flags = RING_BUFFER_INLINE_DATA; }
+    SECTION("RING_BUFFER_DOUBLE_MAPPED") { flags = RING_BUFFER_DOUBLE_MAPPED; }
+    SECTION("SLOT_SEQUENCES | PAD_SLOTS | INLINE_DATA")
+    {
+        flags = RING_BUFFER_SLOT_SEQUENCES | RING_BUFFER_PAD_SLOTS
+                | RING_BUFFER_INLINE_DATA;
+    }
+    SECTION("SLOT_SEQUENCES | HUGE_PAGES | PREFAULT")
+    {
+        flags = RING_BUFFER_SLOT_SEQUENCES | RING_BUFFER_HUGE_PAGES
+                | RING_BUFFER_PREFAULT;
+    }
+    SECTION("NUMA_NODE(0) | PREFAULT")
+    {
+        flags = RING_BUFFER_NUMA_NODE(0) | RING_BUFFER_PREFAULT;
+    }
+    SECTION("NUMA_INTERLEAVE | DOUBLE_MAPPED")
+    {
+        flags = RING_BUFFER_NUMA_INTERLEAVE | RING_BUFFER_DOUBLE_MAPPED;
+    }
+
+    ring_buffer_wrapper<int> rb(8, flags);
+    int const items[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    int out[8];
+
+    // Walk around the buffer a few times, so that all counters wrap.
+    for (int lap = 0; lap < 5; ++lap) {
+        REQUIRE(rb.size() == 0);
+        REQUIRE(rb.pop() == std::nullopt);
+
+        REQUIRE(rb.push(100) == true);
+        REQUIRE(rb.maybe_push(101) == true);
+        rb.push_deadlock(102);
+        REQUIRE(rb.push_n(items, 8) == 5);
+        REQUIRE(rb.push(103) == false);
+        REQUIRE(rb.maybe_push(103) == false);
+        REQUIRE(rb.size() == 8);
+
+        REQUIRE(rb.pop() == 100);
+        REQUIRE(rb.maybe_pop(out[0]) == true);
+        REQUIRE(out[0] == 101);
+        REQUIRE(rb.pop_deadlock() == 102);
+        REQUIRE(rb.pop_n_exact(out, 6) == false);
+        REQUIRE(rb.pop_n_exact(out, 2) == true);
+        REQUIRE(out[1] == 1);
+
+        ring_buffer_span span = rb.peek_read(8);
+        REQUIRE(span.count >= 1);
+        REQUIRE(*(int*)span.data == 2);
+        rb.release_read(span);
+
+        span = rb.reserve_write(1);
+        REQUIRE(span.count == 1);
+        *(int*)span.data = 104;
+        rb.commit_write(span);
+
+        rb.clear();
+    }
+}
+
+TEST_CASE("ring buffer generated", "[ring_buffer]")
+{
+    ring_buffer_int rb;
+    ring_buffer_init_int(&rb);
+
+    // Walk around the buffer a few times, so that the sequences wrap.
+    for (int lap = 0; lap < 5; ++lap) {
+        int item;
+        REQUIRE(ring_buffer_size_int(&rb) == 0);
+        REQUIRE(ring_buffer_pop_int(&rb, &item) == false);
+
+        for (int i = 0; i < 8; ++i)
+            REQUIRE(ring_buffer_push_int(&rb, lap * 10 + i) == true);
+        REQUIRE(ring_buffer_push_int(&rb, 8) == false);
+        REQUIRE(ring_buffer_size_int(&rb) == 8);
+
+        for (int i = 0; i < 5; ++i) {
+            REQUIRE(ring_buffer_pop_int(&rb, &item) == true);
+            REQUIRE(item == lap * 10 + i);
+        }
+        REQUIRE(ring_buffer_push_int(&rb, lap * 10 + 8) == true);
+        for (int i = 5; i < 9; ++i) {
+            REQUIRE(ring_buffer_pop_int(&rb, &item) == true);
+            REQUIRE(item == lap * 10 + i);
+        }
+    }
+}
+
+TEST_CASE("ring buffer timeouts", "[ring_buffer]")
+{
+    using namespace std::chrono;
+    ring_buffer_wrapper<int> rb(2);
+
+    GIVEN("an empty buffer")
+    {
+        THEN("pop_timeout gives up after the timeout")
+        {
+            auto start = steady_clock::now();
+            REQUIRE(rb.pop_timeout(20'000'000) == std::nullopt);
+            REQUIRE(steady_clock::now() - start >= milliseconds(20));
+        }
+        THEN("pop_timeout with a timeout of 0 doesn't wait")
+        {
+            REQUIRE(rb.pop_timeout(0) == std::nullopt);
+        }
+        THEN("push_timeout succeeds immediately")
+        {
+            REQUIRE(rb.push_timeout(1, 0) == true);
+            REQUIRE(rb.pop_timeout(0) == 1);
+        }
+    }
+    GIVEN("a full buffer")
+    {
+        rb.push(1);
+        rb.push(2);
+
+        THEN("push_timeout gives up after the timeout")
+        {
+            auto start = steady_clock::now();
+            REQUIRE(rb.push_timeout(3, 20'000'000) == false);
+            REQUIRE(steady_clock::now() - start >= milliseconds(20));
+            REQUIRE(rb.size() == 2);
+        }
+    }
+}
+
+TEST_CASE("ring buffer stats", "[ring_buffer]")
+{
+    unsigned flags = RING_BUFFER_MPMC;
+    SECTION("RING_BUFFER_MPMC") { flags = RING_BUFFER_MPMC; }
+    SECTION("RING_BUFFER_SPSC") { flags = RING_BUFFER_SPSC; }
+    SECTION("RING_BUFFER_SLOT_SEQUENCES") { flags = RING_BUFFER_SLOT_SEQUENCES; }
+
+    ring_buffer_wrapper<int> rb(4, flags);
+    int const items[] = { 0, 1, 2 };
+    int out[4];
+
+    REQUIRE(rb.push_n(items, 3) == 3);
+    REQUIRE(rb.pop() == 0);
+    REQUIRE(rb.push(3) == true);
+    REQUIRE(rb.push(4) == true);
+    REQUIRE(rb.push(5) == false);
+    REQUIRE(rb.pop_n(out, 4) == 4);
+    REQUIRE(rb.pop() == std::nullopt);
+
+    ring_buffer_stats stats = rb.stats();
+#ifdef CDATAUTILS_RING_BUFFER_STATS
+    REQUIRE(stats.pushes == 5);
+    REQUIRE(stats.pops == 5);
+    REQUIRE(stats.push_full == 1);
+    REQUIRE(stats.pop_empty == 1);
+    REQUIRE(stats.push_sleeps == 0);
+    REQUIRE(stats.pop_sleeps == 0);
+    REQUIRE(stats.high_water_mark == 4);
+#else
+    REQUIRE(stats.pushes == 0);
+    REQUIRE(stats.pops == 0);
+    REQUIRE(stats.high_water_mark == 0);
+#endif
+}
+
+TEST_CASE("ring buffer overwrite", "[ring_buffer]")
+{
+    unsigned flags = RING_BUFFER_OVERWRITE;
+    SECTION("RING_BUFFER_OVERWRITE") { flags = RING_BUFFER_OVERWRITE; }
+    SECTION("OVERWRITE | PAD_SLOTS | INLINE_DATA")
+    {
+        flags = RING_BUFFER_OVERWRITE | RING_BUFFER_PAD_SLOTS | RING_BUFFER_INLINE_DATA;
+    }
+
+    ring_buffer_wrapper<int> rb(4, flags);
+    int const items[] = { 0, 1, 2, 3, 4, 5 };
+    int out[4];
+
+    GIVEN("a full buffer")
+    {
+        REQUIRE(rb.push_n(items, 6) == 6);
+        REQUIRE(rb.size() == 4);
+
+        THEN("pushes overwrite the oldest items, and consumers skip them")
+        {
+            REQUIRE(rb.push(6) == true);
+            REQUIRE(rb.maybe_push(7) == true);
+            REQUIRE(rb.pop() == 4);
+            REQUIRE(rb.dropped() == 4);
+            REQUIRE(rb.pop_n(out, 4) == 3);
+            REQUIRE(out[0] == 5);
+            REQUIRE(out[2] == 7);
+            REQUIRE(rb.pop() == std::nullopt);
+            REQUIRE(rb.dropped() == 4);
+        }
+        THEN("spans and exact pops are not available")
+        {
+            REQUIRE(rb.reserve_write(1).count == 0);
+            REQUIRE(rb.peek_read(1).count == 0);
+            REQUIRE(rb.pop_n_exact(out, 1) == false);
+            REQUIRE(rb.push_n_exact(items, 2) == true);
+            REQUIRE(rb.pop() == 4);
+        }
+        THEN("clear drops everything without counting it")
+        {
+            rb.clear();
+            REQUIRE(rb.size() == 0);
+            REQUIRE(rb.pop() == std::nullopt);
+            REQUIRE(rb.push(6) == true);
+            REQUIRE(rb.pop() == 6);
+            REQUIRE(rb.dropped() == 0);
+        }
+    }
+    GIVEN("a consumer that keeps up")
+    {
+        for (int i = 0; i < 20; ++i) {
+            rb.push_deadlock(i);
+            REQUIRE(rb.pop_deadlock() == i);
+        }
+
+        THEN("nothing is dropped")
+        {
+            REQUIRE(rb.dropped() == 0);
+        }
+    }
+}
 
 TEST_CASE("ring buffer SPSC", "[ring_buffer][threads]")
 {
-    ring_buffer_wrapper<int> rb(16);
+    unsigned flags = RING_BUFFER_MPMC;
+    SECTION("RING_BUFFER_MPMC") { flags = RING_BUFFER_MPMC; }
+    SECTION("RING_BUFFER_SPSC") { flags = RING_BUFFER_SPSC; }
+
+    ring_buffer_wrapper<int> rb(16, flags);
     std::atomic_int counter = 0;
 
     auto producer = [&rb, &counter]() {
@@ -184,7 +753,12 @@ TEST_CASE("ring buffer SPSC", "[ring_buffer][threads]")
 }
 TEST_CASE("ring buffer MPSC", "[ring_buffer][threads]")
 {
-    ring_buffer_wrapper<int> rb(16);
+    unsigned flags = RING_BUFFER_MPMC;
+    SECTION("RING_BUFFER_MPMC") { flags = RING_BUFFER_MPMC; }
+    SECTION("RING_BUFFER_MPSC") { flags = RING_BUFFER_MPSC; }
+    SECTION("RING_BUFFER_SLOT_SEQUENCES") { flags = RING_BUFFER_SLOT_SEQUENCES; }
+
+    ring_buffer_wrapper<int> rb(16, flags);
     std::atomic_int counter = 0;
 
     auto producer = [&rb, &counter]() {
@@ -220,4 +794,297 @@ TEST_CASE("ring buffer MPSC", "[ring_buffer][threads]")
     }
 
     delete[] array;
+}
+TEST_CASE("ring buffer SPMC", "[ring_buffer][threads]")
+{
+    unsigned flags = RING_BUFFER_MPMC;
+    SECTION("RING_BUFFER_MPMC") { flags = RING_BUFFER_MPMC; }
+    SECTION("RING_BUFFER_SPMC") { flags = RING_BUFFER_SPMC; }
+    SECTION("RING_BUFFER_SLOT_SEQUENCES") { flags = RING_BUFFER_SLOT_SEQUENCES; }
+
+    ring_buffer_wrapper<int> rb(16, flags);
+
+    constexpr int c = 8;
+    constexpr int n = c * 10'000;
+    std::atomic_int* array = new std::atomic_int[n];
+    for (int i = 0; i < n; ++i)
+        array[i] = 0;
+
+    auto consumer = [&rb, array]() {
+        for (int i = 0; i < 10'000; ++i) {
+            int index = rb.pop_deadlock();
+            if (index >= 0 && index < n)
+                ++array[index];
+        }
+    };
+
+    std::thread consumers[c];
+    for (int i = 0; i < c; ++i) {
+        consumers[i] = std::thread(consumer);
+    }
+
+    for (int i = 0; i < n; ++i) {
+        rb.push_deadlock(i);
+    }
+    for (int i = 0; i < c; ++i) {
+        consumers[i].join();
+    }
+    for (int i = 0; i < n; ++i) {
+        if (array[i] != 1) {
+            REQUIRE(array[i] == 1);
+        }
+    }
+
+    delete[] array;
+}
+TEST_CASE("ring buffer MPMC", "[ring_buffer][threads]")
+{
+    unsigned flags = RING_BUFFER_MPMC;
+    SECTION("RING_BUFFER_MPMC") { flags = RING_BUFFER_MPMC; }
+    SECTION("RING_BUFFER_SLOT_SEQUENCES") { flags = RING_BUFFER_SLOT_SEQUENCES; }
+    SECTION("PAD_SLOTS | INLINE_DATA")
+    {
+        flags = RING_BUFFER_PAD_SLOTS | RING_BUFFER_INLINE_DATA;
+    }
+
+    ring_buffer_wrapper<int> rb(16, flags);
+
+    constexpr int c = 8;
+    constexpr int n = c * 10'000;
+    std::atomic_int counter = 0;
+    std::atomic_int* array = new std::atomic_int[n];
+    for (int i = 0; i < n; ++i)
+        array[i] = 0;
+
+    // Half of the threads push/pop one item at a time, the other half in batches.
+    auto producer = [&rb, &counter](bool batches) {
+        int batch[3];
+        for (int i = 0; i < 10'000; i += 3) {
+            int const count = std::min(10'000 - i, 3);
+            for (int j = 0; j < count; ++j)
+                batch[j] = counter++;
+
+            if (!batches) {
+                for (int j = 0; j < count; ++j)
+                    rb.push_deadlock(batch[j]);
+            } else {
+                while (!rb.push_n_exact(batch, (rb_size_t)count))
+                    std::this_thread::yield();
+            }
+        }
+    };
+    auto consumer = [&rb, array](bool batches) {
+        int batch[5];
+        for (int i = 0; i < 10'000;) {
+            rb_size_t popped = 1;
+            if (!batches)
+                batch[0] = rb.pop_deadlock();
+            else
+                popped = rb.pop_n(batch, (rb_size_t)std::min(10'000 - i, 5));
+            if (popped == 0)
+                std::this_thread::yield();
+
+            for (rb_size_t j = 0; j < popped; ++j, ++i) {
+                if (batch[j] >= 0 && batch[j] < n)
+                    ++array[batch[j]];
+            }
+        }
+    };
+
+    std::thread threads[c * 2];
+    for (int i = 0; i < c; ++i) {
+        threads[i * 2] = std::thread(producer, i % 2 == 0);
+        threads[i * 2 + 1] = std::thread(consumer, i % 2 == 0);
+    }
+    for (int i = 0; i < c * 2; ++i) {
+        threads[i].join();
+    }
+    for (int i = 0; i < n; ++i) {
+        if (array[i] != 1) {
+            REQUIRE(array[i] == 1);
+        }
+    }
+    REQUIRE(rb.size() == 0);
+
+    delete[] array;
+}
+TEST_CASE("ring buffer overwrite MPMC", "[ring_buffer][threads]")
+{
+    // Big enough that a torn copy is likely, if there is one.
+    struct item
+    {
+        int values[16];
+    };
+    ring_buffer_wrapper<item> rb(8, RING_BUFFER_OVERWRITE);
+
+    constexpr int c = 4;
+    constexpr int n = 50'000;
+    std::atomic_int popped = 0;
+    std::atomic_int torn = 0;
+    std::atomic_int full = 0;
+    std::atomic_bool done = false;
+
+    auto producer = [&rb, &full](int seed) {
+        for (int i = 0; i < n; ++i) {
+            item it;
+            std::fill(std::begin(it.values), std::end(it.values), seed * n + i);
+            full += !rb.push(it);
+        }
+    };
+    auto consumer = [&rb, &popped, &torn, &done]() {
+        for (;;) {
+            bool const last = done;
+            std::optional<item> it = rb.pop();
+            if (!it) {
+                if (last)
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+            ++popped;
+            for (int value : it->values)
+                torn += value != it->values[0];
+        }
+    };
+
+    std::thread producers[c];
+    std::thread consumers[c];
+    for (int i = 0; i < c; ++i) {
+        producers[i] = std::thread(producer, i);
+        consumers[i] = std::thread(consumer);
+    }
+    for (int i = 0; i < c; ++i)
+        producers[i].join();
+    done = true;
+    for (int i = 0; i < c; ++i)
+        consumers[i].join();
+
+    // Every item was either popped or skipped.
+    REQUIRE(full == 0);
+    REQUIRE(torn == 0);
+    REQUIRE(rb.size() == 0);
+    REQUIRE((uint64_t)popped + rb.dropped() == (uint64_t)c * n);
+}
+TEST_CASE("ring buffer size while pushing and popping", "[ring_buffer][threads]")
+{
+    unsigned flags = RING_BUFFER_MPMC;
+    SECTION("RING_BUFFER_MPMC") { flags = RING_BUFFER_MPMC; }
+    SECTION("RING_BUFFER_SLOT_SEQUENCES") { flags = RING_BUFFER_SLOT_SEQUENCES; }
+
+    ring_buffer_wrapper<int> rb(4, flags);
+    std::atomic_bool done = false;
+
+    std::thread producer([&rb, &done]() {
+        for (int i = 0; i < 100'000; ++i) {
+            while (!rb.push(i))
+                std::this_thread::yield();
+        }
+        done = true;
+    });
+    std::thread consumer([&rb, &done]() {
+        while (!done || rb.size() > 0) {
+            if (!rb.pop())
+                std::this_thread::yield();
+        }
+    });
+
+    // The size is only a snapshot, but never "negative" (wrapped around).
+    rb_size_t max_size = 0;
+    while (!done) {
+        max_size = std::max(max_size, rb.size());
+        std::this_thread::yield();
+    }
+
+    producer.join();
+    consumer.join();
+    REQUIRE(max_size <= 4);
+}
+TEST_CASE("ring buffer wakes up sleeping threads", "[ring_buffer][threads]")
+{
+    unsigned flags = RING_BUFFER_MPMC;
+    SECTION("RING_BUFFER_MPMC") { flags = RING_BUFFER_MPMC; }
+    SECTION("RING_BUFFER_SPSC") { flags = RING_BUFFER_SPSC; }
+    SECTION("RING_BUFFER_SLOT_SEQUENCES") { flags = RING_BUFFER_SLOT_SEQUENCES; }
+
+    ring_buffer_wrapper<int> rb(2, flags);
+
+    GIVEN("a consumer sleeping on an empty buffer")
+    {
+        std::optional<int> popped;
+        std::thread consumer([&rb, &popped]() {
+            popped = rb.pop_timeout(10'000'000'000);
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        rb.push(42);
+        consumer.join();
+
+        THEN("a push wakes it up")
+        {
+            REQUIRE(popped == 42);
+        }
+    }
+    GIVEN("a producer sleeping on a full buffer")
+    {
+        rb.push(1);
+        rb.push(2);
+
+        std::thread producer([&rb]() { rb.push_deadlock(3); });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(rb.pop() == 1);
+        producer.join();
+
+        THEN("a pop wakes it up")
+        {
+            REQUIRE(rb.pop() == 2);
+            REQUIRE(rb.pop() == 3);
+        }
+    }
+}
+TEST_CASE("ring buffer batches SPSC", "[ring_buffer][threads]")
+{
+    unsigned flags = RING_BUFFER_MPMC;
+    SECTION("RING_BUFFER_MPMC") { flags = RING_BUFFER_MPMC; }
+    SECTION("RING_BUFFER_SPSC") { flags = RING_BUFFER_SPSC; }
+    SECTION("RING_BUFFER_SLOT_SEQUENCES") { flags = RING_BUFFER_SLOT_SEQUENCES; }
+    SECTION("SPSC | DOUBLE_MAPPED")
+    {
+        flags = RING_BUFFER_SPSC | RING_BUFFER_DOUBLE_MAPPED;
+    }
+
+    // A page of ints when double-mapped, so that the mirror is actually used.
+    ring_buffer_wrapper<int> rb(flags & RING_BUFFER_DOUBLE_MAPPED ? 1024 : 64, flags);
+    constexpr int n = 200'000;
+
+    auto producer = [&rb]() {
+        int batch[13];
+        int next = 0;
+        while (next < n) {
+            int const count = std::min(n - next, 13);
+            for (int i = 0; i < count; ++i)
+                batch[i] = next + i;
+
+            rb_size_t pushed = rb.push_n(batch, (rb_size_t)count);
+            if (pushed == 0)
+                std::this_thread::yield();
+            next += (int)pushed;
+        }
+    };
+
+    std::thread producer_0(producer);
+
+    int expected = 0;
+    int batch[17];
+    while (expected < n) {
+        rb_size_t popped = rb.pop_n(batch, 17);
+        if (popped == 0)
+            std::this_thread::yield();
+        for (rb_size_t i = 0; i < popped; ++i, ++expected) {
+            if (batch[i] != expected)
+                REQUIRE(batch[i] == expected);
+        }
+    }
+    producer_0.join();
+    REQUIRE(rb.size() == 0);
 }
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cdatautils/workdeque.h>
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/* Necessary wrappers so that Catch2 correctly calls destructors.
+ */
+
+struct work_deque_deleter
+{
+    void
+    operator()(work_deque* dq)
+    {
+        work_deque_destroy(dq);
+    }
+};
+template<class T>
+struct work_deque_wrapper
+{
+    work_deque_wrapper(rb_size_t capacity)
+    {
+        work_deque* dq = 0;
+        work_deque_init(&dq, capacity, sizeof(T));
+        _dq.reset(dq);
+    }
+
+    void
+    push(T const& item)
+    {
+        work_deque_push(_dq.get(), &item);
+    }
+
+    std::optional<T>
+    pop()
+    {
+        T item;
+        if (work_deque_pop(_dq.get(), &item))
+            return item;
+        else
+            return {};
+    }
+
+    std::optional<T>
+    steal()
+    {
+        T item;
+        if (work_deque_steal(_dq.get(), &item))
+            return item;
+        else
+            return {};
+    }
+
+    rb_size_t
+    size() const
+    {
+        return work_deque_size(_dq.get());
+    }
+    rb_size_t
+    capacity() const
+    {
+        return work_deque_capacity(_dq.get());
+    }
+
+private:
+    std::unique_ptr<work_deque, work_deque_deleter> _dq;
+};
+
+TEST_CASE("work deque", "[work_deque]")
+{
+    work_deque_wrapper<int> dq(4);
+
+    GIVEN("just-initialized deque of 4 ints")
+    {
+        REQUIRE(dq.capacity() == 4);
+
+        THEN("the deque is empty")
+        {
+            REQUIRE(dq.size() == 0);
+            REQUIRE(dq.pop() == std::nullopt);
+            REQUIRE(dq.steal() == std::nullopt);
+        }
+        WHEN("items are pushed")
+        {
+            dq.push(1);
+            dq.push(2);
+            dq.push(3);
+            REQUIRE(dq.size() == 3);
+
+            THEN("the owner pops them last-in first-out")
+            {
+                REQUIRE(dq.pop() == 3);
+                REQUIRE(dq.pop() == 2);
+                REQUIRE(dq.pop() == 1);
+                REQUIRE(dq.pop() == std::nullopt);
+            }
+            THEN("thieves steal them first-in first-out")
+            {
+                REQUIRE(dq.steal() == 1);
+                REQUIRE(dq.steal() == 2);
+                REQUIRE(dq.steal() == 3);
+                REQUIRE(dq.steal() == std::nullopt);
+            }
+            THEN("both ends can be used together")
+            {
+                REQUIRE(dq.steal() == 1);
+                REQUIRE(dq.pop() == 3);
+                REQUIRE(dq.steal() == 2);
+                REQUIRE(dq.pop() == std::nullopt);
+                REQUIRE(dq.size() == 0);
+            }
+        }
+        WHEN("more items than the capacity are pushed")
+        {
+            for (int i = 0; i < 10; ++i)
+                dq.push(i);
+
+            THEN("the storage grows, and keeps all items in order")
+            {
+                REQUIRE(dq.capacity() == 16);
+                REQUIRE(dq.size() == 10);
+                REQUIRE(dq.steal() == 0);
+                REQUIRE(dq.steal() == 1);
+                for (int i = 9; i >= 2; --i)
+                    REQUIRE(dq.pop() == i);
+                REQUIRE(dq.pop() == std::nullopt);
+            }
+        }
+    }
+    GIVEN("a deque that is walked around many times")
+    {
+        THEN("it doesn't grow")
+        {
+            for (int i = 0; i < 1000; ++i) {
+                dq.push(i);
+                dq.push(i + 1);
+                REQUIRE(dq.steal() == i);
+                REQUIRE(dq.pop() == i + 1);
+            }
+            REQUIRE(dq.capacity() == 4);
+        }
+    }
+}
+
+TEST_CASE("work deque stealing", "[work_deque][threads]")
+{
+    // Small, so that it grows while the thieves are stealing.
+    work_deque_wrapper<int> dq(8);
+
+    constexpr int c = 3;
+    constexpr int n = 100'000;
+    std::vector<std::atomic_int> seen(n);
+    std::atomic_bool done = false;
+
+    auto thief = [&dq, &seen, &done]() {
+        while (!done || dq.size() > 0) {
+            if (auto item = dq.steal())
+                ++seen[*item];
+            else
+                std::this_thread::yield();
+        }
+    };
+
+    std::thread threads[c];
+    for (int i = 0; i < c; ++i)
+        threads[i] = std::thread(thief);
+
+    // The owner pushes everything, and pops some back in between.
+    for (int i = 0; i < n; ++i) {
+        dq.push(i);
+        if (i % 3 == 0) {
+            if (auto item = dq.pop())
+                ++seen[*item];
+        }
+    }
+    while (auto item = dq.pop())
+        ++seen[*item];
+    done = true;
+
+    for (int i = 0; i < c; ++i)
+        threads[i].join();
+
+    // Every item was taken exactly once.
+    int bad = 0;
+    for (int i = 0; i < n; ++i)
+        bad += seen[i] != 1;
+    REQUIRE(bad == 0);
+    REQUIRE(dq.size() == 0);
+}
@@ -0,0 +1,650 @@
+/* benchmark tries to declspec(__dllimport) its methods, even though it is a static
+ * library.
+ */
+#define BENCHMARK_EXPORT
+#include <benchmark/benchmark.h>
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <cdatautils/vector.h>
+
+/* An item of `N` bytes, to run the same benchmark for every element size. */
+template<int N>
+struct blob
+{
+    unsigned char bytes[N];
+};
+
+/* Vector sizes: 10 to 10M items, as long as they fit in 256 MB. */
+template<int N>
+void
+decorate_sizes(benchmark::internal::Benchmark* bm)
+{
+    bm->ArgNames({ "items" });
+    for (int64_t n = 10; n <= 10'000'000; n *= 10) {
+        if (n * N <= (int64_t)1 << 28)
+            bm->Arg(n);
+    }
+}
+/* The same, up to 1M items, for the benchmarks that are O(size) per operation. */
+template<int N>
+void
+decorate_sizes_linear(benchmark::internal::Benchmark* bm)
+{
+    bm->ArgNames({ "items" });
+    for (int64_t n = 10; n <= 1'000'000; n *= 10) {
+        if (n * N <= (int64_t)1 << 28)
+            bm->Arg(n);
+    }
+}
+
+/* Registers `bm` for element sizes of 1 to 256 bytes, with the vector sizes of
+`decorate`.
+*/
+#define VECTOR_BENCHMARK_SIZES(bm, decorate)         \
+    BENCHMARK_TEMPLATE(bm, 1)->Apply(decorate<1>);   \
+    BENCHMARK_TEMPLATE(bm, 4)->Apply(decorate<4>);   \
+    BENCHMARK_TEMPLATE(bm, 16)->Apply(decorate<16>); \
+    BENCHMARK_TEMPLATE(bm, 64)->Apply(decorate<64>); \
+    BENCHMARK_TEMPLATE(bm, 256)->Apply(decorate<256>)
+
+/* Fills `v` with `n` items of `N` bytes. */
+template<int N>
+void
+fill(struct vector* v, int n)
+{
+    blob<N> item = {};
+    vector_init(v, N);
+    vector_reserve(v, n + 1);
+    for (int i = 0; i < n; ++i) {
+        item.bytes[0] = (unsigned char)i;
+        vector_push(v, &item);
+    }
+}
+template<int N>
+void
+fill(std::vector<blob<N>>* v, int n)
+{
+    blob<N> item = {};
+    v->reserve((size_t)n + 1u);
+    for (int i = 0; i < n; ++i) {
+        item.bytes[0] = (unsigned char)i;
+        v->push_back(item);
+    }
+}
+
+/* Pushes `range(0)` items one by one in a fresh vector. */
+template<int N>
+void
+bm_vector_push(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    blob<N> item = {};
+
+    for (auto _ : state) {
+        struct vector v;
+        vector_init(&v, N);
+        for (int i = 0; i < n; ++i) {
+            item.bytes[0] = (unsigned char)i;
+            vector_push(&v, &item);
+        }
+        benchmark::DoNotOptimize(v.data);
+        vector_destroy(&v);
+    }
+
+    state.SetItemsProcessed(state.iterations() * n);
+    state.SetBytesProcessed(state.iterations() * n * N);
+}
+template<int N>
+void
+bm_std_vector_push(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    blob<N> item = {};
+
+    for (auto _ : state) {
+        std::vector<blob<N>> v;
+        for (int i = 0; i < n; ++i) {
+            item.bytes[0] = (unsigned char)i;
+            v.push_back(item);
+        }
+        benchmark::DoNotOptimize(v.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * n);
+    state.SetBytesProcessed(state.iterations() * n * N);
+}
+
+/* Pushes `range(0)` items 64 at a time in a fresh vector. */
+template<int N>
+void
+bm_vector_push_array(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    std::vector<blob<N>> const items((size_t)n);
+
+    for (auto _ : state) {
+        struct vector v;
+        vector_init(&v, N);
+        for (int i = 0; i < n; i += 64)
+            vector_push_array(&v, n - i < 64 ? n - i : 64, &items[(size_t)i]);
+        benchmark::DoNotOptimize(v.data);
+        vector_destroy(&v);
+    }
+
+    state.SetItemsProcessed(state.iterations() * n);
+    state.SetBytesProcessed(state.iterations() * n * N);
+}
+template<int N>
+void
+bm_std_vector_push_array(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    std::vector<blob<N>> const items((size_t)n);
+
+    for (auto _ : state) {
+        std::vector<blob<N>> v;
+        for (int i = 0; i < n; i += 64) {
+            auto const first = items.begin() + i;
+            v.insert(v.end(), first, n - i < 64 ? items.end() : first + 64);
+        }
+        benchmark::DoNotOptimize(v.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * n);
+    state.SetBytesProcessed(state.iterations() * n * N);
+}
+
+/* Inserts an item in the middle of a vector of `range(0)` items, and removes it
+again. The bytes are the ones moved by the insertion.
+*/
+template<int N>
+void
+bm_vector_insert_middle(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    blob<N> const item = {};
+    struct vector v;
+    fill<N>(&v, n);
+
+    for (auto _ : state) {
+        vector_insert(&v, n / 2, &item);
+        benchmark::DoNotOptimize(v.data);
+        vector_remove(&v, n / 2);
+    }
+    vector_destroy(&v);
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * (n - n / 2) * N);
+}
+template<int N>
+void
+bm_std_vector_insert_middle(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    blob<N> const item = {};
+    std::vector<blob<N>> v;
+    fill<N>(&v, n);
+
+    for (auto _ : state) {
+        v.insert(v.begin() + n / 2, item);
+        benchmark::DoNotOptimize(v.data());
+        v.erase(v.begin() + n / 2);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * (n - n / 2) * N);
+}
+
+/* Removes a tenth of a vector of `range(0)` items, starting at a quarter, and
+pushes as many back at the end. The items are the removed ones, the bytes the
+ones moved by the removal.
+*/
+template<int N>
+void
+bm_vector_remove_range(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    int const first = n / 4;
+    int const removed = n / 10;
+    std::vector<blob<N>> const items((size_t)removed);
+    struct vector v;
+    fill<N>(&v, n);
+
+    for (auto _ : state) {
+        vector_remove_range(&v, first, first + removed);
+        benchmark::DoNotOptimize(v.data);
+        vector_push_array(&v, removed, items.data());
+    }
+    vector_destroy(&v);
+
+    state.SetItemsProcessed(state.iterations() * removed);
+    state.SetBytesProcessed(state.iterations() * (n - first - removed) * N);
+}
+template<int N>
+void
+bm_std_vector_remove_range(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    int const first = n / 4;
+    int const removed = n / 10;
+    std::vector<blob<N>> const items((size_t)removed);
+    std::vector<blob<N>> v;
+    fill<N>(&v, n);
+
+    for (auto _ : state) {
+        v.erase(v.begin() + first, v.begin() + first + removed);
+        benchmark::DoNotOptimize(v.data());
+        v.insert(v.end(), items.begin(), items.end());
+    }
+
+    state.SetItemsProcessed(state.iterations() * removed);
+    state.SetBytesProcessed(state.iterations() * (n - first - removed) * N);
+}
+
+struct vec3f
+{
+    float x, y, z;
+};
+CDATAUTILS_VECTOR_PUSHERS(vec3f, vec3f)
+
+/* Generic vs CDATAUTILS_VECTOR_PUSHERS: pushes `range(0)` items in a vector that
+already has the capacity (the fast path), then pops them all.
+*/
+template<class T>
+void
+bm_vector_push_generic(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    T item = {};
+    struct vector v;
+    vector_init(&v, sizeof(T));
+    vector_reserve(&v, n);
+
+    for (auto _ : state) {
+        vector_clear(&v);
+        for (int i = 0; i < n; ++i) {
+            benchmark::DoNotOptimize(item);
+            vector_push(&v, &item);
+        }
+        benchmark::ClobberMemory();
+    }
+    vector_destroy(&v);
+
+    state.SetItemsProcessed(state.iterations() * n);
+    state.SetBytesProcessed(state.iterations() * n * (int64_t)sizeof(T));
+}
+template<class T, void (*push)(struct vector*, T)>
+void
+bm_vector_push_typed(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    T item = {};
+    struct vector v;
+    vector_init(&v, sizeof(T));
+    vector_reserve(&v, n);
+
+    for (auto _ : state) {
+        vector_clear(&v);
+        for (int i = 0; i < n; ++i) {
+            benchmark::DoNotOptimize(item);
+            push(&v, item);
+        }
+        benchmark::ClobberMemory();
+    }
+    vector_destroy(&v);
+
+    state.SetItemsProcessed(state.iterations() * n);
+    state.SetBytesProcessed(state.iterations() * n * (int64_t)sizeof(T));
+}
+/* The same from an empty vector every time, so growth (the slow path) is in. */
+template<class T, void (*push)(struct vector*, T)>
+void
+bm_vector_push_typed_growing(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    T item = {};
+
+    for (auto _ : state) {
+        struct vector v;
+        vector_init(&v, sizeof(T));
+        for (int i = 0; i < n; ++i) {
+            benchmark::DoNotOptimize(item);
+            push(&v, item);
+        }
+        benchmark::ClobberMemory();
+        vector_destroy(&v);
+    }
+
+    state.SetItemsProcessed(state.iterations() * n);
+    state.SetBytesProcessed(state.iterations() * n * (int64_t)sizeof(T));
+}
+template<class T>
+void
+bm_vector_pop_generic(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    T item = {};
+    struct vector v;
+    vector_init(&v, sizeof(T));
+    for (int i = 0; i < n; ++i)
+        vector_push(&v, &item);
+
+    for (auto _ : state) {
+        v.size = n;
+        while (v.size) {
+            memcpy(&item, vector_get(&v, v.size - 1), sizeof(T));
+            vector_remove(&v, v.size - 1);
+            benchmark::DoNotOptimize(item);
+        }
+    }
+    vector_destroy(&v);
+
+    state.SetItemsProcessed(state.iterations() * n);
+}
+template<class T, T (*pop)(struct vector*)>
+void
+bm_vector_pop_typed(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    T item = {};
+    struct vector v;
+    vector_init(&v, sizeof(T));
+    for (int i = 0; i < n; ++i)
+        vector_push(&v, &item);
+
+    for (auto _ : state) {
+        v.size = n;
+        while (v.size) {
+            item = pop(&v);
+            benchmark::DoNotOptimize(item);
+        }
+    }
+    vector_destroy(&v);
+
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+/* The lines of the formatting benchmarks, by `range(1)`. */
+enum format_line
+{
+    /* "item=-42 (294)" */
+    FORMAT_LINE_MIXED,
+    /* Two 64-bit integers. */
+    FORMAT_LINE_INTEGERS,
+    /* Two doubles, with as many digits as they need to read back the same
+    (snprintf: %.17g, the closest it has).
+    */
+    FORMAT_LINE_DOUBLES,
+};
+
+/* Formats `range(0)` lines in a char vector, cleared every time. */
+void
+bm_vector_push_sprintf(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    int64_t bytes = 0;
+    struct vector v;
+    vector_init(&v, sizeof(char));
+
+    for (auto _ : state) {
+        vector_clear(&v);
+        for (int i = 0; i < n; ++i) {
+            switch (state.range(1)) {
+                case FORMAT_LINE_MIXED:
+                    vector_push_sprintf(
+                        &v,
+                        "%s=%i (%u)\n",
+                        "item",
+                        -i,
+                        (uint32_t)i * 7u
+                    );
+                    break;
+                case FORMAT_LINE_INTEGERS:
+                    vector_push_sprintf(
+                        &v,
+                        "%li %lu\n",
+                        (int64_t)i * -1'000'003,
+                        (uint64_t)i * 0x9e3779b97f4a7c15u
+                    );
+                    break;
+                case FORMAT_LINE_DOUBLES:
+                    vector_push_sprintf(&v, "%f %f\n", i / 7.0, i * 1e-3);
+                    break;
+            }
+        }
+        benchmark::DoNotOptimize(v.data);
+        bytes += v.size;
+    }
+    vector_destroy(&v);
+
+    state.SetItemsProcessed(state.iterations() * n);
+    state.SetBytesProcessed(bytes);
+}
+/* The same with descriptors compiled on first use. */
+void
+bm_vector_push_fmt(benchmark::State& state)
+{
+    static vector_fmt mixed = vector_fmt_create("%s=%i (%u)\n");
+    static vector_fmt integers = vector_fmt_create("%li %lu\n");
+    static vector_fmt doubles = vector_fmt_create("%f %f\n");
+    int const n = (int)state.range(0);
+    int64_t bytes = 0;
+    struct vector v;
+    vector_init(&v, sizeof(char));
+
+    for (auto _ : state) {
+        vector_clear(&v);
+        for (int i = 0; i < n; ++i) {
+            switch (state.range(1)) {
+                case FORMAT_LINE_MIXED:
+                    vector_push_fmt(&v, &mixed, "item", -i, (uint32_t)i * 7u);
+                    break;
+                case FORMAT_LINE_INTEGERS:
+                    vector_push_fmt(
+                        &v,
+                        &integers,
+                        (int64_t)i * -1'000'003,
+                        (uint64_t)i * 0x9e3779b97f4a7c15u
+                    );
+                    break;
+                case FORMAT_LINE_DOUBLES:
+                    vector_push_fmt(&v, &doubles, i / 7.0, i * 1e-3);
+                    break;
+            }
+        }
+        benchmark::DoNotOptimize(v.data);
+        bytes += v.size;
+    }
+    vector_destroy(&v);
+
+    state.SetItemsProcessed(state.iterations() * n);
+    state.SetBytesProcessed(bytes);
+}
+/* The same with snprintf, appended to a std::vector<char>. */
+void
+bm_std_vector_snprintf(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    int64_t bytes = 0;
+    std::vector<char> v;
+    char line[64];
+    int length = 0;
+
+    for (auto _ : state) {
+        v.clear();
+        for (int i = 0; i < n; ++i) {
+            switch (state.range(1)) {
+                case FORMAT_LINE_MIXED:
+                    length = std::snprintf(
+                        line,
+                        sizeof(line),
+                        "%s=%i (%u)\n",
+                        "item",
+                        -i,
+                        (uint32_t)i * 7u
+                    );
+                    break;
+                case FORMAT_LINE_INTEGERS:
+                    length = std::snprintf(
+                        line,
+                        sizeof(line),
+                        "%" PRIi64 " %" PRIu64 "\n",
+                        (int64_t)i * -1'000'003,
+                        (uint64_t)i * 0x9e3779b97f4a7c15u
+                    );
+                    break;
+                case FORMAT_LINE_DOUBLES:
+                    length = std::snprintf(
+                        line,
+                        sizeof(line),
+                        "%.17g %.17g\n",
+                        i / 7.0,
+                        i * 1e-3
+                    );
+                    break;
+            }
+            v.insert(v.end(), line, line + length);
+        }
+        benchmark::DoNotOptimize(v.data());
+        bytes += (int64_t)v.size();
+    }
+
+    state.SetItemsProcessed(state.iterations() * n);
+    state.SetBytesProcessed(bytes);
+}
+
+/* Growth policies: pushes `range(0)` ints one by one in a fresh vector with the
+flags `range(1)`, counting how often the buffer grows and moves.
+
+Arguments:
+    - items
+    - flags (0 for 2x, VECTOR_GROWTH_1_5X, VECTOR_GROWTH_PAGES, or both)
+*/
+void
+bm_vector_growth(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    int64_t grows = 0;
+    int64_t moves = 0;
+    int64_t capacity = 0;
+
+    for (auto _ : state) {
+        struct vector v;
+        vector_init_flags(&v, sizeof(int), (unsigned)state.range(1));
+
+        for (int i = 0; i < n; ++i) {
+            void const* const data = v.data;
+            int const old_capacity = v.capacity;
+            vector_push(&v, &i);
+            grows += v.capacity != old_capacity;
+            moves += v.data != data;
+        }
+        benchmark::DoNotOptimize(v.data);
+        capacity = v.capacity;
+
+        vector_destroy(&v);
+    }
+
+    double const iterations = (double)state.iterations();
+    state.SetItemsProcessed(state.iterations() * n);
+    state.counters["grows"] = (double)grows / iterations;
+    state.counters["moves"] = (double)moves / iterations;
+    state.counters["slack"] = (double)(capacity - n) / (double)n;
+    state.counters["ns_per_push"] = benchmark::Counter(
+        (double)n,
+        benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert
+    );
+}
+/* vector_push_array in small batches, the case that used to realloc on every call
+(reserve was exact).
+
+Arguments:
+    - items
+    - batch
+*/
+void
+bm_vector_push_array_growth(benchmark::State& state)
+{
+    int const n = (int)state.range(0);
+    int const batch = (int)state.range(1);
+    int const items[64] = {};
+    int64_t grows = 0;
+
+    for (auto _ : state) {
+        struct vector v;
+        vector_init(&v, sizeof(int));
+
+        for (int i = 0; i < n; i += batch) {
+            int const old_capacity = v.capacity;
+            vector_push_array(&v, batch, items);
+            grows += v.capacity != old_capacity;
+        }
+        benchmark::DoNotOptimize(v.data);
+
+        vector_destroy(&v);
+    }
+
+    state.SetItemsProcessed(state.iterations() * n);
+    state.counters["grows"] = (double)grows / (double)state.iterations();
+}
+
+VECTOR_BENCHMARK_SIZES(bm_vector_push, decorate_sizes);
+VECTOR_BENCHMARK_SIZES(bm_std_vector_push, decorate_sizes);
+VECTOR_BENCHMARK_SIZES(bm_vector_push_array, decorate_sizes);
+VECTOR_BENCHMARK_SIZES(bm_std_vector_push_array, decorate_sizes);
+VECTOR_BENCHMARK_SIZES(bm_vector_insert_middle, decorate_sizes_linear);
+VECTOR_BENCHMARK_SIZES(bm_std_vector_insert_middle, decorate_sizes_linear);
+VECTOR_BENCHMARK_SIZES(bm_vector_remove_range, decorate_sizes_linear);
+VECTOR_BENCHMARK_SIZES(bm_std_vector_remove_range, decorate_sizes_linear);
+#define VECTOR_BENCHMARK_PUSHERS(type, name)                                          \
+    BENCHMARK_TEMPLATE(bm_vector_push_generic, type)->Arg(1 << 12);                   \
+    BENCHMARK_TEMPLATE(bm_vector_push_typed, type, vector_push_##name)->Arg(1 << 12); \
+    BENCHMARK_TEMPLATE(bm_vector_push_typed_growing, type, vector_push_##name)        \
+        ->Arg(1 << 12);                                                               \
+    BENCHMARK_TEMPLATE(bm_vector_pop_generic, type)->Arg(1 << 12);                    \
+    BENCHMARK_TEMPLATE(bm_vector_pop_typed, type, vector_pop_##name)->Arg(1 << 12)
+
+VECTOR_BENCHMARK_PUSHERS(int, int);
+VECTOR_BENCHMARK_PUSHERS(double, f64);
+VECTOR_BENCHMARK_PUSHERS(vec3f, vec3f);
+
+BENCHMARK(bm_vector_push_sprintf)
+    ->ArgNames({ "lines", "line" })
+    ->ArgsProduct({
+        { 10, 1000, 100'000 },
+        { FORMAT_LINE_MIXED, FORMAT_LINE_INTEGERS, FORMAT_LINE_DOUBLES },
+    });
+BENCHMARK(bm_vector_push_fmt)
+    ->ArgNames({ "lines", "line" })
+    ->ArgsProduct({
+        { 10, 1000, 100'000 },
+        { FORMAT_LINE_MIXED, FORMAT_LINE_INTEGERS, FORMAT_LINE_DOUBLES },
+    });
+BENCHMARK(bm_std_vector_snprintf)
+    ->ArgNames({ "lines", "line" })
+    ->ArgsProduct({
+        { 10, 1000, 100'000 },
+        { FORMAT_LINE_MIXED, FORMAT_LINE_INTEGERS, FORMAT_LINE_DOUBLES },
+    });
+
+BENCHMARK(bm_vector_growth)
+    ->ArgNames({ "items", "flags" })
+    ->ArgsProduct({
+        { 1 << 10, 1 << 16, 1 << 20, 1 << 23 },
+        {
+            0,
+            VECTOR_GROWTH_1_5X,
+            VECTOR_GROWTH_PAGES,
+            VECTOR_GROWTH_1_5X | VECTOR_GROWTH_PAGES,
+        },
+    });
+BENCHMARK(bm_vector_push_array_growth)
+    ->ArgNames({ "items", "batch" })
+    ->ArgsProduct({ { 1 << 16, 1 << 20 }, { 3, 16, 64 } });
+
+BENCHMARK_MAIN();
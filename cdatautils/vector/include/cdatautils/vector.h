@@ -1,7 +1,9 @@
 #ifndef CDATAUTILS_VECTOR_H
 #define CDATAUTILS_VECTOR_H
 
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -9,6 +11,48 @@ extern "C" {
 #define restrict
 #endif
 
+/* Buffers of at least this many bytes are placed as asked by the vector's `flags`
+(see `enum vector_flags`), smaller ones always come from realloc.
+
+Only read by vector.c, so it must be defined when building the library.
+*/
+#ifndef CDATAUTILS_VECTOR_PLACEMENT_THRESHOLD
+#define CDATAUTILS_VECTOR_PLACEMENT_THRESHOLD (2 << 20)
+#endif
+
+/* The page size VECTOR_GROWTH_PAGES rounds buffers to.
+
+Only read by vector.c, so it must be defined when building the library.
+*/
+#ifndef CDATAUTILS_VECTOR_PAGE_SIZE
+#define CDATAUTILS_VECTOR_PAGE_SIZE 4096
+#endif
+
+/* Where a vector's buffer comes from, see vector_init_with_allocator.
+
+See `cdatautils/vectoralloc.h` for an arena and a pool.
+*/
+struct vector_allocator
+{
+    /* Resizes `block` (of `old_size` bytes) to `new_size` bytes, like realloc:
+    allocates a new block if `block` is NULL (`old_size` is then 0), and copies
+    the first min(`old_size`, `new_size`) bytes if the block moves.
+
+    The block must be aligned on a 16 byte boundary.
+
+    Returns NULL on failure, `block` is then left untouched.
+    */
+    void* (*realloc)(void* context, void* block, size_t old_size, size_t new_size);
+
+    /* Frees `block`, of `size` bytes. May be NULL, for allocators that release
+    everything at once (see vector_arena).
+    */
+    void (*free)(void* context, void* block, size_t size);
+
+    /* Passed to both callbacks. */
+    void* context;
+};
+
 /* A growable array of same-sized items.
 
 It is expected that `value_size` does not change and is not changed by the user.
@@ -24,6 +68,9 @@ struct vector
         - malloc
         - realloc
         - calloc
+    Or, with `flags` and at least CDATAUTILS_VECTOR_PLACEMENT_THRESHOLD bytes of
+    capacity, of mmap. Or, with an `allocator`, of `allocator->realloc`. Or,
+    after vector_init_inline and until the first growth, the caller's buffer.
 
     Modifying manually:
         Not advised.
@@ -82,19 +129,93 @@ struct vector
         (the real one).
     */
     int value_size;
+
+    /* A combination of `enum vector_flags`, how buffers grow and how big ones
+    are allocated.
+
+    0 (the default) for plain realloc, doubling the capacity.
+    VECTOR_INLINE_STORAGE while `data` is the buffer given to vector_init_inline.
+
+    Modifying manually:
+        Only while `capacity` is 0. The VECTOR_GROWTH_* flags at any time.
+    */
+    unsigned flags;
+
+    /* Where the buffer comes from. NULL (the default) for realloc/free.
+
+    Must outlive the buffer.
+
+    Modifying manually:
+        Only while `capacity` is 0.
+    */
+    struct vector_allocator const* allocator;
 };
 
+/* Flags for vector_init_flags.
+
+The placement flags (huge pages, prefault, NUMA) only apply to buffers of at
+least CDATAUTILS_VECTOR_PLACEMENT_THRESHOLD bytes, which are then mapped on their
+own (mmap) instead of coming from realloc. Growing such a buffer maps a new one
+and copies the items over. Linux only for now, elsewhere they are ignored.
+
+The growth flags pick how push/insert grow a full vector (vector_reserve and
+vector_reserve_more always grow to the exact capacity asked for). Without them
+the capacity doubles.
+*/
+enum vector_flags
+{
+    /* Back the buffer with 2 MB huge pages, to cut TLB misses. Tries MAP_HUGETLB
+    (reserved huge pages) first, then falls back to a 2 MB aligned mapping with
+    madvise(MADV_HUGEPAGE) (transparent huge pages).
+    */
+    VECTOR_HUGE_PAGES = 1u << 0,
+
+    /* Touch every page of the buffer when it is allocated, instead of on the first
+    write to each page (and so that the NUMA flags place them right away).
+    */
+    VECTOR_PREFAULT = 1u << 1,
+
+    /* Spread the pages of the buffer over all NUMA nodes (mbind MPOL_INTERLEAVE).
+    See also VECTOR_NUMA_NODE. Best effort: without NUMA support in the kernel,
+    the buffer is placed as usual.
+    */
+    VECTOR_NUMA_INTERLEAVE = 1u << 2,
+
+    /* Not a flag for vector_init_flags: set by vector_init_inline while `data` is
+    the caller's buffer (which is then never freed), cleared when the vector
+    outgrows it and moves to the heap.
+    */
+    VECTOR_INLINE_STORAGE = 1u << 3,
+
+    /* Grow by 1.5x instead of 2x: up to a third less memory held by big vectors,
+    for more reallocations while they fill.
+    */
+    VECTOR_GROWTH_1_5X = 1u << 4,
+
+    /* Round buffers of at least CDATAUTILS_VECTOR_PAGE_SIZE bytes up to a whole
+    number of pages, so the end of their last page holds items too. Combines with
+    either growth factor.
+    */
+    VECTOR_GROWTH_PAGES = 1u << 5,
+};
+/* A flag for vector_init_flags: bind the pages of the buffer to NUMA node `node`
+(mbind MPOL_BIND). `node` MUST be < 64.
+*/
+#define VECTOR_NUMA_NODE(node) (((unsigned)(node) + 1u) << 24)
+/* The bits of the flags used by VECTOR_NUMA_NODE. */
+#define VECTOR_NUMA_NODE_MASK (0x7fu << 24)
+
 /* Creates a vector suitable for a given type.  */
 #ifdef __cplusplus
-#define vector_create(type)    \
-    {                          \
-        0, 0, 0, sizeof(type), \
+#define vector_create(type)          \
+    {                                \
+        0, 0, 0, sizeof(type), 0, 0, \
     }
 #else
-#define vector_create(type)   \
-    (struct vector)           \
-    {                         \
-        0, 0, 0, sizeof(type) \
+#define vector_create(type)         \
+    (struct vector)                 \
+    {                               \
+        0, 0, 0, sizeof(type), 0, 0 \
     }
 #endif
 /* Initializes the vector for use.
@@ -106,12 +227,46 @@ Notes:
 See also vector_create(type)
 */
 void vector_init(struct vector* vec, int value_size);
+/* Initializes the vector for use, with a combination of `enum vector_flags`.
+
+Same notes as vector_init.
+*/
+void vector_init_flags(struct vector* vec, int value_size, unsigned flags);
+/* Initializes the vector for use, with its buffer coming from `allocator` (which
+must outlive it) instead of realloc/free. The vector's flags don't apply.
+
+Same notes as vector_init.
+*/
+void vector_init_with_allocator(
+    struct vector* vec,
+    int value_size,
+    struct vector_allocator const* allocator
+);
+
+/* Initializes the vector for use, with `buf` (`buf_bytes` bytes) as its first
+buffer: the vector holds up to `buf_bytes / value_size` items without allocating
+anything, then moves to the heap (and `buf` is left alone) when it outgrows it.
+
+`buf` must outlive the vector (or its first growth), and is aligned however the
+caller aligned it. Every vector_* function works the same on such a vector.
+
+Same notes as vector_init.
+
+Example:
+```
+struct point small[16];
+struct vector points;
+vector_init_inline(&points, sizeof(struct point), small, sizeof(small));
+```
+*/
+void vector_init_inline(struct vector* vec, int value_size, void* buf, int buf_bytes);
 
 /* Frees the internal buffer of the vector.
 
 After this function, the whole struct is zeroed to prevent errors.
 
-Equivalent to:
+Equivalent to (for buffers that came from realloc, otherwise the buffer goes back
+to where it came from, or is left alone if it was given to vector_init_inline):
 ```
 free(vec->data);
 vec->value_size = 0;
@@ -191,8 +346,9 @@ void vector_push(struct vector* vec, void const* restrict value);
 /* Inserts `n_values` items in to the vector, reading each one consecutively
 from `values`.
 
-Grows the vector if necessary with one call to `vector_grow`.
-Performs a bitwise copy of the values, inserting .
+Grows the vector if necessary, at most once, following its growth policy (so
+pushing arrays over and over is amortized like pushing items).
+Performs a bitwise copy of the values.
 
 Note:
     - The user is responsible for ensuring `values` points to an "array" of
@@ -204,7 +360,6 @@ Equivalent to:
 T const values[] = { ... };
 int const n_values = sizeof(values) / sizeof(values[0]);
 
-vector_reserve_more(vec, n_values);
 for (int i = 0; i < n_values; ++i)
     vector_push(vec, &values[i]);
 ```
@@ -250,11 +405,19 @@ Supports:
     - `%s`  -> char const*
     - `%c`  -> char
     - `%*c` -> char, repeated N times. Expects uint32_t N, followed by a char.
-    - `%f`  -> double
+    - `%f`  -> double (`%lf` too). The shortest decimal that reads back as the
+    same double: "0.1", "1.0", "1e+21", "1.5e-7" (see below).
     - `%u`  -> uint32_t
     - `%lu` -> uint64_t
     - `%i`  -> int32_t
     - `%li` -> int64_t
+    Anything else after a `%` is skipped.
+
+Doubles are in fixed notation from 1e-6 up to 1e21 (with at least one decimal),
+scientific otherwise, like JavaScript prints numbers. "nan", "inf", "-inf".
+
+Nothing goes through libc's printf: the format is measured first, the vector
+grows at most once, then everything is written straight into it.
 
 Notes:
     - Does not null-terminate the buffer (no \0).
@@ -276,6 +439,86 @@ void vector_push_sprintf_terminated(
     ...
 ) CDATAUTILS_VECTOR_PRINTF_ATTRIBUTE;
 
+/* The most conversions (plus one) a `struct vector_fmt` holds. Formats with more
+still work, vector_push_fmt then parses them every time like vector_push_sprintf.
+*/
+#ifndef CDATAUTILS_VECTOR_FMT_MAX_STEPS
+#define CDATAUTILS_VECTOR_FMT_MAX_STEPS 16
+#endif
+
+/* A literal span of a format, and the conversion right after it. */
+struct vector_fmt_step
+{
+    char const* literal;
+    int literal_length;
+    /* What follows the literal, internal to vector.c (none for the last step). */
+    int conversion;
+};
+
+/* A format of vector_push_sprintf, parsed once: its literal spans, the kinds of
+its arguments and an upper bound of its output. vector_push_fmt then only copies
+and converts.
+
+Either compiled at runtime with vector_fmt_compile, or initialized statically
+with vector_fmt_create and compiled by its first vector_push_fmt.
+
+The format string is not copied, it must outlive the descriptor (string literals
+do).
+
+Modifying manually:
+    Don't.
+*/
+struct vector_fmt
+{
+    char const* format;
+
+    /* The number of `steps`, 0 until compiled. -1 if the format has more than
+    CDATAUTILS_VECTOR_FMT_MAX_STEPS - 1 conversions. Negative as well while the
+    first vector_push_fmt compiles it.
+    */
+    int n_steps;
+
+    /* An upper bound of the output, not counting `%s` and `%*c`. */
+    int max_size;
+
+    struct vector_fmt_step steps[CDATAUTILS_VECTOR_FMT_MAX_STEPS];
+};
+
+/* Initializes a `struct vector_fmt`, also for static storage. The format is
+compiled by the first vector_push_fmt that uses it.
+
+Example:
+```
+static struct vector_fmt line = vector_fmt_create("%s=%i\n");
+vector_push_fmt(&log, &line, "count", 42);
+```
+*/
+#define vector_fmt_create(format)       \
+    {                                   \
+        (format), 0, 0, { { 0, 0, 0 } } \
+    }
+
+/* Compiles `format` (same syntax as vector_push_sprintf) into `fmt`.
+
+Not thread-safe: compile a shared descriptor before any thread pushes it (or let
+vector_push_fmt do it).
+*/
+void vector_fmt_compile(struct vector_fmt* fmt, char const* format);
+
+/* Pushes formatted data like vector_push_sprintf, with a compiled format: no
+parsing, one growth for everything but `%s` and `%*c` (which grow as needed).
+
+Compiles `fmt` if it is not compiled yet. Thread-safe: the first push compiles
+it, the pushes of other threads meanwhile parse the format like
+vector_push_vsprintf.
+
+Notes:
+    - The arguments are not checked against the format by the compiler. Keep
+    the format next to the call (or use vector_push_sprintf in debug builds).
+*/
+void vector_push_fmt(struct vector* vec, struct vector_fmt* fmt, ...);
+void vector_push_vfmt(struct vector* vec, struct vector_fmt* fmt, va_list args);
+
 /* Ensures the vector can fit at least `at_least` items.
 
 If the can already fit them, this is a noop.
@@ -421,6 +664,70 @@ CDATAUTILS_VECTOR_GETTERS(int*, intptr)
 
 CDATAUTILS_VECTOR_REF_GETTER(struct vector, vector)
 
+/* Makes room for at least one more item, growing the vector like vector_push
+does.
+
+The slow path of the functions generated by CDATAUTILS_VECTOR_PUSHERS.
+*/
+void vector_grow_for_push(struct vector* vec);
+
+/* Generates a typed push and pop for a `struct vector` like `void
+vector_push_NAME(struct vector*, TYPE value)` and `TYPE vector_pop_NAME(struct
+vector*)`.
+
+The push is a capacity check and a store, the growth is out of line (see
+vector_grow_for_push). The pop returns the last item and removes it, the vector
+MUST NOT be empty.
+
+The definitions are marked as `static inline` so they are kinda hard on the
+linker but do not require LTO to inline.
+
+Notes:
+    - It is the user's responsibilty to ensure the type is correct.
+
+Example:
+```
+    struct vec3f { float x, y, z; };
+    CDATAUTILS_VECTOR_PUSHERS(struct vec3f, vec3f)
+
+    struct vector points;
+    vector_init(&points, sizeof(struct vec3f));
+
+    vector_push_vec3f(&points, (struct vec3f){ 1.f, 2.f, 3.f });
+    struct vec3f last = vector_pop_vec3f(&points);
+```
+*/
+#define CDATAUTILS_VECTOR_PUSHERS(type, name)                             \
+    static inline void vector_push_##name(struct vector* vec, type value) \
+    {                                                                     \
+        if (vec->size == vec->capacity)                                   \
+            vector_grow_for_push(vec);                                    \
+        ((type*)vec->data)[vec->size++] = value;                          \
+    }                                                                     \
+    static inline type vector_pop_##name(struct vector* vec)              \
+    {                                                                     \
+        return ((type*)vec->data)[--vec->size];                           \
+    }
+
+CDATAUTILS_VECTOR_PUSHERS(long long, longlong)
+CDATAUTILS_VECTOR_PUSHERS(long, long)
+CDATAUTILS_VECTOR_PUSHERS(int, int)
+CDATAUTILS_VECTOR_PUSHERS(short, short)
+CDATAUTILS_VECTOR_PUSHERS(char, char)
+
+CDATAUTILS_VECTOR_PUSHERS(int64_t, i64)
+CDATAUTILS_VECTOR_PUSHERS(int32_t, i32)
+CDATAUTILS_VECTOR_PUSHERS(int16_t, i16)
+CDATAUTILS_VECTOR_PUSHERS(int8_t, i8)
+CDATAUTILS_VECTOR_PUSHERS(uint64_t, u64)
+CDATAUTILS_VECTOR_PUSHERS(uint32_t, u32)
+CDATAUTILS_VECTOR_PUSHERS(uint16_t, u16)
+CDATAUTILS_VECTOR_PUSHERS(uint8_t, u8)
+CDATAUTILS_VECTOR_PUSHERS(double, f64)
+CDATAUTILS_VECTOR_PUSHERS(float, f32)
+
+CDATAUTILS_VECTOR_PUSHERS(void*, voidptr)
+
 /* Remove a single element from the vector.
 
 Equivalent to:
@@ -0,0 +1,125 @@
+#ifndef CDATAUTILS_VECTOR_ALLOC_H
+#define CDATAUTILS_VECTOR_ALLOC_H
+
+#include <cdatautils/vector.h>
+
+#ifdef __cplusplus
+extern "C" {
+#define restrict
+#endif
+
+/* Allocators for vector_init_with_allocator, for vectors that live and die
+together (for example everything built while handling one request): their
+buffers are all released at once, in O(1), instead of one free() each.
+
+Neither is thread-safe: use one per thread (or per request).
+*/
+
+/* The default size of the chunks an arena gets from malloc. */
+#ifndef CDATAUTILS_VECTOR_ARENA_CHUNK_SIZE
+#define CDATAUTILS_VECTOR_ARENA_CHUNK_SIZE (64 << 10)
+#endif
+
+struct vector_arena_chunk;
+
+/* A bump-pointer arena. Blocks are carved one after the other out of big chunks,
+and only given back all together by vector_arena_reset.
+
+The last block can grow (and shrink) in place, so a vector being filled while
+nothing else allocates from the arena never copies. Other blocks that grow move
+to the end of the arena, their old space is lost until the reset.
+
+Modifying manually:
+    Don't.
+*/
+struct vector_arena
+{
+    /* Pass `&arena->allocator` to vector_init_with_allocator. */
+    struct vector_allocator allocator;
+
+    /* All chunks, in the order they are used. */
+    struct vector_arena_chunk* chunks;
+    /* The chunk blocks are carved from. */
+    struct vector_arena_chunk* current;
+    /* The free space of `current`. */
+    char* cursor;
+    char* end;
+    /* The last block handed out, the only one that can grow in place. */
+    char* last;
+
+    size_t chunk_size;
+};
+
+/* Initializes an arena. Nothing is allocated until the first block.
+
+`chunk_size` is the size of the chunks it gets from malloc, 0 for
+CDATAUTILS_VECTOR_ARENA_CHUNK_SIZE. Blocks bigger than that get a chunk of their
+own.
+*/
+void vector_arena_init(struct vector_arena* arena, size_t chunk_size);
+/* Frees all chunks. Every vector using the arena is invalidated. */
+void vector_arena_destroy(struct vector_arena* arena);
+/* Releases all blocks at once, in O(1). The chunks are kept for the next blocks.
+
+Every vector using the arena is invalidated: don't vector_destroy them, simply
+forget them (or vector_init them again).
+*/
+void vector_arena_reset(struct vector_arena* arena);
+
+/* The number of size classes of a pool: powers of two, from 16 bytes to
+CDATAUTILS_VECTOR_POOL_MAX_CLASS_SIZE (64 KB by default).
+*/
+#ifndef CDATAUTILS_VECTOR_POOL_CLASSES
+#define CDATAUTILS_VECTOR_POOL_CLASSES 13
+#endif
+#define CDATAUTILS_VECTOR_POOL_MAX_CLASS_SIZE \
+    ((size_t)16 << (CDATAUTILS_VECTOR_POOL_CLASSES - 1))
+
+struct vector_pool_large;
+
+/* A size-class pool. Blocks are rounded up to a power of two and carved out of an
+arena. A freed block goes on the free list of its class, and is reused by the
+next block of the same class - vectors that are created and destroyed over and
+over stop hitting malloc.
+
+A block that grows within its class doesn't move at all.
+
+Blocks above CDATAUTILS_VECTOR_POOL_MAX_CLASS_SIZE come from malloc (with a
+small header), and are freed by vector_pool_reset too.
+
+Modifying manually:
+    Don't.
+*/
+struct vector_pool
+{
+    /* Pass `&pool->allocator` to vector_init_with_allocator. */
+    struct vector_allocator allocator;
+
+    /* Where the blocks of the size classes come from. */
+    struct vector_arena arena;
+    /* The freed blocks of each class, linked through their first bytes. */
+    void* free_lists[CDATAUTILS_VECTOR_POOL_CLASSES];
+    /* The blocks above the biggest class. */
+    struct vector_pool_large* large;
+};
+
+/* Initializes a pool. `chunk_size` is the one of its arena, see
+vector_arena_init.
+*/
+void vector_pool_init(struct vector_pool* pool, size_t chunk_size);
+/* Frees everything. Every vector using the pool is invalidated. */
+void vector_pool_destroy(struct vector_pool* pool);
+/* Releases all blocks at once. O(1), plus a free() per block above the biggest
+class that is still alive.
+
+Every vector using the pool is invalidated: don't vector_destroy them, simply
+forget them (or vector_init them again).
+*/
+void vector_pool_reset(struct vector_pool* pool);
+
+#ifdef __cplusplus
+#undef restrict
+}
+#endif
+
+#endif
@@ -0,0 +1,511 @@
+#include "format.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define internal static
+
+/* "00", "01", ... "99": two digits per division by 100. */
+internal char const vector_digit_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+internal uint64_t const vector_powers_of_10[20] = {
+    1u,
+    10u,
+    100u,
+    1000u,
+    10000u,
+    100000u,
+    1000000u,
+    10000000u,
+    100000000u,
+    1000000000u,
+    10000000000u,
+    100000000000u,
+    1000000000000u,
+    10000000000000u,
+    100000000000000u,
+    1000000000000000u,
+    10000000000000000u,
+    100000000000000000u,
+    1000000000000000000u,
+    10000000000000000000u,
+};
+
+/* The number of bits of `value`, which MUST NOT be 0. */
+internal
+unsigned
+vector_bit_length(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 64u - (unsigned)__builtin_clzll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (unsigned)index + 1u;
+#else
+    unsigned bits = 0;
+    while (value) {
+        value >>= 1;
+        ++bits;
+    }
+    return bits;
+#endif
+}
+/* The number of decimal digits of `value` (1 for 0), without a loop: the bit
+length times log10(2) (~1233 / 4096) is the digit count or one less.
+*/
+internal
+unsigned
+vector_count_digits(uint64_t value)
+{
+    unsigned const guess = (vector_bit_length(value | 1u) * 1233u) >> 12;
+
+    return guess + (value >= vector_powers_of_10[guess]) + (value == 0);
+}
+/* Writes the digits of `value` right before `end`, two at a time. */
+internal
+void
+vector_write_digits(char* end, uint64_t value)
+{
+    uint64_t quotient;
+    uint32_t small;
+
+    while (value > UINT32_MAX) {
+        quotient = value / 100u;
+        end -= 2;
+        memcpy(end, vector_digit_pairs + (value - quotient * 100u) * 2u, 2);
+        value = quotient;
+    }
+
+    /* 32-bit divisions from here on, they are cheaper. */
+    small = (uint32_t)value;
+    while (small >= 100u) {
+        end -= 2;
+        memcpy(end, vector_digit_pairs + (small % 100u) * 2u, 2);
+        small /= 100u;
+    }
+    if (small >= 10u)
+        memcpy(end - 2, vector_digit_pairs + small * 2u, 2);
+    else
+        end[-1] = (char)('0' + small);
+}
+
+size_t
+vector_format_u32(char* out, uint32_t value)
+{
+    unsigned const length = vector_count_digits(value);
+
+    vector_write_digits(out + length, value);
+    return length;
+}
+size_t
+vector_format_i32(char* out, int32_t value)
+{
+    if (value >= 0)
+        return vector_format_u32(out, (uint32_t)value);
+
+    *out = '-';
+    return 1u + vector_format_u32(out + 1, 0u - (uint32_t)value);
+}
+size_t
+vector_format_u64(char* out, uint64_t value)
+{
+    unsigned const length = vector_count_digits(value);
+
+    vector_write_digits(out + length, value);
+    return length;
+}
+size_t
+vector_format_i64(char* out, int64_t value)
+{
+    if (value >= 0)
+        return vector_format_u64(out, (uint64_t)value);
+
+    *out = '-';
+    return 1u + vector_format_u64(out + 1, 0u - (uint64_t)value);
+}
+
+/* Grisu2 (Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+with Integers", 2010), after Milo Yip's implementation. The digits always read
+back as the same double, and are the shortest ones in all but a handful of cases
+(where one digit too many comes out).
+*/
+
+#define VECTOR_DOUBLE_SIGNIFICAND_MASK ((uint64_t)0x000fffffffffffffu)
+#define VECTOR_DOUBLE_EXPONENT_MASK ((uint64_t)0x7ff0000000000000u)
+#define VECTOR_DOUBLE_HIDDEN_BIT ((uint64_t)0x0010000000000000u)
+#define VECTOR_DOUBLE_EXPONENT_BIAS (0x3ff + 52)
+
+/* A floating point number `f * 2^e`, with a 64-bit significand. */
+struct vector_diy_fp
+{
+    uint64_t f;
+    int e;
+};
+
+/* 10^k for k = -348, -340, ... 340 as normalized vector_diy_fp (rounded), the
+significands and the binary exponents.
+*/
+internal uint64_t const vector_cached_powers_f[] = {
+    0xfa8fd5a0081c0288u, 0xbaaee17fa23ebf76u, 0x8b16fb203055ac76u,
+    0xcf42894a5dce35eau, 0x9a6bb0aa55653b2du, 0xe61acf033d1a45dfu,
+    0xab70fe17c79ac6cau, 0xff77b1fcbebcdc4fu, 0xbe5691ef416bd60cu,
+    0x8dd01fad907ffc3cu, 0xd3515c2831559a83u, 0x9d71ac8fada6c9b5u,
+    0xea9c227723ee8bcbu, 0xaecc49914078536du, 0x823c12795db6ce57u,
+    0xc21094364dfb5637u, 0x9096ea6f3848984fu, 0xd77485cb25823ac7u,
+    0xa086cfcd97bf97f4u, 0xef340a98172aace5u, 0xb23867fb2a35b28eu,
+    0x84c8d4dfd2c63f3bu, 0xc5dd44271ad3cdbau, 0x936b9fcebb25c996u,
+    0xdbac6c247d62a584u, 0xa3ab66580d5fdaf6u, 0xf3e2f893dec3f126u,
+    0xb5b5ada8aaff80b8u, 0x87625f056c7c4a8bu, 0xc9bcff6034c13053u,
+    0x964e858c91ba2655u, 0xdff9772470297ebdu, 0xa6dfbd9fb8e5b88fu,
+    0xf8a95fcf88747d94u, 0xb94470938fa89bcfu, 0x8a08f0f8bf0f156bu,
+    0xcdb02555653131b6u, 0x993fe2c6d07b7facu, 0xe45c10c42a2b3b06u,
+    0xaa242499697392d3u, 0xfd87b5f28300ca0eu, 0xbce5086492111aebu,
+    0x8cbccc096f5088ccu, 0xd1b71758e219652cu, 0x9c40000000000000u,
+    0xe8d4a51000000000u, 0xad78ebc5ac620000u, 0x813f3978f8940984u,
+    0xc097ce7bc90715b3u, 0x8f7e32ce7bea5c70u, 0xd5d238a4abe98068u,
+    0x9f4f2726179a2245u, 0xed63a231d4c4fb27u, 0xb0de65388cc8ada8u,
+    0x83c7088e1aab65dbu, 0xc45d1df942711d9au, 0x924d692ca61be758u,
+    0xda01ee641a708deau, 0xa26da3999aef774au, 0xf209787bb47d6b85u,
+    0xb454e4a179dd1877u, 0x865b86925b9bc5c2u, 0xc83553c5c8965d3du,
+    0x952ab45cfa97a0b3u, 0xde469fbd99a05fe3u, 0xa59bc234db398c25u,
+    0xf6c69a72a3989f5cu, 0xb7dcbf5354e9beceu, 0x88fcf317f22241e2u,
+    0xcc20ce9bd35c78a5u, 0x98165af37b2153dfu, 0xe2a0b5dc971f303au,
+    0xa8d9d1535ce3b396u, 0xfb9b7cd9a4a7443cu, 0xbb764c4ca7a44410u,
+    0x8bab8eefb6409c1au, 0xd01fef10a657842cu, 0x9b10a4e5e9913129u,
+    0xe7109bfba19c0c9du, 0xac2820d9623bf429u, 0x80444b5e7aa7cf85u,
+    0xbf21e44003acdd2du, 0x8e679c2f5e44ff8fu, 0xd433179d9c8cb841u,
+    0x9e19db92b4e31ba9u, 0xeb96bf6ebadf77d9u, 0xaf87023b9bf0ee6bu,
+};
+internal int16_t const vector_cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+/* The upper 64 bits of the product (rounded). */
+internal
+struct vector_diy_fp
+vector_diy_fp_multiply(struct vector_diy_fp x, struct vector_diy_fp y)
+{
+    uint64_t const mask = 0xffffffffu;
+    uint64_t const a = x.f >> 32;
+    uint64_t const b = x.f & mask;
+    uint64_t const c = y.f >> 32;
+    uint64_t const d = y.f & mask;
+    uint64_t const ac = a * c;
+    uint64_t const bc = b * c;
+    uint64_t const ad = a * d;
+    uint64_t const bd = b * d;
+    uint64_t const middle =
+        (bd >> 32) + (ad & mask) + (bc & mask) + ((uint64_t)1 << 31);
+    struct vector_diy_fp product;
+
+    product.f = ac + (ad >> 32) + (bc >> 32) + (middle >> 32);
+    product.e = x.e + y.e + 64;
+    return product;
+}
+/* Moves the last digit down while the number stays in the interval and gets
+closer to the exact value.
+*/
+internal
+void
+vector_grisu_round(
+    char* digits,
+    int length,
+    uint64_t delta,
+    uint64_t rest,
+    uint64_t ten_kappa,
+    uint64_t wp_w
+)
+{
+    while (rest < wp_w && delta - rest >= ten_kappa
+           && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        --digits[length - 1];
+        rest += ten_kappa;
+    }
+}
+/* Generates the digits of `mp`, until they are within `delta` of it. */
+internal
+void
+vector_grisu_digits(
+    struct vector_diy_fp w,
+    struct vector_diy_fp mp,
+    uint64_t delta,
+    char* digits,
+    int* length,
+    int* k
+)
+{
+    int const shift = -mp.e;
+    uint64_t const one = (uint64_t)1 << shift;
+    uint64_t const wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t)(mp.f >> shift);
+    uint64_t p2 = mp.f & (one - 1u);
+    int kappa = (int)vector_count_digits(p1);
+    uint32_t digit;
+    uint32_t power;
+    uint64_t rest;
+
+    *length = 0;
+
+    /* The integral part. */
+    while (kappa > 0) {
+        --kappa;
+        power = (uint32_t)vector_powers_of_10[kappa];
+        digit = p1 / power;
+        p1 %= power;
+        if (digit || *length)
+            digits[(*length)++] = (char)('0' + digit);
+
+        rest = ((uint64_t)p1 << shift) + p2;
+        if (rest <= delta) {
+            *k += kappa;
+            vector_grisu_round(
+                digits,
+                *length,
+                delta,
+                rest,
+                (uint64_t)power << shift,
+                wp_w
+            );
+            return;
+        }
+    }
+
+    /* The fractional part. */
+    for (;;) {
+        p2 *= 10u;
+        delta *= 10u;
+        digit = (uint32_t)(p2 >> shift);
+        if (digit || *length)
+            digits[(*length)++] = (char)('0' + digit);
+        p2 &= one - 1u;
+        --kappa;
+
+        if (p2 < delta) {
+            *k += kappa;
+            vector_grisu_round(
+                digits,
+                *length,
+                delta,
+                p2,
+                one,
+                wp_w * (-kappa < 20 ? vector_powers_of_10[-kappa] : 0u)
+            );
+            return;
+        }
+    }
+}
+/* Writes the digits of the positive, finite, non-zero double `bits`, such that it
+is `digits * 10^k`.
+*/
+internal
+void
+vector_grisu2(uint64_t bits, char* digits, int* length, int* k)
+{
+    int const biased_exponent = (int)((bits & VECTOR_DOUBLE_EXPONENT_MASK) >> 52);
+    struct vector_diy_fp v;
+    struct vector_diy_fp plus;
+    struct vector_diy_fp minus;
+    struct vector_diy_fp cached;
+    struct vector_diy_fp w;
+    double dk;
+    int ki;
+    unsigned index;
+
+    v.f = bits & VECTOR_DOUBLE_SIGNIFICAND_MASK;
+    if (biased_exponent) {
+        v.f += VECTOR_DOUBLE_HIDDEN_BIT;
+        v.e = biased_exponent - VECTOR_DOUBLE_EXPONENT_BIAS;
+    } else {
+        v.e = 1 - VECTOR_DOUBLE_EXPONENT_BIAS;
+    }
+
+    /* The boundaries: halfway to the neighbours, normalized to the same exponent. */
+    plus.f = (v.f << 1) + 1u;
+    plus.e = v.e - 1;
+    while (!(plus.f & (VECTOR_DOUBLE_HIDDEN_BIT << 1))) {
+        plus.f <<= 1;
+        --plus.e;
+    }
+    plus.f <<= 10;
+    plus.e -= 10;
+    if (v.f == VECTOR_DOUBLE_HIDDEN_BIT) {
+        minus.f = (v.f << 2) - 1u;
+        minus.e = v.e - 2;
+    } else {
+        minus.f = (v.f << 1) - 1u;
+        minus.e = v.e - 1;
+    }
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    while (!(v.f & ((uint64_t)1 << 63))) {
+        v.f <<= 1;
+        --v.e;
+    }
+
+    /* A power of ten that brings the exponent to [-60, -32]. */
+    dk = (double)(-61 - plus.e) * 0.30102999566398114 + 347;
+    ki = (int)dk;
+    if (dk - (double)ki > 0.0)
+        ++ki;
+    index = (unsigned)((ki >> 3) + 1);
+    *k = 348 - (int)(index << 3);
+    cached.f = vector_cached_powers_f[index];
+    cached.e = vector_cached_powers_e[index];
+
+    w = vector_diy_fp_multiply(v, cached);
+    plus = vector_diy_fp_multiply(plus, cached);
+    minus = vector_diy_fp_multiply(minus, cached);
+    ++minus.f;
+    --plus.f;
+    vector_grisu_digits(w, plus, plus.f - minus.f, digits, length, k);
+}
+/* Lays out `digits * 10^k`, see vector_format_double. */
+internal
+size_t
+vector_format_shortest(char* out, char const* digits, int length, int k)
+{
+    int const point = length + k;
+    char* p = out;
+    int exponent;
+
+    if (k >= 0 && point <= 21) {
+        /* An integer: 1234e2 -> 123400.0 */
+        memcpy(p, digits, (size_t)length);
+        p += length;
+        memset(p, '0', (size_t)k);
+        p += k;
+        memcpy(p, ".0", 2);
+        p += 2;
+    } else if (point > 0 && point <= 21) {
+        /* 1234e-2 -> 12.34 */
+        memcpy(p, digits, (size_t)point);
+        p += point;
+        *p++ = '.';
+        memcpy(p, digits + point, (size_t)(length - point));
+        p += length - point;
+    } else if (point > -6 && point <= 0) {
+        /* 1234e-6 -> 0.001234 */
+        memcpy(p, "0.", 2);
+        p += 2;
+        memset(p, '0', (size_t)-point);
+        p += -point;
+        memcpy(p, digits, (size_t)length);
+        p += length;
+    } else {
+        /* 1234e30 -> 1.234e+33 */
+        *p++ = digits[0];
+        if (length > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, (size_t)(length - 1));
+            p += length - 1;
+        }
+        exponent = point - 1;
+        *p++ = 'e';
+        *p++ = exponent < 0 ? '-' : '+';
+        p += vector_format_u32(p, (uint32_t)(exponent < 0 ? -exponent : exponent));
+    }
+    return (size_t)(p - out);
+}
+
+size_t
+vector_format_double(char* out, double value)
+{
+    char digits[24];
+    uint64_t bits;
+    size_t sign;
+    int length;
+    int k;
+
+    memcpy(&bits, &value, sizeof(bits));
+    sign = (size_t)(bits >> 63);
+    out[0] = '-';
+    bits &= ~((uint64_t)1 << 63);
+
+    if ((bits & VECTOR_DOUBLE_EXPONENT_MASK) == VECTOR_DOUBLE_EXPONENT_MASK) {
+        if (bits & VECTOR_DOUBLE_SIGNIFICAND_MASK) {
+            memcpy(out, "nan", 3);
+            return 3;
+        }
+        memcpy(out + sign, "inf", 3);
+        return sign + 3u;
+    }
+    if (!bits) {
+        memcpy(out + sign, "0.0", 3);
+        return sign + 3u;
+    }
+
+    vector_grisu2(bits, digits, &length, &k);
+    return sign + vector_format_shortest(out + sign, digits, length, k);
+}
+
+size_t
+vector_format_max_size(enum vector_format_conversion conversion)
+{
+    switch (conversion) {
+        case VECTOR_FORMAT_NONE: return 0;
+        case VECTOR_FORMAT_PERCENT: return 1;
+        case VECTOR_FORMAT_STRING: return 0;
+        case VECTOR_FORMAT_CHAR: return 1;
+        case VECTOR_FORMAT_REPEAT_CHAR: return 0;
+        case VECTOR_FORMAT_I32: return VECTOR_FORMAT_I32_MAX;
+        case VECTOR_FORMAT_U32: return VECTOR_FORMAT_U32_MAX;
+        case VECTOR_FORMAT_I64: return VECTOR_FORMAT_I64_MAX;
+        case VECTOR_FORMAT_U64: return VECTOR_FORMAT_U64_MAX;
+        case VECTOR_FORMAT_DOUBLE: return VECTOR_FORMAT_DOUBLE_MAX;
+    }
+    return 0;
+}
+size_t
+vector_format_parse(char const* spec, enum vector_format_conversion* out)
+{
+    switch (spec[0]) {
+        case '%': *out = VECTOR_FORMAT_PERCENT; return 1;
+        case 's': *out = VECTOR_FORMAT_STRING; return 1;
+        case 'c': *out = VECTOR_FORMAT_CHAR; return 1;
+        case 'i': *out = VECTOR_FORMAT_I32; return 1;
+        case 'u': *out = VECTOR_FORMAT_U32; return 1;
+        case 'f': *out = VECTOR_FORMAT_DOUBLE; return 1;
+        case '*':
+            if (spec[1] == 'c') {
+                *out = VECTOR_FORMAT_REPEAT_CHAR;
+                return 2;
+            }
+            break;
+        case 'l':
+            switch (spec[1]) {
+                case 'i': *out = VECTOR_FORMAT_I64; return 2;
+                case 'u': *out = VECTOR_FORMAT_U64; return 2;
+                case 'f': *out = VECTOR_FORMAT_DOUBLE; return 2;
+                default: break;
+            }
+            break;
+        default: break;
+    }
+
+    /* Skipped, like the known conversions of the same shape. */
+    *out = VECTOR_FORMAT_NONE;
+    if (!spec[0])
+        return 0;
+    if ((spec[0] == '*' || spec[0] == 'l') && spec[1])
+        return 2;
+    return 1;
+}
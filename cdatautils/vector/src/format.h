@@ -0,0 +1,61 @@
+#ifndef CDATAUTILS_VECTOR_FORMAT_H
+#define CDATAUTILS_VECTOR_FORMAT_H
+
+/* Number formatting and format string parsing for vector_push_sprintf, without
+going through libc. Internal, not installed.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The conversions of vector_push_sprintf (see vector.h). */
+enum vector_format_conversion
+{
+    /* Unknown, or the format ends after `%`: writes nothing, takes no argument. */
+    VECTOR_FORMAT_NONE,
+    VECTOR_FORMAT_PERCENT,
+    VECTOR_FORMAT_STRING,
+    VECTOR_FORMAT_CHAR,
+    VECTOR_FORMAT_REPEAT_CHAR,
+    VECTOR_FORMAT_I32,
+    VECTOR_FORMAT_U32,
+    VECTOR_FORMAT_I64,
+    VECTOR_FORMAT_U64,
+    VECTOR_FORMAT_DOUBLE,
+};
+
+/* The most characters a number conversion writes: "-2147483648",
+"18446744073709551615", "-2.2250738585072014e-308" (with room to spare).
+*/
+#define VECTOR_FORMAT_I32_MAX 11
+#define VECTOR_FORMAT_U32_MAX 10
+#define VECTOR_FORMAT_I64_MAX 20
+#define VECTOR_FORMAT_U64_MAX 20
+#define VECTOR_FORMAT_DOUBLE_MAX 32
+
+/* The most characters `conversion` writes, 0 for the ones that depend on their
+argument's value (`%s`, `%*c`).
+*/
+size_t vector_format_max_size(enum vector_format_conversion conversion);
+
+/* Parses the conversion right after a `%` at `spec`, returns the number of
+characters it spans (not counting the `%`).
+*/
+size_t vector_format_parse(char const* spec, enum vector_format_conversion* out);
+
+/* Writes the decimal digits of `value` at `out` (no \0), returns how many. */
+size_t vector_format_u32(char* out, uint32_t value);
+size_t vector_format_i32(char* out, int32_t value);
+size_t vector_format_u64(char* out, uint64_t value);
+size_t vector_format_i64(char* out, int64_t value);
+
+/* Writes the shortest decimal that reads back (strtod) as `value` at `out` (no \0),
+returns how many characters, at most VECTOR_FORMAT_DOUBLE_MAX.
+
+Like JavaScript's Number.toString: fixed notation from 1e-6 up to 1e21, with
+at least one decimal ("1.0", "0.001", "123.25"), scientific otherwise ("1e+21",
+"1.5e-7"). Also "nan", "inf" and "-inf".
+*/
+size_t vector_format_double(char* out, double value);
+
+#endif
@@ -1,11 +1,26 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
 #include <cdatautils/vector.h>
 
+#include "format.h"
+
+#include <limits.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #define internal static
 
 #ifdef CDATAUTILS_VECTOR_USE_ASSERT
@@ -66,47 +81,359 @@ vector_realloc(void** data_block, int element_size, int old_elements, int new_el
     *data_block = new_block;
     return true;
 }
+/* The size of a huge page, for VECTOR_HUGE_PAGES. */
+#define VECTOR_HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+/* The flags that place big buffers. */
+#define VECTOR_PLACEMENT                                              \
+    (VECTOR_HUGE_PAGES | VECTOR_PREFAULT | VECTOR_NUMA_INTERLEAVE \
+     | VECTOR_NUMA_NODE_MASK)
+
+/* Returns whether a buffer of `capacity` items is placed by the vector's flags
+(mapped with vector_map), rather than coming from realloc.
+*/
+internal
+bool
+vector_placed(struct vector const* vec, int capacity)
+{
+#if defined(__linux__)
+    return (vec->flags & VECTOR_PLACEMENT) && !vec->allocator
+           && !(vec->flags & VECTOR_INLINE_STORAGE)
+           && (size_t)capacity * (size_t)vec->value_size
+                  >= (size_t)CDATAUTILS_VECTOR_PLACEMENT_THRESHOLD;
+#else
+    (void)vec;
+    (void)capacity;
+    return false;
+#endif
+}
+
+#if defined(__linux__)
+/* Placed buffers are mapped like the ring buffers' (ringbuffer/src/wait.c), with a
+copy of their own: the two libraries don't depend on each other.
+*/
+
+/* The size of the system's (base) pages. */
+internal
+size_t
+vector_os_page_size(void)
+{
+    long const page_size = sysconf(_SC_PAGESIZE);
+    return page_size > 0 ? (size_t)page_size : 4096u;
+}
+/* The size of the mapping of a placed buffer of `size` bytes, on a system with
+pages of `page_size` bytes.
+*/
+internal
+size_t
+vector_map_size(size_t size, unsigned flags, size_t page_size)
+{
+    size_t const page = flags & VECTOR_HUGE_PAGES ? VECTOR_HUGE_PAGE_SIZE : page_size;
+    return (size + page - 1u) & ~(page - 1u);
+}
+/* Applies the NUMA flags to the (untouched) pages of `memory`. Errors (no NUMA,
+offline node) leave the default policy.
+*/
 internal
 void
-vector_grow(struct vector* vec, int more, bool exact)
+vector_bind(void* memory, size_t size, unsigned flags)
 {
-    int old_capacity = vec->capacity;
-    int new_capacity;
-    if (more == 1 && old_capacity == 0 && !exact)
-        new_capacity = 8;
-    else {
-        /* TODO(boz):
-            INEFFICIENT! Make two different versions of grow(), one for
-            resize/reserve/reserve_more and one for insert/push.
-        */
-        if (exact) {
-            new_capacity = old_capacity + more;
-        } else {
-            new_capacity = old_capacity;
-            do {
-                new_capacity += old_capacity;
-            } while (new_capacity < old_capacity + more);
+    unsigned long const node = (flags & VECTOR_NUMA_NODE_MASK) >> 24;
+    unsigned long mask;
+    int mode;
+
+    if (flags & VECTOR_NUMA_INTERLEAVE) {
+        mode = MPOL_INTERLEAVE;
+        mask = ~0ul;
+    } else if (node) {
+        mode = MPOL_BIND;
+        mask = 1ul << (node - 1u);
+    } else {
+        return;
+    }
+
+    /* mbind(2) itself, so that the vector library doesn't need libnuma. Its
+    `maxnode` counts one bit more than the mask holds. */
+    syscall(SYS_mbind, memory, size, mode, &mask, sizeof(mask) * 8u + 1u, 0u);
+}
+/* Maps a buffer of `size` bytes, placed as asked by `flags`. */
+internal
+void*
+vector_map(size_t size, unsigned flags)
+{
+    size_t const huge = VECTOR_HUGE_PAGE_SIZE;
+    size_t const page_size = vector_os_page_size();
+    char* memory = MAP_FAILED;
+    size_t head;
+    size_t i;
+
+    size = vector_map_size(size, flags, page_size);
+#ifdef MAP_HUGETLB
+    if (flags & VECTOR_HUGE_PAGES)
+        memory = mmap(
+            NULL,
+            size,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+            -1,
+            0
+        );
+#endif
+    if (memory == MAP_FAILED && (flags & VECTOR_HUGE_PAGES)) {
+        /* No reserved huge pages: a 2 MB aligned mapping that transparent huge
+        pages can back. Map one huge page more, and trim both ends. */
+        memory = mmap(
+            NULL,
+            size + huge,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0
+        );
+        if (memory == MAP_FAILED)
+            return NULL;
+        head = (huge - (uintptr_t)memory % huge) % huge;
+        if (head)
+            munmap(memory, head);
+        munmap(memory + head + size, huge - head);
+        memory += head;
+#ifdef MADV_HUGEPAGE
+        madvise(memory, size, MADV_HUGEPAGE);
+#endif
+    } else if (memory == MAP_FAILED) {
+        memory = mmap(
+            NULL,
+            size,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0
+        );
+        if (memory == MAP_FAILED)
+            return NULL;
+    }
+
+    vector_bind(memory, size, flags);
+    if (flags & VECTOR_PREFAULT) {
+        for (i = 0; i < size; i += page_size)
+            ((char volatile*)memory)[i] = 0;
+    }
+    return memory;
+}
+internal
+void
+vector_unmap(void* memory, size_t size, unsigned flags)
+{
+    munmap(memory, vector_map_size(size, flags, vector_os_page_size()));
+}
+#else
+internal
+void*
+vector_map(size_t size, unsigned flags)
+{
+    (void)size;
+    (void)flags;
+    return NULL;
+}
+internal
+void
+vector_unmap(void* memory, size_t size, unsigned flags)
+{
+    (void)memory;
+    (void)size;
+    (void)flags;
+}
+#endif
+
+/* Moves the items of `vec` to a placed buffer of `new_capacity` items. */
+internal
+bool
+vector_realloc_placed(struct vector* vec, int new_capacity)
+{
+    size_t const value_size = (size_t)vec->value_size;
+    void* new_block = vector_map((size_t)new_capacity * value_size, vec->flags);
+
+    if (!new_block)
+        return false;
+    if (vec->data)
+        memcpy(new_block, vec->data, (size_t)vec->size * value_size);
+
+    if (vector_placed(vec, vec->capacity))
+        vector_unmap(vec->data, (size_t)vec->capacity * value_size, vec->flags);
+    else
+        free(vec->data);
+    vec->data = new_block;
+    return true;
+}
+
+/* Moves the items of `vec` to a buffer of `new_capacity` items, from wherever the
+vector's buffers come from.
+*/
+internal
+bool
+vector_resize_block(struct vector* vec, int new_capacity)
+{
+    struct vector_allocator const* const allocator = vec->allocator;
+    size_t const value_size = (size_t)vec->value_size;
+    int const old_capacity = vec->capacity;
+    void* new_block;
+
+    /* Leaving the caller's buffer: allocate as if the vector was empty, then copy
+    the items over. */
+    if (vec->flags & VECTOR_INLINE_STORAGE) {
+        new_block = vec->data;
+        vec->data = NULL;
+        vec->capacity = 0;
+        vec->flags &= ~(unsigned)VECTOR_INLINE_STORAGE;
+        if (!vector_resize_block(vec, new_capacity)) {
+            vec->data = new_block;
+            vec->capacity = old_capacity;
+            vec->flags |= VECTOR_INLINE_STORAGE;
+            return false;
         }
+        memcpy(vec->data, new_block, (size_t)vec->size * value_size);
+        return true;
     }
 
-    if (!vector_realloc(&vec->data, vec->value_size, vec->size, new_capacity)) {
+    if (allocator) {
+        new_block = allocator->realloc(
+            allocator->context,
+            vec->data,
+            (size_t)old_capacity * value_size,
+            (size_t)new_capacity * value_size
+        );
+        if (!new_block)
+            return false;
+        vec->data = new_block;
+        return true;
+    }
+    if (vector_placed(vec, new_capacity))
+        return vector_realloc_placed(vec, new_capacity);
+    return vector_realloc(&vec->data, vec->value_size, vec->size, new_capacity);
+}
+
+/* Returns the capacity push/insert grow `vec` to, for at least `at_least` items:
+`capacity` times the growth factor of its flags (8 for the first buffer), or
+`at_least` if that's not enough.
+*/
+internal
+int
+vector_grown_capacity(struct vector const* vec, int at_least)
+{
+    int const old_capacity = vec->capacity;
+    int const max_capacity = INT_MAX / vec->value_size;
+    size_t const page = CDATAUTILS_VECTOR_PAGE_SIZE;
+    size_t bytes;
+    int new_capacity;
+
+    if (old_capacity == 0)
+        new_capacity = 8;
+    else if (vec->flags & VECTOR_GROWTH_1_5X)
+        new_capacity = old_capacity < max_capacity / 3 * 2
+                           ? old_capacity + old_capacity / 2
+                           : max_capacity;
+    else
+        new_capacity =
+            old_capacity < max_capacity / 2 ? old_capacity * 2 : max_capacity;
+
+    if (new_capacity < at_least)
+        new_capacity = at_least;
+
+    /* Whole pages: the slack of the last page goes to the vector, not to waste. */
+    bytes = (size_t)new_capacity * (size_t)vec->value_size;
+    if ((vec->flags & VECTOR_GROWTH_PAGES) && bytes >= page) {
+        bytes = (bytes + page - 1u) / page * page;
+        if (bytes / (size_t)vec->value_size <= (size_t)max_capacity)
+            new_capacity = (int)(bytes / (size_t)vec->value_size);
+    }
+    return new_capacity;
+}
+/* Moves the items to a buffer of exactly `new_capacity` items, or aborts. */
+internal
+void
+vector_set_capacity(struct vector* vec, int new_capacity)
+{
+    if (!vector_resize_block(vec, new_capacity)) {
         fputs("[vector_grow] OOM.", stderr);
         abort();
     } else {
         vec->capacity = new_capacity;
     }
 }
+/* Amortized growth, for push/insert: makes room for at least `at_least` items,
+following the growth policy of the vector's flags.
+*/
+internal
+void
+vector_grow(struct vector* vec, int at_least)
+{
+    if (at_least > vec->capacity)
+        vector_set_capacity(vec, vector_grown_capacity(vec, at_least));
+}
+/* Exact growth, for reserve: makes room for exactly `at_least` items. */
+internal
+void
+vector_grow_exact(struct vector* vec, int at_least)
+{
+    if (at_least > vec->capacity)
+        vector_set_capacity(vec, at_least);
+}
 
 void
 vector_init(struct vector* vec, int value_size)
+{
+    vector_init_flags(vec, value_size, 0);
+}
+void
+vector_init_flags(struct vector* vec, int value_size, unsigned flags)
 {
     memset(vec, 0, sizeof(*vec));
     vec->value_size = value_size;
+    vec->flags = flags;
+}
+void
+vector_init_with_allocator(
+    struct vector* vec,
+    int value_size,
+    struct vector_allocator const* allocator
+)
+{
+    vector_init(vec, value_size);
+    vec->allocator = allocator;
+}
+void
+vector_init_inline(struct vector* vec, int value_size, void* buf, int buf_bytes)
+{
+    vector_init(vec, value_size);
+    if (buf_bytes / value_size > 0) {
+        vec->data = buf;
+        vec->capacity = buf_bytes / value_size;
+        vec->flags = VECTOR_INLINE_STORAGE;
+    }
 }
 void
 vector_destroy(struct vector* vec)
 {
-    free(vec->data);
+    struct vector_allocator const* const allocator = vec->allocator;
+
+    if (vec->flags & VECTOR_INLINE_STORAGE) {
+        /* The caller's buffer. */
+    } else if (allocator) {
+        if (vec->data && allocator->free)
+            allocator->free(
+                allocator->context,
+                vec->data,
+                (size_t)vec->capacity * (size_t)vec->value_size
+            );
+    } else if (vector_placed(vec, vec->capacity)) {
+        vector_unmap(
+            vec->data,
+            (size_t)vec->capacity * (size_t)vec->value_size,
+            vec->flags
+        );
+    } else {
+        free(vec->data);
+    }
     memset(vec, 0, sizeof(*vec));
 }
 void
@@ -135,7 +462,7 @@ vector_insert(struct vector* vec, int index, void const* restrict value)
     assert(index <= size);
 
     if (size + 1 > vec->capacity)
-        vector_grow(vec, 1, false);
+        vector_grow(vec, size + 1);
 
     if (move_amount > 0) {
         memmove(
@@ -162,8 +489,8 @@ vector_insert_array(
 
     assert(index <= size);
 
-    // `vector_reserve_more(n_values)` but 'faster' (less going to memory).
-    vector_reserve(vec, size + n_values);
+    // Amortized, so that pushing arrays over and over doesn't realloc every time.
+    vector_grow(vec, size + n_values);
 
     // Move the items already in the vector. {#000}
     /* NOTE(braynstorm):
@@ -205,109 +532,317 @@ vector_push_sprintf(struct vector* vec, char const* restrict format, ...)
     vector_push_vsprintf(vec, format, args);
     va_end(args);
 }
+/* The number of characters before the next `%` (or the end) of a format. */
+internal
+size_t
+vector_literal_span(char const* format)
+{
+    char const* p = format;
+
+    while (*p && *p != '%')
+        ++p;
+    return (size_t)(p - format);
+}
+
+/* The lengths of the first `%s` arguments, kept between the two passes of
+vector_push_vsprintf (the others are measured twice).
+*/
+#define VECTOR_FORMAT_CACHED_STRINGS 8
+
 void
 vector_push_vsprintf(struct vector* vec, char const* restrict format, va_list args)
 {
-    int i = 0;
-    int written = 0;
-    int last_replacement = 0;
+    size_t lengths[VECTOR_FORMAT_CACHED_STRINGS];
+    enum vector_format_conversion conversion;
+    char const* p;
+    char const* string;
+    char* out;
+    size_t bound = 0;
+    size_t span;
+    int n_strings = 0;
+    int reps;
+    va_list counting;
+
+    assert(vec->value_size == sizeof(char));
+
+    /* First pass: an upper bound of the output, so the vector grows at most once. */
+    va_copy(counting, args);
+    for (p = format;;) {
+        span = vector_literal_span(p);
+        bound += span;
+        p += span;
+        if (!*p)
+            break;
+        p += 1 + vector_format_parse(p + 1, &conversion);
+
+        switch (conversion) {
+            case VECTOR_FORMAT_NONE: break;
+            case VECTOR_FORMAT_PERCENT: bound += 1; break;
+            case VECTOR_FORMAT_STRING:
+                span = strlen(va_arg(counting, char const*));
+                if (n_strings < VECTOR_FORMAT_CACHED_STRINGS)
+                    lengths[n_strings++] = span;
+                bound += span;
+                break;
+            case VECTOR_FORMAT_CHAR:
+                (void)va_arg(counting, int);
+                bound += 1;
+                break;
+            case VECTOR_FORMAT_REPEAT_CHAR:
+                reps = va_arg(counting, int);
+                (void)va_arg(counting, int);
+                bound += reps > 0 ? (size_t)reps : 0u;
+                break;
+            case VECTOR_FORMAT_I32:
+                (void)va_arg(counting, int32_t);
+                bound += VECTOR_FORMAT_I32_MAX;
+                break;
+            case VECTOR_FORMAT_U32:
+                (void)va_arg(counting, uint32_t);
+                bound += VECTOR_FORMAT_U32_MAX;
+                break;
+            case VECTOR_FORMAT_I64:
+                (void)va_arg(counting, int64_t);
+                bound += VECTOR_FORMAT_I64_MAX;
+                break;
+            case VECTOR_FORMAT_U64:
+                (void)va_arg(counting, uint64_t);
+                bound += VECTOR_FORMAT_U64_MAX;
+                break;
+            case VECTOR_FORMAT_DOUBLE:
+                (void)va_arg(counting, double);
+                bound += VECTOR_FORMAT_DOUBLE_MAX;
+                break;
+        }
+    }
+    va_end(counting);
+
+    assert(bound <= (size_t)(INT_MAX - vec->size));
+    vector_grow(vec, vec->size + (int)bound);
+
+    /* Second pass: straight into the buffer. */
+    out = (char*)vec->data + vec->size;
+    n_strings = 0;
+    for (p = format;;) {
+        // Literal spans in one go.
+        span = vector_literal_span(p);
+        memcpy(out, p, span);
+        out += span;
+        p += span;
+        if (!*p)
+            break;
+        p += 1 + vector_format_parse(p + 1, &conversion);
+
+        switch (conversion) {
+            case VECTOR_FORMAT_NONE: break;
+            case VECTOR_FORMAT_PERCENT: *out++ = '%'; break;
+            case VECTOR_FORMAT_STRING:
+                string = va_arg(args, char const*);
+                span = n_strings < VECTOR_FORMAT_CACHED_STRINGS ? lengths[n_strings++]
+                                                                : strlen(string);
+                memcpy(out, string, span);
+                out += span;
+                break;
+            case VECTOR_FORMAT_CHAR: *out++ = (char)va_arg(args, int); break;
+            case VECTOR_FORMAT_REPEAT_CHAR:
+                reps = va_arg(args, int);
+                if (reps < 0)
+                    reps = 0;
+                memset(out, va_arg(args, int), (size_t)reps);
+                out += reps;
+                break;
+            case VECTOR_FORMAT_I32:
+                out += vector_format_i32(out, va_arg(args, int32_t));
+                break;
+            case VECTOR_FORMAT_U32:
+                out += vector_format_u32(out, va_arg(args, uint32_t));
+                break;
+            case VECTOR_FORMAT_I64:
+                out += vector_format_i64(out, va_arg(args, int64_t));
+                break;
+            case VECTOR_FORMAT_U64:
+                out += vector_format_u64(out, va_arg(args, uint64_t));
+                break;
+            case VECTOR_FORMAT_DOUBLE:
+                out += vector_format_double(out, va_arg(args, double));
+                break;
+        }
+    }
+
+    vec->size = (int)(out - (char*)vec->data);
+}
+/* The `n_steps` of a descriptor that vector_push_vfmt is compiling. */
+#define VECTOR_FMT_COMPILING (-2)
+
+_Static_assert(sizeof(_Atomic int) == sizeof(int), "n_steps is accessed atomically");
+
+/* `fmt->n_steps`, which vector_push_vfmt publishes. A plain int in the header, so
+that it stays usable from C++.
+*/
+internal
+_Atomic int*
+vector_fmt_n_steps(struct vector_fmt* fmt)
+{
+    return (_Atomic int*)&fmt->n_steps;
+}
+/* Fills the steps and the `max_size` of `fmt` from its format. Returns its number
+of steps, -1 if there are too many.
+*/
+internal
+int
+vector_fmt_build(struct vector_fmt* fmt)
+{
+    enum vector_format_conversion conversion = VECTOR_FORMAT_NONE;
+    struct vector_fmt_step* step;
+    char const* p = fmt->format;
+    size_t max_size = 0;
+    int n_steps = 0;
+
+    for (;;) {
+        if (n_steps == CDATAUTILS_VECTOR_FMT_MAX_STEPS) {
+            fmt->max_size = 0;
+            return -1;
+        }
+
+        step = &fmt->steps[n_steps++];
+        step->literal = p;
+        step->literal_length = (int)vector_literal_span(p);
+        max_size += (size_t)step->literal_length;
+        p += step->literal_length;
+
+        if (!*p) {
+            step->conversion = VECTOR_FORMAT_NONE;
+            break;
+        }
+        p += 1 + vector_format_parse(p + 1, &conversion);
+        step->conversion = (int)conversion;
+        max_size += vector_format_max_size(conversion);
+    }
+
+    assert(max_size <= INT_MAX);
+    fmt->max_size = (int)max_size;
+    return n_steps;
+}
+void
+vector_fmt_compile(struct vector_fmt* fmt, char const* format)
+{
+    fmt->format = format;
+    fmt->n_steps = vector_fmt_build(fmt);
+}
+/* Makes room for `more` characters at `out`, plus a whole `fmt->max_size` for the
+rest of the format. Returns where `out` is afterwards.
+*/
+internal
+char*
+vector_fmt_make_room(
+    struct vector* vec,
+    struct vector_fmt const* fmt,
+    char* out,
+    size_t more
+)
+{
+    int const size = (int)(out - (char*)vec->data);
+
+    assert(more <= (size_t)(INT_MAX - fmt->max_size - size));
+    if (size + (int)more + fmt->max_size > vec->capacity) {
+        vec->size = size;
+        vector_grow(vec, size + (int)more + fmt->max_size);
+    }
+    return (char*)vec->data + size;
+}
+void
+vector_push_fmt(struct vector* vec, struct vector_fmt* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vector_push_vfmt(vec, fmt, args);
+    va_end(args);
+}
+void
+vector_push_vfmt(struct vector* vec, struct vector_fmt* fmt, va_list args)
+{
+    struct vector_fmt_step const* step;
+    char const* string;
+    char* out;
+    size_t length;
+    int n_steps;
+    int reps;
+    int i;
 
     assert(vec->value_size == sizeof(char));
 
-    for (; format[i]; ++i) {
-        char c = format[i];
-        int size;
-        if (c != '%')
-            continue;
-
-        // Push the 'skipped' part of `format`.
-        vector_push_array(vec, i - last_replacement, format + last_replacement);
-
-        // Get the next char.
-        c = format[++i];
-
-        size = vec->size;
-
-        switch (c) {
-            case '%': vector_push(vec, &c); break;
-            case 's': vector_push_string(vec, va_arg(args, char const*)); break;
-            case '*':
-                c = format[++i];
-                switch (c) {
-                    case 'c': {
-                        int reps = va_arg(args, int);
-                        c = (char)va_arg(args, int);
-                        vector_reserve_more(vec, reps);
-                        memset(vector_ref_char(vec, vec->size), c, (size_t)reps);
-                        vec->size += reps;
-                    } break;
-                }
+    /* Acquire: pairs with the release below, the steps are written before. */
+    n_steps = atomic_load_explicit(vector_fmt_n_steps(fmt), memory_order_acquire);
+    if (n_steps <= 0) {
+        /* Compiled by the first push to claim it. Until it publishes the steps, the
+        others parse the format like vector_push_vsprintf - nobody waits, and nobody
+        reads the steps while they are written. */
+        if (n_steps == 0
+            && atomic_compare_exchange_strong_explicit(
+                vector_fmt_n_steps(fmt),
+                &n_steps,
+                VECTOR_FMT_COMPILING,
+                memory_order_relaxed,
+                memory_order_relaxed
+            )) {
+            n_steps = vector_fmt_build(fmt);
+            atomic_store_explicit(
+                vector_fmt_n_steps(fmt),
+                n_steps,
+                memory_order_release
+            );
+        }
+        if (n_steps <= 0) {
+            vector_push_vsprintf(vec, fmt->format, args);
+            return;
+        }
+    }
+
+    vector_grow(vec, vec->size + fmt->max_size);
+    out = (char*)vec->data + vec->size;
+    for (i = 0; i < n_steps; ++i) {
+        step = &fmt->steps[i];
+        memcpy(out, step->literal, (size_t)step->literal_length);
+        out += step->literal_length;
+
+        switch ((enum vector_format_conversion)step->conversion) {
+            case VECTOR_FORMAT_NONE: break;
+            case VECTOR_FORMAT_PERCENT: *out++ = '%'; break;
+            case VECTOR_FORMAT_STRING:
+                string = va_arg(args, char const*);
+                length = strlen(string);
+                out = vector_fmt_make_room(vec, fmt, out, length);
+                memcpy(out, string, length);
+                out += length;
                 break;
-            case 'c':
-                c = (char)va_arg(args, int);
-                vector_push(vec, &c);
+            case VECTOR_FORMAT_CHAR: *out++ = (char)va_arg(args, int); break;
+            case VECTOR_FORMAT_REPEAT_CHAR:
+                reps = va_arg(args, int);
+                if (reps < 0)
+                    reps = 0;
+                out = vector_fmt_make_room(vec, fmt, out, (size_t)reps);
+                memset(out, va_arg(args, int), (size_t)reps);
+                out += reps;
                 break;
-            case 'l':
-                c = format[++i];
-                switch (c) {
-                    case 'i':
-                        // -9223372036854775807 == 20
-                        vector_reserve_more(vec, 20);
-                        written = sprintf(
-                            vector_ref_char(vec, size),
-                            "%lli",
-                            va_arg(args, int64_t)
-                        );
-                        vec->size = size + written;
-                        break;
-                    case 'u':
-                        // 9223372036854775807 == 19
-                        vector_reserve_more(vec, 19);
-                        written = sprintf(
-                            vector_ref_char(vec, vec->size),
-                            "%llu",
-                            va_arg(args, uint64_t)
-                        );
-                        vec->size = size + written;
-                        break;
-                    case 'f':
-                        vector_reserve_more(vec, 20);
-                        written = sprintf(
-                            vector_ref_char(vec, vec->size),
-                            "%f",
-                            va_arg(args, double)
-                        );
-                        vec->size = size + written;
-                        break;
-                }
+            case VECTOR_FORMAT_I32:
+                out += vector_format_i32(out, va_arg(args, int32_t));
                 break;
-            case 'i':
-                // signed 32 bit -> negative 2 billion == 11 chars.
-                vector_reserve_more(vec, 11);
-                written = sprintf(
-                    vector_ref_char(vec, vec->size),
-                    "%i",
-                    va_arg(args, int32_t)
-                );
-                vec->size += written;
+            case VECTOR_FORMAT_U32:
+                out += vector_format_u32(out, va_arg(args, uint32_t));
                 break;
-            case 'u':
-                // unsigned 32 bit -> 4 billion == 10 chars.
-                vector_reserve_more(vec, 10);
-                written = sprintf(
-                    vector_ref_char(vec, vec->size),
-                    "%u",
-                    va_arg(args, uint32_t)
-                );
-                vec->size += written;
+            case VECTOR_FORMAT_I64:
+                out += vector_format_i64(out, va_arg(args, int64_t));
+                break;
+            case VECTOR_FORMAT_U64:
+                out += vector_format_u64(out, va_arg(args, uint64_t));
+                break;
+            case VECTOR_FORMAT_DOUBLE:
+                out += vector_format_double(out, va_arg(args, double));
                 break;
         }
-        last_replacement = i + 1;
     }
 
-    // Push the last part of the string.
-    // Also handles cases where the sprintf() is called without any %replacements.
-    vector_push_string(vec, format + last_replacement);
+    vec->size = (int)(out - (char*)vec->data);
 }
 void
 vector_push_sprintf_terminated(struct vector* vec, char const* restrict format, ...)
@@ -332,11 +867,14 @@ vector_push_sprintf_terminated(struct vector* vec, char const* restrict format,
     vector_push(vec, &null);
 }
 void
+vector_grow_for_push(struct vector* vec)
+{
+    vector_grow(vec, vec->size + 1);
+}
+void
 vector_reserve(struct vector* vec, int at_least)
 {
-    int more = at_least - vec->capacity;
-    if (more > 0)
-        vector_grow(vec, more, true);
+    vector_grow_exact(vec, at_least);
 }
 void
 vector_reserve_more(struct vector* vec, int more)
@@ -365,7 +903,7 @@ vector_remove_range(struct vector* vec, int first, int last)
     int const n_removed = last - first;
     int const n_moved = size - last;
 
-    assert(size > n_removed);
+    assert(size >= n_removed);
     assert(first >= 0);
     assert(first <= size);
     assert(last >= 0);
@@ -0,0 +1,295 @@
+#include <cdatautils/vectoralloc.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define internal static
+
+#ifdef CDATAUTILS_VECTOR_USE_ASSERT
+#include <assert.h>
+#else
+#define assert(...) (void)(__VA_ARGS__)
+#endif
+
+/* Every block is aligned on (and a multiple of) 16 bytes, like vector buffers. */
+#define VECTOR_ALLOC_ALIGNMENT ((size_t)16)
+
+struct vector_arena_chunk
+{
+    struct vector_arena_chunk* next;
+    /* The usable size, after the header (and the alignment padding). */
+    size_t size;
+};
+
+/* The header of a block above the biggest size class of a pool, right before the
+block. */
+struct vector_pool_large
+{
+    struct vector_pool_large* next;
+    struct vector_pool_large* prev;
+    /* What malloc returned, the block is aligned after the header. */
+    void* memory;
+};
+
+internal
+size_t
+vector_alloc_round(size_t size)
+{
+    return (size + VECTOR_ALLOC_ALIGNMENT - 1u) & ~(VECTOR_ALLOC_ALIGNMENT - 1u);
+}
+internal
+char*
+vector_alloc_align(void* memory)
+{
+    return (char*)memory
+           + ((VECTOR_ALLOC_ALIGNMENT - (uintptr_t)memory % VECTOR_ALLOC_ALIGNMENT)
+              % VECTOR_ALLOC_ALIGNMENT);
+}
+
+/* Moves to the next chunk with room for `size` bytes, allocating one (right after
+the current one) if needed.
+*/
+internal
+bool
+vector_arena_next_chunk(struct vector_arena* arena, size_t size)
+{
+    struct vector_arena_chunk* chunk =
+        arena->current ? arena->current->next : arena->chunks;
+    size_t chunk_size;
+
+    if (!chunk || chunk->size < size) {
+        chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+        chunk = malloc(sizeof(*chunk) + VECTOR_ALLOC_ALIGNMENT + chunk_size);
+        if (!chunk)
+            return false;
+        chunk->size = chunk_size;
+        chunk->next = arena->current ? arena->current->next : arena->chunks;
+        if (arena->current)
+            arena->current->next = chunk;
+        else
+            arena->chunks = chunk;
+    }
+
+    arena->current = chunk;
+    arena->cursor = vector_alloc_align(chunk + 1);
+    arena->end = arena->cursor + chunk->size;
+    return true;
+}
+internal
+void*
+vector_arena_alloc(struct vector_arena* arena, size_t size)
+{
+    char* block;
+
+    size = vector_alloc_round(size);
+    if ((size_t)(arena->end - arena->cursor) < size
+        && !vector_arena_next_chunk(arena, size))
+        return NULL;
+
+    block = arena->cursor;
+    arena->cursor += size;
+    arena->last = block;
+    return block;
+}
+internal
+void*
+vector_arena_realloc(void* context, void* block, size_t old_size, size_t new_size)
+{
+    struct vector_arena* const arena = context;
+    char* new_block;
+
+    /* The last block grows in place, as long as the chunk has room. */
+    if (block && block == arena->last
+        && vector_alloc_round(new_size) <= (size_t)(arena->end - arena->last)) {
+        arena->cursor = arena->last + vector_alloc_round(new_size);
+        return block;
+    }
+
+    new_block = vector_arena_alloc(arena, new_size);
+    if (!new_block)
+        return NULL;
+    if (block)
+        memcpy(new_block, block, old_size < new_size ? old_size : new_size);
+    return new_block;
+}
+internal
+void
+vector_arena_free(void* context, void* block, size_t size)
+{
+    struct vector_arena* const arena = context;
+
+    (void)size;
+
+    /* Only the last block can be given back before the reset. */
+    if (block == arena->last) {
+        arena->cursor = arena->last;
+        arena->last = NULL;
+    }
+}
+
+void
+vector_arena_init(struct vector_arena* arena, size_t chunk_size)
+{
+    memset(arena, 0, sizeof(*arena));
+    arena->allocator.realloc = vector_arena_realloc;
+    arena->allocator.free = vector_arena_free;
+    arena->allocator.context = arena;
+    if (!chunk_size)
+        chunk_size = CDATAUTILS_VECTOR_ARENA_CHUNK_SIZE;
+    arena->chunk_size = vector_alloc_round(chunk_size);
+}
+void
+vector_arena_destroy(struct vector_arena* arena)
+{
+    struct vector_arena_chunk* chunk = arena->chunks;
+    struct vector_arena_chunk* next;
+
+    while (chunk) {
+        next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    vector_arena_init(arena, arena->chunk_size);
+}
+void
+vector_arena_reset(struct vector_arena* arena)
+{
+    /* Back to before the first chunk, vector_arena_next_chunk reuses them. */
+    arena->current = NULL;
+    arena->cursor = NULL;
+    arena->end = NULL;
+    arena->last = NULL;
+}
+
+/* Returns the size class of a block of `size` bytes,
+CDATAUTILS_VECTOR_POOL_CLASSES if it is above the biggest one.
+*/
+internal
+unsigned
+vector_pool_class(size_t size)
+{
+    size_t class_size = VECTOR_ALLOC_ALIGNMENT;
+    unsigned size_class = 0;
+
+    while (class_size < size && size_class < CDATAUTILS_VECTOR_POOL_CLASSES) {
+        class_size <<= 1;
+        ++size_class;
+    }
+    return size_class;
+}
+internal
+void*
+vector_pool_alloc_large(struct vector_pool* pool, size_t size)
+{
+    struct vector_pool_large* large;
+    void* memory;
+    char* block;
+
+    memory = malloc(sizeof(*large) + VECTOR_ALLOC_ALIGNMENT + size);
+    if (!memory)
+        return NULL;
+    block = vector_alloc_align((char*)memory + sizeof(*large));
+
+    /* The header right before the block. */
+    large = (struct vector_pool_large*)(void*)(block - sizeof(*large));
+    large->memory = memory;
+    large->prev = NULL;
+    large->next = pool->large;
+    if (pool->large)
+        pool->large->prev = large;
+    pool->large = large;
+    return block;
+}
+internal
+void
+vector_pool_free_large(struct vector_pool* pool, void* block)
+{
+    struct vector_pool_large* const large =
+        (struct vector_pool_large*)(void*)((char*)block - sizeof(*large));
+
+    if (large->prev)
+        large->prev->next = large->next;
+    else
+        pool->large = large->next;
+    if (large->next)
+        large->next->prev = large->prev;
+    free(large->memory);
+}
+internal
+void*
+vector_pool_alloc(struct vector_pool* pool, size_t size)
+{
+    unsigned const size_class = vector_pool_class(size);
+    void* block;
+
+    if (size_class == CDATAUTILS_VECTOR_POOL_CLASSES)
+        return vector_pool_alloc_large(pool, size);
+
+    block = pool->free_lists[size_class];
+    if (block) {
+        memcpy(&pool->free_lists[size_class], block, sizeof(void*));
+        return block;
+    }
+    return vector_arena_alloc(&pool->arena, VECTOR_ALLOC_ALIGNMENT << size_class);
+}
+internal
+void
+vector_pool_free(void* context, void* block, size_t size)
+{
+    struct vector_pool* const pool = context;
+    unsigned const size_class = vector_pool_class(size);
+
+    if (size_class == CDATAUTILS_VECTOR_POOL_CLASSES) {
+        vector_pool_free_large(pool, block);
+        return;
+    }
+    memcpy(block, &pool->free_lists[size_class], sizeof(void*));
+    pool->free_lists[size_class] = block;
+}
+internal
+void*
+vector_pool_realloc(void* context, void* block, size_t old_size, size_t new_size)
+{
+    struct vector_pool* const pool = context;
+    unsigned const size_class = vector_pool_class(new_size);
+    void* new_block;
+
+    /* Still fits in its class. */
+    if (block && size_class < CDATAUTILS_VECTOR_POOL_CLASSES
+        && size_class == vector_pool_class(old_size))
+        return block;
+
+    new_block = vector_pool_alloc(pool, new_size);
+    if (!new_block)
+        return NULL;
+    if (block) {
+        memcpy(new_block, block, old_size < new_size ? old_size : new_size);
+        vector_pool_free(pool, block, old_size);
+    }
+    return new_block;
+}
+
+void
+vector_pool_init(struct vector_pool* pool, size_t chunk_size)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->allocator.realloc = vector_pool_realloc;
+    pool->allocator.free = vector_pool_free;
+    pool->allocator.context = pool;
+    vector_arena_init(&pool->arena, chunk_size);
+}
+void
+vector_pool_destroy(struct vector_pool* pool)
+{
+    vector_pool_reset(pool);
+    vector_arena_destroy(&pool->arena);
+}
+void
+vector_pool_reset(struct vector_pool* pool)
+{
+    while (pool->large)
+        vector_pool_free_large(pool, (char*)pool->large + sizeof(*pool->large));
+    memset(pool->free_lists, 0, sizeof(pool->free_lists));
+    vector_arena_reset(&pool->arena);
+}
@@ -2,7 +2,12 @@
 
 #include <cdatautils/vector.h>
 
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <string>
+#include <thread>
+#include <vector>
 
 #define ARRAY_COUNT(array) (sizeof(array) / sizeof((array)[0]))
 
@@ -527,10 +532,255 @@ TEST_CASE("vector_push_sprintf")
             vector_push_sprintf(&v, "a%lib", (uint64_t)9223372036854775800LLU);
             REQUIRE(vector_to_string(v) == "a9223372036854775800b");
         }
+        WHEN("the integers are at their limits")
+        {
+            vector_push_sprintf(
+                &v,
+                "%i %u %li %lu %i",
+                INT32_MIN,
+                UINT32_MAX,
+                INT64_MIN,
+                UINT64_MAX,
+                0
+            );
+            REQUIRE(
+                vector_to_string(v)
+                == "-2147483648 4294967295 -9223372036854775808 18446744073709551615 0"
+            );
+        }
+        WHEN("fmt=%f")
+        {
+            vector_push_sprintf(&v, "%f|%f|%lf|%f|%f", 0.1, 1.0, 123.25, -1.5e-7, 1e21);
+
+            THEN("the shortest digits are printed")
+            {
+                REQUIRE(vector_to_string(v) == "0.1|1.0|123.25|-1.5e-7|1e+21");
+            }
+        }
+        WHEN("fmt=%f, special values")
+        {
+            vector_push_sprintf(
+                &v,
+                "%f %f %f %f",
+                -0.0,
+                HUGE_VAL,
+                -HUGE_VAL,
+                5e-324
+            );
+            REQUIRE(vector_to_string(v) == "-0.0 inf -inf 5e-324");
+        }
+        WHEN("the format ends with a %")
+        {
+            // Not a literal, so that the compiler doesn't check it (and an unused
+            // argument, so that it doesn't warn about that either).
+            char const* format = "ab%";
+            vector_push_sprintf(&v, format, 0);
+            REQUIRE(vector_to_string(v) == "ab");
+        }
+    }
+    GIVEN("an unallocated vector")
+    {
+        vector_wrapper w = vector_create(char);
+
+        WHEN("a long format is pushed")
+        {
+            vector_push_sprintf(
+                &w,
+                "%s %s %i %lu %f",
+                "abc",
+                "def",
+                1,
+                (uint64_t)2,
+                3.0
+            );
+
+            THEN("the vector grew to an upper bound of the output")
+            {
+                REQUIRE(vector_to_string(w) == "abc def 1 2 3.0");
+                REQUIRE(w.capacity > w.size);
+            }
+        }
+    }
+    GIVEN("random doubles")
+    {
+        uint64_t state = 88172645463325252u;
+        int mismatches = 0;
+
+        for (int i = 0; i < 100000; ++i) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            double value;
+            memcpy(&value, &state, sizeof(value));
+            if (!std::isfinite(value))
+                continue;
+
+            vector_clear(&v);
+            vector_push_sprintf_terminated(&v, "%f", value);
+            mismatches += std::strtod((char const*)v.data, nullptr) != value;
+        }
+
+        THEN("they all read back the same")
+        {
+            REQUIRE(mismatches == 0);
+        }
     }
 #undef vector_to_string
 }
 
+TEST_CASE("vector_push_fmt", "[vector]")
+{
+#define vector_to_string(v) std::string((char const*)(v).data, (size_t)(v).size)
+    vector_wrapper v = vector_create(char);
+
+    GIVEN("a compiled format")
+    {
+        char const* const format = "%s: %i/%u %li %lu %f %c%*c 100%% ";
+        vector_fmt fmt;
+        vector_fmt_compile(&fmt, format);
+
+        WHEN("it is pushed")
+        {
+            vector_push_fmt(
+                &v,
+                &fmt,
+                "ab",
+                -1,
+                2u,
+                (int64_t)-3,
+                (uint64_t)4,
+                0.5,
+                'c',
+                3,
+                'd'
+            );
+
+            THEN("it writes what vector_push_sprintf writes")
+            {
+                vector_wrapper expected = vector_create(char);
+                vector_push_sprintf(
+                    &expected,
+                    format,
+                    "ab",
+                    -1,
+                    2u,
+                    (int64_t)-3,
+                    (uint64_t)4,
+                    0.5,
+                    'c',
+                    3,
+                    'd'
+                );
+                REQUIRE(vector_to_string(v) == "ab: -1/2 -3 4 0.5 cddd 100% ");
+                REQUIRE(vector_to_string(v) == vector_to_string(expected));
+            }
+        }
+        WHEN("it is pushed with long strings and repeats")
+        {
+            std::string const long_string(1000, 'a');
+            vector_push_fmt(
+                &v,
+                &fmt,
+                long_string.c_str(),
+                1,
+                2u,
+                (int64_t)3,
+                (uint64_t)4,
+                5.0,
+                'b',
+                5000,
+                'c'
+            );
+
+            THEN("the vector grows to fit them")
+            {
+                std::string const repeat(5000, 'c');
+                std::string const expected =
+                    long_string + ": 1/2 3 4 5.0 b" + repeat + " 100% ";
+                REQUIRE(vector_to_string(v) == expected);
+            }
+        }
+    }
+    GIVEN("a format with an unknown conversion")
+    {
+        // Not a literal, so that the compiler doesn't check vector_push_sprintf's.
+        char const* format = "a%xb%i";
+        vector_fmt fmt;
+        vector_fmt_compile(&fmt, format);
+        vector_push_fmt(&v, &fmt, 1);
+
+        THEN("it is skipped like vector_push_sprintf does")
+        {
+            vector_wrapper expected = vector_create(char);
+            vector_push_sprintf(&expected, format, 1);
+            REQUIRE(vector_to_string(v) == "ab1");
+            REQUIRE(vector_to_string(v) == vector_to_string(expected));
+        }
+    }
+    GIVEN("a descriptor created with vector_fmt_create")
+    {
+        static vector_fmt fmt = vector_fmt_create("[%i]");
+
+        WHEN("it is pushed")
+        {
+            vector_push_fmt(&v, &fmt, 1);
+            vector_push_fmt(&v, &fmt, 2);
+
+            THEN("it is compiled on first use")
+            {
+                REQUIRE(fmt.n_steps == 2);
+                REQUIRE(vector_to_string(v) == "[1][2]");
+            }
+        }
+    }
+    GIVEN("a format with more conversions than steps")
+    {
+        std::string format;
+        std::string expected;
+        for (int i = 0; i < CDATAUTILS_VECTOR_FMT_MAX_STEPS; ++i) {
+            format += "%%";
+            expected += '%';
+        }
+        vector_fmt fmt;
+        vector_fmt_compile(&fmt, format.c_str());
+
+        THEN("it falls back to vector_push_vsprintf")
+        {
+            REQUIRE(fmt.n_steps == -1);
+            vector_push_fmt(&v, &fmt);
+            REQUIRE(vector_to_string(v) == expected);
+        }
+    }
+#undef vector_to_string
+}
+
+TEST_CASE("vector_push_fmt compiles a shared descriptor once", "[vector][threads]")
+{
+    static vector_fmt fmt = vector_fmt_create("%i-%i|");
+    int const n_threads = 8;
+    int const n_lines = 1000;
+    std::vector<std::string> outputs((size_t)n_threads);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < n_threads; ++t)
+        threads.emplace_back([&outputs, t]() {
+            vector_wrapper v = vector_create(char);
+            for (int i = 0; i < n_lines; ++i)
+                vector_push_fmt(&v, &fmt, t, i);
+            outputs[(size_t)t].assign((char const*)v.data, (size_t)v.size);
+        });
+    for (std::thread& thread : threads)
+        thread.join();
+
+    REQUIRE(fmt.n_steps == 3);
+    for (int t = 0; t < n_threads; ++t) {
+        std::string expected;
+        for (int i = 0; i < n_lines; ++i)
+            expected += std::to_string(t) + "-" + std::to_string(i) + "|";
+        REQUIRE(outputs[(size_t)t] == expected);
+    }
+}
+
 TEST_CASE("vector with no spare capacity doubles its capacity")
 {
     vector_wrapper v = {};
@@ -567,6 +817,200 @@ TEST_CASE("vector with no spare capacity doubles its capacity")
     }
 }
 
+TEST_CASE("vector growth policies", "[vector]")
+{
+    vector_wrapper v = {};
+    int const items[20] = {};
+
+    GIVEN("an empty vector")
+    {
+        vector_init(&v, sizeof(int));
+
+        THEN("an array bigger than the first buffer grows it at once")
+        {
+            vector_push_array(&v, 20, items);
+            REQUIRE(v.size == 20);
+            REQUIRE(v.capacity == 20);
+        }
+        THEN("pushing arrays over and over is amortized")
+        {
+            int reallocs = 0;
+            for (int i = 0; i < 1000; ++i) {
+                void* const data = v.data;
+                vector_push_array(&v, 3, items);
+                reallocs += v.data != data;
+            }
+            REQUIRE(v.size == 3000);
+            REQUIRE(reallocs < 20);
+        }
+    }
+    GIVEN("VECTOR_GROWTH_1_5X")
+    {
+        vector_init_flags(&v, sizeof(int), VECTOR_GROWTH_1_5X);
+        vector_reserve(&v, 10);
+        vector_push_array(&v, 10, items);
+        vector_push_array(&v, 1, items);
+
+        THEN("a full vector grows by half")
+        {
+            REQUIRE(v.capacity == 15);
+        }
+    }
+    GIVEN("VECTOR_GROWTH_PAGES")
+    {
+        vector_init_flags(&v, 3, VECTOR_GROWTH_PAGES);
+        for (int i = 0; i < 2000; ++i)
+            vector_push(&v, items);
+
+        THEN("big buffers are whole pages")
+        {
+            int const page = CDATAUTILS_VECTOR_PAGE_SIZE;
+            int const bytes = v.capacity * 3;
+            REQUIRE(bytes >= page);
+            REQUIRE((bytes + page - 1) / page * page - bytes < 3);
+        }
+        THEN("vector_reserve is still exact")
+        {
+            vector_reserve(&v, v.capacity + 1);
+            REQUIRE(v.capacity * 3 % CDATAUTILS_VECTOR_PAGE_SIZE != 0);
+        }
+    }
+}
+
+struct vec3f
+{
+    float x, y, z;
+};
+CDATAUTILS_VECTOR_PUSHERS(vec3f, vec3f)
+
+TEST_CASE("typed pushers", "[vector]")
+{
+    GIVEN("a vector of ints")
+    {
+        vector_wrapper v = vector_create(int);
+        for (int i = 0; i < 100; ++i)
+            vector_push_int(&v, i);
+
+        THEN("pushes grow it like vector_push")
+        {
+            REQUIRE(v.size == 100);
+            REQUIRE(v.capacity == 128);
+            for (int i = 0; i < 100; ++i)
+                REQUIRE(vector_get_int(&v, i) == i);
+        }
+        THEN("pops return the last items")
+        {
+            REQUIRE(vector_pop_int(&v) == 99);
+            REQUIRE(vector_pop_int(&v) == 98);
+            REQUIRE(v.size == 98);
+        }
+    }
+    GIVEN("a vector of structs")
+    {
+        vector_wrapper v = vector_create(vec3f);
+        vector_push_vec3f(&v, { 1.f, 2.f, 3.f });
+        vector_push_vec3f(&v, { 4.f, 5.f, 6.f });
+
+        THEN("the items are stored whole")
+        {
+            vec3f const last = vector_pop_vec3f(&v);
+            REQUIRE(last.x == 4.f);
+            REQUIRE(last.z == 6.f);
+            REQUIRE(vector_pop_vec3f(&v).y == 2.f);
+            REQUIRE(v.size == 0);
+        }
+    }
+}
+
+TEST_CASE("vector placement flags", "[vector]")
+{
+    unsigned flags = 0;
+    SECTION("VECTOR_HUGE_PAGES") { flags = VECTOR_HUGE_PAGES; }
+    SECTION("VECTOR_PREFAULT") { flags = VECTOR_PREFAULT; }
+    SECTION("VECTOR_NUMA_NODE(0)") { flags = VECTOR_NUMA_NODE(0); }
+    SECTION("VECTOR_NUMA_INTERLEAVE | VECTOR_HUGE_PAGES | VECTOR_PREFAULT")
+    {
+        flags = VECTOR_NUMA_INTERLEAVE | VECTOR_HUGE_PAGES | VECTOR_PREFAULT;
+    }
+
+    GIVEN("a vector that grows past CDATAUTILS_VECTOR_PLACEMENT_THRESHOLD")
+    {
+        struct vector_wrapper v = {};
+        vector_init_flags(&v, sizeof(int), flags);
+
+        int const n = CDATAUTILS_VECTOR_PLACEMENT_THRESHOLD / (int)sizeof(int) * 3;
+        for (int i = 0; i < n; ++i)
+            vector_push(&v, &i);
+
+        THEN("the items survive every move, and the buffer stays aligned")
+        {
+            REQUIRE(v.size == n);
+            REQUIRE((uintptr_t)v.data % 16 == 0);
+            bool same = true;
+            for (int i = 0; i < n; ++i)
+                same = same && vector_get_int(&v, i) == i;
+            REQUIRE(same);
+        }
+    }
+}
+
+TEST_CASE("vector with inline storage", "[vector]")
+{
+    alignas(16) int buf[16];
+
+    GIVEN("a vector using a caller's buffer")
+    {
+        struct vector_wrapper v = {};
+        vector_init_inline(&v, sizeof(int), buf, sizeof(buf));
+        REQUIRE(v.capacity == 16);
+
+        WHEN("it holds no more than the buffer")
+        {
+            for (int i = 0; i < 16; ++i)
+                vector_push(&v, &i);
+            vector_remove(&v, 0);
+            int const zero = 0;
+            vector_insert(&v, 0, &zero);
+
+            THEN("it doesn't allocate")
+            {
+                REQUIRE(v.data == (void*)buf);
+                REQUIRE(v.capacity == 16);
+                for (int i = 0; i < 16; ++i)
+                    REQUIRE(vector_get_int(&v, i) == i);
+            }
+        }
+        WHEN("it outgrows the buffer")
+        {
+            for (int i = 0; i < 100; ++i)
+                vector_push(&v, &i);
+
+            THEN("it moves to the heap, items included")
+            {
+                REQUIRE(v.data != (void*)buf);
+                REQUIRE(!(v.flags & VECTOR_INLINE_STORAGE));
+                REQUIRE(v.capacity >= 100);
+                for (int i = 0; i < 100; ++i)
+                    REQUIRE(vector_get_int(&v, i) == i);
+            }
+        }
+    }
+    GIVEN("a buffer too small for one item")
+    {
+        struct vector_wrapper v = {};
+        vector_init_inline(&v, sizeof(int), buf, 2);
+
+        THEN("the vector starts empty, as usual")
+        {
+            REQUIRE(v.capacity == 0);
+            REQUIRE(v.data == nullptr);
+            int const one = 1;
+            vector_push(&v, &one);
+            REQUIRE(vector_get_int(&v, 0) == 1);
+        }
+    }
+}
+
 TEST_CASE("modifying vector's value_size", "[!nonportable][vector]")
 {
     GIVEN("a vector of two uint32s")
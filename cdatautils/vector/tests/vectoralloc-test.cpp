@@ -0,0 +1,184 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cdatautils/vectoralloc.h>
+
+#include <cstdlib>
+#include <cstring>
+
+/* Necessary wrappers so that Catch2 correctly calls the destroy functions.
+ */
+struct vector_arena_wrapper : vector_arena
+{
+    vector_arena_wrapper(size_t chunk_size) { vector_arena_init(this, chunk_size); }
+    ~vector_arena_wrapper() { vector_arena_destroy(this); }
+};
+struct vector_pool_wrapper : vector_pool
+{
+    vector_pool_wrapper(size_t chunk_size) { vector_pool_init(this, chunk_size); }
+    ~vector_pool_wrapper() { vector_pool_destroy(this); }
+};
+
+static bool
+vector_holds_sequence(vector* v, int n)
+{
+    bool same = v->size == n;
+    for (int i = 0; same && i < n; ++i)
+        same = vector_get_int(v, i) == i;
+    return same;
+}
+
+TEST_CASE("vector arena", "[vector][vector_arena]")
+{
+    vector_arena_wrapper arena(4096);
+
+    GIVEN("a vector filled while nothing else allocates from the arena")
+    {
+        vector v;
+        vector_init_with_allocator(&v, sizeof(int), &arena.allocator);
+        vector_reserve(&v, 1);
+        void* const first = v.data;
+
+        for (int i = 0; i < 512; ++i)
+            vector_push(&v, &i);
+
+        THEN("it grows in place")
+        {
+            REQUIRE(v.data == first);
+            REQUIRE((uintptr_t)v.data % 16 == 0);
+            REQUIRE(vector_holds_sequence(&v, 512));
+        }
+        WHEN("it outgrows the chunk")
+        {
+            for (int i = 512; i < 10000; ++i)
+                vector_push(&v, &i);
+
+            THEN("it moves, items included")
+            {
+                REQUIRE(v.data != first);
+                REQUIRE((uintptr_t)v.data % 16 == 0);
+                REQUIRE(vector_holds_sequence(&v, 10000));
+            }
+        }
+        WHEN("the arena is reset")
+        {
+            vector_arena_reset(&arena);
+
+            THEN("the next vector reuses the first chunk")
+            {
+                vector w;
+                vector_init_with_allocator(&w, sizeof(int), &arena.allocator);
+                vector_reserve(&w, 1);
+                REQUIRE(w.data == first);
+            }
+        }
+    }
+    GIVEN("two vectors growing in turn")
+    {
+        vector a;
+        vector b;
+        vector_init_with_allocator(&a, sizeof(int), &arena.allocator);
+        vector_init_with_allocator(&b, sizeof(int), &arena.allocator);
+
+        for (int i = 0; i < 1000; ++i) {
+            vector_push(&a, &i);
+            vector_push(&b, &i);
+        }
+
+        THEN("both keep their items")
+        {
+            REQUIRE(vector_holds_sequence(&a, 1000));
+            REQUIRE(vector_holds_sequence(&b, 1000));
+        }
+        vector_destroy(&a);
+        vector_destroy(&b);
+    }
+}
+
+TEST_CASE("vector pool", "[vector][vector_pool]")
+{
+    vector_pool_wrapper pool(0);
+
+    GIVEN("a vector that is destroyed")
+    {
+        vector v;
+        vector_init_with_allocator(&v, sizeof(int), &pool.allocator);
+        for (int i = 0; i < 100; ++i)
+            vector_push(&v, &i);
+        REQUIRE(vector_holds_sequence(&v, 100));
+        void* const block = v.data;
+        vector_destroy(&v);
+
+        THEN("its block goes to the next vector of the same size class")
+        {
+            vector w;
+            vector_init_with_allocator(&w, sizeof(int), &pool.allocator);
+            vector_reserve(&w, 100);
+            REQUIRE(w.data == block);
+            vector_destroy(&w);
+        }
+    }
+    GIVEN("a vector above the biggest size class")
+    {
+        vector v;
+        vector_init_with_allocator(&v, sizeof(int), &pool.allocator);
+        int const n = (int)(CDATAUTILS_VECTOR_POOL_MAX_CLASS_SIZE / sizeof(int)) * 4;
+        for (int i = 0; i < n; ++i)
+            vector_push(&v, &i);
+
+        THEN("it keeps its items, and the pool reset frees it")
+        {
+            REQUIRE((uintptr_t)v.data % 16 == 0);
+            REQUIRE(vector_holds_sequence(&v, n));
+            REQUIRE(pool.large != nullptr);
+            vector_pool_reset(&pool);
+            REQUIRE(pool.large == nullptr);
+        }
+        THEN("vector_destroy frees it")
+        {
+            vector_destroy(&v);
+            REQUIRE(pool.large == nullptr);
+        }
+    }
+}
+
+struct counting_allocator
+{
+    int reallocs = 0;
+    int frees = 0;
+};
+
+static void*
+counting_realloc(void* context, void* block, size_t old_size, size_t new_size)
+{
+    ++static_cast<counting_allocator*>(context)->reallocs;
+    void* new_block = std::aligned_alloc(16, (new_size + 15u) & ~(size_t)15u);
+    if (new_block && block) {
+        memcpy(new_block, block, old_size < new_size ? old_size : new_size);
+        std::free(block);
+    }
+    return new_block;
+}
+static void
+counting_free(void* context, void* block, size_t size)
+{
+    (void)size;
+    ++static_cast<counting_allocator*>(context)->frees;
+    std::free(block);
+}
+
+TEST_CASE("vector with a custom allocator", "[vector]")
+{
+    counting_allocator counts;
+    vector_allocator const allocator = {counting_realloc, counting_free, &counts};
+
+    vector v;
+    vector_init_with_allocator(&v, sizeof(int), &allocator);
+    for (int i = 0; i < 100; ++i)
+        vector_push(&v, &i);
+    REQUIRE(vector_holds_sequence(&v, 100));
+
+    // 8, 16, 32, 64, 128.
+    REQUIRE(counts.reallocs == 5);
+    vector_destroy(&v);
+    REQUIRE(counts.frees == 1);
+}